@@ -25,7 +25,7 @@ template <typename Dtype>
 class Blob {
   public:
     Blob()
-        : data_(), diff_(), count_(0), capacity_(0) {
+        : data_(), diff_(), count_(0), capacity_(0), diff_disabled_(false) {
     }
 
     /// @brief Deprecated; use <code>Blob(const vector<int>& shape)</code>.
@@ -231,6 +231,14 @@ class Blob {
       CHECK(diff_);
       return diff_;
     }
+    /**
+     * @brief Release the diff and stop allocating one on Reshape -- used by
+     *        inference-only Net%s. Accessing the diff then fails a CHECK.
+     */
+    void DisableDiff();
+    inline bool has_diff() const {
+      return diff_.get() != NULL;
+    }
 
     const Dtype* cpu_data() const;
     void set_cpu_data(Dtype* data);
@@ -278,9 +286,19 @@ class Blob {
      * shared_ptr calls its destructor when reset with the "=" operator.
      */
     void ShareDiff(const Blob& other);
+    /**
+     * @brief Set the data_ shared_ptr to point to an externally owned
+     *        SyncedMemory at least as large as this Blob -- used by Net to
+     *        let Blob%s with disjoint lifetimes share a single buffer.
+     *
+     * If the Blob later grows past its capacity it gets its own storage again.
+     */
+    void SetDataStorage(const shared_ptr<SyncedMemory>& storage);
     void set_data_layer() {
       data_->set_data_layer();
-      diff_->set_data_layer();
+      if (diff_) {
+        diff_->set_data_layer();
+      }
     }
 
     bool ShapeEquals(const BlobProto& other);
@@ -291,6 +309,8 @@ class Blob {
     vector<int> shape_;
     int count_;
     int capacity_;
+    // See DisableDiff.
+    bool diff_disabled_;
 
     DISABLE_COPY_AND_ASSIGN (Blob);
 };
@@ -83,12 +83,10 @@ private:\
 /*ifdef: use proposed img_packing scheme;
  ifndef: use proposed packing im2col + sgemm scheme*/
 #define use_packing_scheme 1
-/* global_packing_N defines packing number of the use_packing scheme
- for intial design, we use the same packing number for all conv layers*/
-#define global_packing_N 16
-/*ifdef: use multi-command queues for groups in conv layer;
- ifndef: use single commane queue for groups*/
-//#define multiQ
+/* the packing number of the use_packing scheme is chosen per conv layer,
+ see BaseConvolutionLayer::packing_num() and NetParameter.tune_packing*/
+/* conv groups are spread over the command queues of amdDevice,
+ see oclNumQueues and Device::ForkQueues*/
 //#define check_gradient
 // OpenCL: various checks for different function calls.
 #define OCL_CHECK(condition) \
@@ -181,6 +179,8 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+class ThreadPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -247,6 +247,32 @@ class Caffe {
     static void SetDevice(const int device_id);
     // Prints the current GPU status.
     static void DeviceQuery();
+#ifndef CPU_ONLY
+    // Whether freed device buffers are cached for reuse, see BufferPool.
+    // On by default; turning it off releases the cached buffers.
+    static void set_buffer_pool(const bool enabled);
+    // Releases the buffers cached by the pool, e.g. after a net has been
+    // reshaped to a smaller input.
+    static void TrimBufferPool();
+#endif
+    // Sets the number of threads, the caller included, used by the CPU
+    // element-wise math functions. One keeps them single threaded.
+    static void set_cpu_threads(const int num_threads);
+    inline static int cpu_threads() {
+      return Get().cpu_threads_;
+    }
+    // Arrays shorter than twice the grain size are not split across threads.
+    inline static void set_cpu_grain(const int grain) {
+      CHECK_GT(grain, 0) << "cpu_grain must be positive";
+      Get().cpu_grain_ = grain;
+    }
+    inline static int cpu_grain() {
+      return Get().cpu_grain_;
+    }
+    // The intra-op pool, or NULL when running single threaded.
+    inline static ThreadPool* cpu_thread_pool() {
+      return Get().cpu_thread_pool_.get();
+    }
 
   protected:
 #ifndef CPU_ONLY
@@ -256,6 +282,9 @@ class Caffe {
     shared_ptr<RNG> random_generator_;
 
     Brew mode_;
+    int cpu_threads_;
+    int cpu_grain_;
+    shared_ptr<ThreadPool> cpu_thread_pool_;
     static shared_ptr<Caffe> singleton_;
 
   private:
@@ -15,10 +15,18 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/image_cache.hpp"
+
+namespace boost {
+class mutex;
+}
 
 namespace caffe {
 
+class ThreadPool;
+
 /**
  * @brief Provides base for data layers that feed blobs to the Net.
  *
@@ -56,13 +64,72 @@ class BaseDataLayer: public Layer<Dtype> {
     bool output_labels_;
 };
 
+template <typename Dtype>
+class Batch {
+  public:
+#ifndef CPU_ONLY
+    Batch()
+        : copied_(NULL) {
+    }
+    ~Batch() {
+      if (copied_) {
+        clReleaseEvent(copied_);
+      }
+    }
+#endif
+    Blob<Dtype> data_, label_;
+    // The tops after the label, for layers with more than two.
+    vector<shared_ptr<Blob<Dtype> > > extra_;
+#ifndef CPU_ONLY
+    // Completes once Forward_gpu has copied the batch out of its device
+    // buffers; the prefetch thread waits on it before refilling the batch.
+    cl_event copied_;
+#endif
+};
+
+/// @brief Prefetch queue statistics, sampled every time Forward takes a batch.
+struct PrefetchStats {
+  PrefetchStats()
+      : batches(0), empty_waits(0), depth_sum(0), wait_ms(0) {
+  }
+  /// Batches consumed by Forward
+  int batches;
+  /// Times Forward found no prefetched batch ready and had to wait
+  int empty_waits;
+  /// Sum of the ready batches seen by Forward, see mean_depth()
+  double depth_sum;
+  /// Total time Forward spent waiting for the producer
+  double wait_ms;
+  inline double mean_depth() const {
+    return batches ? depth_sum / batches : 0;
+  }
+};
+
+/// @brief Time DataLayer spends loading batches, summed since setup.
+struct DataLoadStats {
+  DataLoadStats()
+      : batches(0), read_ms(0), transform_ms(0) {
+  }
+  /// Batches loaded
+  int batches;
+  /// Time the prefetch thread spent reading records from the db
+  double read_ms;
+  /// Time spent parsing and transforming items, summed over the workers
+  double transform_ms;
+  /// The share of transform_ms of every worker, empty without workers; an
+  /// uneven split shows items that are much costlier than others
+  vector<double> worker_transform_ms;
+};
+
+/**
+ * @brief Data layer fed by a persistent producer thread through a ring of
+ *        DataParameter.prefetch batches. Subclasses implement load_batch.
+ */
 template <typename Dtype>
 class BasePrefetchingDataLayer: public BaseDataLayer<Dtype>,
     public InternalThread {
   public:
-    explicit BasePrefetchingDataLayer(const LayerParameter& param)
-        : BaseDataLayer<Dtype>(param) {
-    }
+    explicit BasePrefetchingDataLayer(const LayerParameter& param);
     // LayerSetUp: implements common data layer setup functionality, and calls
     // DataLayerSetUp to do special data layer setup for individual layer types.
     // This method may not be overridden.
@@ -74,15 +141,29 @@ class BasePrefetchingDataLayer: public BaseDataLayer<Dtype>,
     virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
         const vector<Blob<Dtype>*>& top);
 
-    virtual void CreatePrefetchThread();
-    virtual void JoinPrefetchThread();
-    // The thread's function
-    virtual void InternalThreadEntry() {
+    inline const PrefetchStats& prefetch_stats() const {
+      return prefetch_stats_;
     }
 
   protected:
-    Blob<Dtype> prefetch_data_;
-    Blob<Dtype> prefetch_label_;
+    // The producer: fills free batches and hands them to Forward until stopped
+    virtual void InternalThreadEntry();
+    virtual void load_batch(Batch<Dtype>* batch) = 0;
+    // Takes the next full batch, recording queue statistics
+    Batch<Dtype>* PopFullBatch();
+#ifndef CPU_ONLY
+    // Blocks until the copies Forward_gpu made out of batch are done.
+    void WaitBatchCopied(Batch<Dtype>* batch);
+    // Starts uploading a loaded batch on the helper queue, so the transfer
+    // overlaps with the forward pass of the previous batch.
+    void PushBatchToGpu(Batch<Dtype>* batch);
+#endif
+
+    vector<shared_ptr<Batch<Dtype> > > prefetch_;
+    BlockingQueue<Batch<Dtype>*> prefetch_free_;
+    BlockingQueue<Batch<Dtype>*> prefetch_full_;
+    PrefetchStats prefetch_stats_;
+
     Blob<Dtype> transformed_data_;
 };
 
@@ -109,11 +190,40 @@ class DataLayer: public BasePrefetchingDataLayer<Dtype> {
       return 2;
     }
 
+    // A snapshot, safe to take while the prefetch thread runs.
+    DataLoadStats load_stats() const;
+
   protected:
-    virtual void InternalThreadEntry();
+    /**
+     * @brief State of one transform worker. Each worker owns its
+     *    DataTransformer, and hence its RNG stream, so a batch comes out
+     *    identical for a given seed regardless of thread scheduling.
+     */
+    struct TransformWorker {
+      shared_ptr<DataTransformer<Dtype> > transformer;
+      Blob<Dtype> transformed_data;
+      double trans_time;  // microseconds spent on the current batch
+    };
+
+    virtual void load_batch(Batch<Dtype>* batch);
+    void TransformItems(const int worker_id, Batch<Dtype>* batch,
+        Dtype* top_data, Dtype* top_label);
+    // Records of raw uint8 pixels are read in place through a DatumView,
+    // others are parsed into a Datum. TransformRecord returns the label.
+    vector<int> InferRecordShape(const char* value, const size_t size);
+    int TransformRecord(const char* value, const size_t size,
+        DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data);
 
     shared_ptr<db::DB> db_;
     shared_ptr<db::Cursor> cursor_;
+    // Serialized Datums of the batch being loaded, read sequentially from
+    // cursor_ and then parsed and transformed by the workers.
+    vector<string> batch_values_;
+    vector<shared_ptr<TransformWorker> > workers_;
+    // Runs the workers; its threads live as long as the layer is set up.
+    shared_ptr<ThreadPool> transform_pool_;
+    DataLoadStats load_stats_;
+    shared_ptr<boost::mutex> load_stats_mutex_;
 };
 
 /**
@@ -160,24 +270,81 @@ class DummyDataLayer: public Layer<Dtype> {
     vector<bool> refill_;
 };
 
+/// @brief Rows of the datasets of an HDF5 file, see HDF5ChunkReader.
+template <typename Dtype>
+struct HDF5Chunk {
+  /// Per dataset, the shape of the rows read and their values
+  vector<vector<int> > shapes;
+  vector<vector<Dtype> > data;
+  /// The order in which the rows are served
+  vector<int> order;
+};
+
+/**
+ * @brief Streams the datasets of a list of HDF5 files in chunks of rows
+ *        from its own thread.
+ *
+ * The files are read through a ring of two chunks: the one being served
+ * and the next one, which at a file boundary already comes from the next
+ * file, so the consumer never waits on a file switch as long as reading a
+ * chunk is faster than serving one. A chunk_rows of 0 reads whole files.
+ * With shuffle, the files are reshuffled on every pass, and so are the
+ * chunks of a file and the rows of a chunk.
+ *
+ * A single file fitting in one chunk is read once and kept.
+ */
+template <typename Dtype>
+class HDF5ChunkReader: public InternalThread {
+  public:
+    HDF5ChunkReader(const vector<string>& filenames,
+        const vector<string>& datasets, const int chunk_rows,
+        const bool shuffle);
+    virtual ~HDF5ChunkReader();
+
+    // Blocks until the next chunk is read. The previous chunk goes back to
+    // the ring, so its data must not be used anymore.
+    HDF5Chunk<Dtype>* Next();
+
+  protected:
+    virtual void InternalThreadEntry();
+    void ReadFile(const string& filename);
+    // Reads rows [start_row, start_row + num_rows) of every dataset.
+    void ReadChunk(hid_t file_id, const hsize_t start_row,
+        const hsize_t num_rows, HDF5Chunk<Dtype>* chunk);
+    hsize_t NumRows(hid_t file_id, const string& filename);
+
+    vector<string> filenames_;
+    vector<string> datasets_;
+    int chunk_rows_;
+    bool shuffle_;
+    shared_ptr<Caffe::RNG> rng_;
+    bool resident_;
+    HDF5Chunk<Dtype> chunks_[2];
+    HDF5Chunk<Dtype>* current_;
+    BlockingQueue<HDF5Chunk<Dtype>*> free_;
+    BlockingQueue<HDF5Chunk<Dtype>*> full_;
+
+    DISABLE_COPY_AND_ASSIGN (HDF5ChunkReader);
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * The files are streamed by an HDF5ChunkReader, and batches are assembled
+ * from its chunks by the prefetch thread.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer: public Layer<Dtype> {
+class HDF5DataLayer: public BasePrefetchingDataLayer<Dtype> {
   public:
     explicit HDF5DataLayer(const LayerParameter& param)
-        : Layer<Dtype>(param) {
+        : BasePrefetchingDataLayer<Dtype>(param), chunk_(NULL),
+          chunk_row_(0) {
     }
     virtual ~HDF5DataLayer();
-    virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+    virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
         const vector<Blob<Dtype>*>& top);
-    // Data layers have no bottoms, so reshaping is trivial.
-    virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
-        const vector<Blob<Dtype>*>& top) {
-    }
 
     virtual inline const char* type() const {
       return "HDF5Data";
@@ -190,27 +357,15 @@ class HDF5DataLayer: public Layer<Dtype> {
     }
 
   protected:
-    virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-        const vector<Blob<Dtype>*>& top);
-    virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
-        const vector<Blob<Dtype>*>& top);
-    virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
-        const vector<bool>& propagate_down,
-        const vector<Blob<Dtype>*>& bottom) {
-    }
-    virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
-        const vector<bool>& propagate_down,
-        const vector<Blob<Dtype>*>& bottom) {
-    }
-    virtual void LoadHDF5FileData(const char* filename);
+    virtual void load_batch(Batch<Dtype>* batch);
+    // The blob of batch feeding top i.
+    Blob<Dtype>* batch_blob(Batch<Dtype>* batch, const int i);
 
     std::vector<std::string> hdf_filenames_;
-    unsigned int num_files_;
-    unsigned int current_file_;
-    hsize_t current_row_;
-    std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
-    std::vector<unsigned int> data_permutation_;
-    std::vector<unsigned int> file_permutation_;
+    shared_ptr<HDF5ChunkReader<Dtype> > reader_;
+    // The chunk rows are taken from, and the next of its rows.
+    HDF5Chunk<Dtype>* chunk_;
+    int chunk_row_;
 };
 
 /**
@@ -289,14 +444,21 @@ class ImageDataLayer: public BasePrefetchingDataLayer<Dtype> {
     virtual inline int ExactNumTopBlobs() const {
       return 2;
     }
+    // NULL unless image_data_param sets a cache.
+    inline const ImageCache* image_cache() const {
+      return cache_.get();
+    }
 
   protected:
     shared_ptr<Caffe::RNG> prefetch_rng_;
     virtual void ShuffleImages();
-    virtual void InternalThreadEntry();
+    virtual void load_batch(Batch<Dtype>* batch);
+    // Decodes filename, from the cache when there is one.
+    cv::Mat ReadImage(const string& filename);
 
     vector<std::pair<std::string, int> > lines_;
     int lines_id_;
+    shared_ptr<ImageCache> cache_;
 };
 
 /**
@@ -387,7 +549,7 @@ class WindowDataLayer: public BasePrefetchingDataLayer<Dtype> {
 
   protected:
     virtual unsigned int PrefetchRand();
-    virtual void InternalThreadEntry();
+    virtual void load_batch(Batch<Dtype>* batch);
 
     shared_ptr<Caffe::RNG> prefetch_rng_;
     vector<std::pair<std::string, vector<int> > > image_database_;
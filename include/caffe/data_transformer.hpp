@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
 
 namespace caffe {
 
@@ -25,6 +26,11 @@ class DataTransformer {
      *    transformation.
      */
     void InitRand();
+    /**
+     * @brief Initialize the Random number generations, if needed, from an
+     *    explicit seed instead of the Caffe RNG.
+     */
+    void InitRand(unsigned int seed);
 
     /**
      * @brief Applies the transformation defined in the data layer's
@@ -38,6 +44,17 @@ class DataTransformer {
      */
     void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+    /**
+     * @brief Applies the transformation to the fields of a Datum viewed in
+     * place, which must not be encoded.
+     *
+     * @param datum
+     *    DatumView of the data to be transformed.
+     * @param transformed_blob
+     *    This is destination blob. See data_layer.cpp for an example.
+     */
+    void Transform(const DatumView& datum, Blob<Dtype>* transformed_blob);
+
     /**
      * @brief Applies the transformation defined in the data layer's
      * transform_param block to a vector of Datum.
@@ -97,6 +114,14 @@ class DataTransformer {
      *    Datum containing the data to be transformed.
      */
     vector<int> InferBlobShape(const Datum& datum);
+    /**
+     * @brief Infers the shape of transformed_blob will have when
+     *    the transformation is applied to the data.
+     *
+     * @param datum
+     *    DatumView of the data to be transformed, which must not be encoded.
+     */
+    vector<int> InferBlobShape(const DatumView& datum);
     /**
      * @brief Infers the shape of transformed_blob will have when
      *    the transformation is applied to the data.
@@ -135,7 +160,7 @@ class DataTransformer {
      */
     virtual int Rand(int n);
 
-    void Transform(const Datum& datum, Dtype* transformed_data);
+    void Transform(const DatumView& datum, Dtype* transformed_data);
     // Tranformation parameters
     TransformationParameter param_;
 
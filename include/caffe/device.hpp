@@ -28,14 +28,26 @@
 #define CAFFE_DEVICE_HPP
 #include <string>
 #include <fstream>
+#include <vector>
 #include "caffe/common.hpp"
 namespace caffe {
 #ifndef CPU_ONLY
+// Launch shape of a 1-D kernel, see KernelHandle::Enqueue.
+struct LaunchConfig {
+    LaunchConfig()
+        : local_size(256), items_per_thread(1) {
+    }
+    size_t local_size;
+    // Elements handled by each work item; kernels looping over
+    // get_global_size(0) only.
+    int items_per_thread;
+};
+
+class BufferPool;
+
 class Device {
   public:
-    Device()
-        : numPlatforms(0), numDevices(0), device_id(INT_MIN) {
-    }
+    Device();
     ~Device();
     cl_uint numPlatforms;
     cl_platform_id * platformIDs;
@@ -67,6 +79,15 @@ class Device {
     }
     ;
     void BuildProgram(std::string kernel_dir);
+    std::string DeviceSignature();
+    bool LoadProgramBinary(std::string file_name, unsigned long long key,
+        cl_program* program);
+    void SaveProgramBinary(std::string file_name, unsigned long long key,
+        cl_program program);
+    // Builds a program from generated source, e.g. fused kernels. Programs
+    // are kept by source for the lifetime of the Device and go through the
+    // binary cache like the main one. Returns NULL if the build fails.
+    cl_program BuildProgramFromSource(const std::string& source);
 
     template <typename T>
     void DisplayDeviceInfo(cl_device_id id, cl_device_info name,
@@ -76,9 +97,113 @@ class Device {
 
     cl_kernel GetKernel(std::string kernel_name);
     void ReleaseKernels();
+
+    // Kernels looked up through a KernelHandle. The name is resolved once to
+    // an id; every thread then gets its own cl_kernel instance for it, so
+    // threads feeding different queues never race on clSetKernelArg.
+    int RegisterKernel(const std::string& kernel_name);
+    cl_kernel GetKernel(int kernel_id);
+    std::string KernelName(int kernel_id);
+
+    // Per-device launch profile. Entries are kept by kernel name and applied
+    // to kernels registered before or after they are set. The returned
+    // pointer stays valid for the lifetime of the Device.
+    const LaunchConfig* GetLaunchConfig(int kernel_id);
+    void SetLaunchConfig(const std::string& kernel_name,
+        const LaunchConfig& config);
+    // The profile file of this device in oclBinaryCachePath, empty if the
+    // cache is disabled. It is loaded by Init when present.
+    std::string LaunchProfilePath();
+    bool LoadLaunchProfile(const std::string& file_name);
+    bool SaveLaunchProfile(const std::string& file_name);
+
+    // Caches the buffers of SyncedMemory, see BufferPool.
+    inline BufferPool& buffer_pool() {
+      return *buffer_pool_;
+    }
+
+    // In-order queues for independent work, see oclNumQueues. Queue 0 is the
+    // one created as CommandQueue; CommandQueue always holds the active
+    // queue, which all wrappers enqueue on.
+    inline int num_queues() const {
+      return queues_.size();
+    }
+    inline int active_queue() const {
+      return active_queue_;
+    }
+    void SetActiveQueue(const int queue_id);
+    // The k-th queue after the active one, wrapping around.
+    cl_command_queue ForkedQueue(const int k) const;
+    // Orders the n - 1 queues after the active one after the work enqueued
+    // on it so far, so that ForkedQueue(0..n-1) can run independent parts.
+    void ForkQueues(const int n);
+    // Orders the active queue after the work enqueued so far on the n - 1
+    // queues after it.
+    void JoinQueues(const int n);
+    // Orders the active queue after the work enqueued so far on queue_id.
+    void WaitForQueue(const int queue_id);
+    // Set by Net while its branches run on the queues, see
+    // Net::AssignLayerQueues. Forked queues would then wrap onto the queues
+    // of sibling branches, so layers don't fork within a branch.
+    inline bool branch_queues() const {
+      return branch_queues_;
+    }
+    inline void set_branch_queues(const bool branch_queues) {
+      branch_queues_ = branch_queues;
+    }
+    // Returns an event completing once the work enqueued so far on every
+    // queue, CommandQueue_helper included, is done. It is enqueued on
+    // CommandQueue_helper, so any thread may call it.
+    cl_event MarkAllQueues();
+
+  protected:
+    // Synchronization lives out of the header, see BlockingQueue.
+    class KernelTable;
+    shared_ptr<KernelTable> kernel_table_;
+    shared_ptr<BufferPool> buffer_pool_;
+    std::vector<cl_command_queue> queues_;
+    int active_queue_;
+    bool branch_queues_;
 };
 extern std::string buildOption;
+// Directory of cached program binaries; an empty path disables the cache.
+extern std::string oclBinaryCachePath;
+// Type of the devices Init picks from, e.g. CL_DEVICE_TYPE_CPU for tuning or
+// testing against a CPU runtime.
+extern cl_device_type oclDeviceType;
+// Number of queues Init creates for concurrent conv groups and net
+// branches; one runs everything on CommandQueue.
+extern int oclNumQueues;
 extern Device amdDevice;
+
+/**
+ * @brief A kernel of amdDevice resolved once, meant to be held in a
+ *        function-local static by the wrapper launching it.
+ *
+ * get() is a thread-local array lookup instead of building the kernel name
+ * and searching Device::Kernels on every launch.
+ */
+class KernelHandle {
+  public:
+    explicit KernelHandle(const std::string& kernel_name)
+        : kernel_id_(amdDevice.RegisterKernel(kernel_name)),
+          config_(amdDevice.GetLaunchConfig(kernel_id_)) {
+    }
+    inline cl_kernel get() const {
+      return amdDevice.GetKernel(kernel_id_);
+    }
+
+    // Enqueues kernel on count elements with the tuned launch config. The
+    // global size is rounded up to the local size, so the kernel must check
+    // its bounds; grid_stride kernels loop over get_global_size(0) and also
+    // use items_per_thread.
+    void Enqueue(cl_kernel kernel, const int count, const bool grid_stride)
+        const;
+
+  protected:
+    const int kernel_id_;
+    const LaunchConfig* const config_;
+};
 #endif
 }  // namespace caffe
 
@@ -31,6 +31,12 @@ class InternalThread {
     /** Will not return until the internal thread has exited. */
     bool WaitForInternalThreadToExit();
 
+    /**
+     * Requests the thread to stop and waits for it to exit. Long running
+     * threads should poll must_stop() or block in boost interruption points.
+     */
+    void StopInternalThread();
+
     bool is_started() const;
 
   protected:
@@ -39,6 +45,9 @@ class InternalThread {
     virtual void InternalThreadEntry() {
     }
 
+    /* Should be tested when running loops to exit when requested. */
+    bool must_stop();
+
     shared_ptr<boost::thread> thread_;
 };
 
@@ -32,7 +32,7 @@ class Layer {
      * layer.
      */
     explicit Layer(const LayerParameter& param)
-        : layer_param_(param) {
+        : layer_param_(param), inference_only_(false) {
       // Set phase and copy blobs (if there are any).
       phase_ = param.phase();
       if (layer_param_.blobs_size() > 0) {
@@ -307,6 +307,18 @@ class Layer {
       param_propagate_down_[param_id] = value;
     }
 
+    /**
+     * @brief Tells the layer that Backward will never be called, so it may
+     *        skip the state only Backward needs, e.g. the max pooling
+     *        indices. Set by inference-only Net%s before SetUp.
+     */
+    inline void set_inference_only(const bool value) {
+      inference_only_ = value;
+    }
+    inline bool inference_only() const {
+      return inference_only_;
+    }
+
   protected:
     /** The protobuf that stores the layer parameters */
     LayerParameter layer_param_;
@@ -320,6 +332,8 @@ class Layer {
     /** The vector that indicates whether each top blob has a non-zero weight in
      *  the objective function. */
     vector<Dtype> loss_;
+    /** Whether Backward is never called, see set_inference_only. */
+    bool inference_only_;
 
     /** @brief Using the CPU device, compute the layer output. */
     virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -444,6 +458,7 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
     }
     break;
   case Caffe::GPU:
+  case Caffe::APU:
     Forward_gpu(bottom, top);
 #ifndef CPU_ONLY
     for (int top_id = 0; top_id < top.size(); ++top_id) {
@@ -473,6 +488,7 @@ inline void Layer<Dtype>::Backward(const vector<Blob<Dtype>*>& top,
     Backward_cpu(top, propagate_down, bottom);
     break;
   case Caffe::GPU:
+  case Caffe::APU:
     Backward_gpu(top, propagate_down, bottom);
     break;
   default:
@@ -14,6 +14,19 @@
 
 namespace caffe {
 
+template <typename Dtype> class FusedNeuronChain;
+
+/// @brief Per-layer timings accumulated by Net while profiling is enabled.
+struct LayerProfile {
+  LayerProfile()
+      : forward_ms(0), backward_ms(0), forward_calls(0), backward_calls(0) {
+  }
+  double forward_ms;
+  double backward_ms;
+  int forward_calls;
+  int backward_calls;
+};
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -191,10 +204,60 @@ class Net {
     const shared_ptr<Layer<Dtype> > layer_by_name(
         const string& layer_name) const;
 
+    /// @brief Bytes of data memory the blobs would take with private storage
+    inline size_t memory_used() const {
+      return memory_used_ * sizeof(Dtype);
+    }
+    /**
+     * @brief Bytes of data memory held by the blobs after memory planning,
+     *        or 0 if the net was not planned (see NetParameter.memory_optimize).
+     */
+    inline size_t memory_planned() const {
+      return memory_planned_;
+    }
+    /// @brief Whether the net only supports Forward, see
+    ///        NetParameter.inference_only.
+    inline bool inference_only() const {
+      return inference_only_;
+    }
+
     void set_debug_info(const bool value) {
       debug_info_ = value;
     }
 
+    /**
+     * @brief Enable or disable per-layer profiling. While enabled, Forward and
+     *        Backward wait for each layer to finish and accumulate its time.
+     */
+    void set_profile(const bool value) {
+      profile_ = value;
+    }
+    inline bool profile() const {
+      return profile_;
+    }
+    /// @brief returns the accumulated timings, indexed by layer id
+    inline const vector<LayerProfile>& layer_profiles() const {
+      return layer_profiles_;
+    }
+    /// @brief Reset the accumulated timings of every layer.
+    void ClearProfile() {
+      layer_profiles_.assign(layers_.size(), LayerProfile());
+    }
+    /**
+     * @brief The command queue of each layer, or empty if every layer runs on
+     *        the main queue (see NetParameter.concurrent_branches).
+     */
+    inline const vector<int>& layer_queues() const {
+      return layer_queues_;
+    }
+    /**
+     * @brief The last layer of the fused neuron chain starting at layer_id,
+     *        or layer_id if it starts none (see NetParameter.fuse_neurons).
+     */
+    inline int fused_chain_end(const int layer_id) const {
+      return fused_chain_end_[layer_id];
+    }
+
     // Helpers for Init.
     /**
      * @brief Remove layers that the user specified should be excluded given the current
@@ -231,6 +294,45 @@ class Net {
 
     /// @brief Get misc parameters, e.g. the LR multiplier and weight decay.
     void GetLearningRateAndWeightDecay();
+    /**
+     * @brief Compute the lifetime of every blob over the layer order and let
+     *        blobs with disjoint lifetimes share data storage.
+     */
+    void PlanMemory();
+    /**
+     * @brief Pick the packing number of every convolution layer by timing its
+     *        forward pass, reusing and extending the given tuning file.
+     */
+    void TunePacking(const string& tuning_file, const size_t memory_budget);
+    /**
+     * @brief Give independent branches of the net their own command queues:
+     *        a layer continues the queue of its first bottom's producer
+     *        unless another consumer already did, else it takes the next one.
+     *        Forward and Backward order every layer after the last writes
+     *        and the reads of the storage it touches, split tops included.
+     */
+    void AssignLayerQueues();
+    /// @brief Whether Forward and Backward switch queues per layer.
+    bool use_layer_queues() const;
+    /// @brief Release the diffs nothing reads in an inference-only net.
+    void DisableDiffs();
+    /**
+     * @brief Generate a FusedNeuronChain for every run of two or more
+     *        consecutive element-wise layers, each consuming the previous
+     *        one's top, whose intermediate blobs are not net outputs.
+     */
+    void FuseNeuronChains();
+    /**
+     * @brief Let every ConvolutionLayer directly followed by a ReLU in place
+     *        on its top apply the ReLU, see BaseConvolutionLayer::set_fused_relu.
+     */
+    void FuseConvReLU();
+    /// @brief The last layer of the fused chain Forward runs from layer_id
+    ///        within end, or layer_id to run the layer on its own.
+    int ForwardChainEnd(const int layer_id, const int end) const;
+    /// @brief The first layer of the fused chain Backward runs down from
+    ///        layer_id within end, or layer_id to run the layer on its own.
+    int BackwardChainStart(const int layer_id, const int end) const;
 
     /// @brief The network name
     string name_;
@@ -276,8 +378,28 @@ class Net {
     vector<float> params_weight_decay_;
     /// The bytes of memory used by this net
     size_t memory_used_;
+    /// The bytes of data memory held by the net after memory planning
+    size_t memory_planned_;
+    /// Whether the net only supports Forward
+    bool inference_only_;
     /// Whether to compute and display debug info for the net.
     bool debug_info_;
+    /// Whether to time each layer in Forward and Backward.
+    bool profile_;
+    /// The timings collected while profile_ is set, indexed by layer id
+    vector<LayerProfile> layer_profiles_;
+    /// The queue each layer is enqueued on, see AssignLayerQueues
+    vector<int> layer_queues_;
+    int num_layer_queues_;
+    /// The fused chain starting at each layer id, NULL if it starts none
+    vector<shared_ptr<FusedNeuronChain<Dtype> > > fused_chains_;
+    /// The last layer of the chain starting at each layer id and the first
+    /// layer of the chain ending at it; the layer itself if there is none
+    vector<int> fused_chain_end_;
+    vector<int> fused_chain_start_;
+    /// Whether the forward of each layer is done by the one before it, see
+    /// FuseConvReLU
+    vector<bool> layer_fused_;
 
     DISABLE_COPY_AND_ASSIGN (Net);
 };
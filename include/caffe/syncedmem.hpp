@@ -61,20 +61,27 @@ inline void CaffeFreeHost(void* ptr) {
  * @brief Manages memory allocation and synchronization between the host (CPU)
  *        and device (GPU).
  *
- * TODO(dox): more thorough description.
+ * Host to device copies are enqueued without waiting; the copy event is only
+ * waited on when the host writes the source again. Device to host copies wait
+ * for their own event instead of finishing the whole queue.
+ *
+ * Memory first touched in the APU brew is zero-copy: a single host-allocated
+ * buffer serves both sides, and cpu_data()/gpu_data() map and unmap it
+ * instead of copying. A host pointer is only valid until the next gpu_data()
+ * or mutable_gpu_data() call on the same memory.
  */
 class SyncedMemory {
   public:
     SyncedMemory()
-        : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED), own_cpu_data_(
-            false), data_layer_(false) {
+        : cpu_ptr_(NULL), gpu_ptr_(NULL), gpu_cache_ptr_(NULL), size_(0),
+          head_(UNINITIALIZED), own_cpu_data_(false), data_layer_(false) {
 #ifndef CPU_ONLY
      	ocl_setup();
 #endif
     }
     explicit SyncedMemory(size_t size)
-        : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED), own_cpu_data_(
-            false), data_layer_(false) {
+        : cpu_ptr_(NULL), gpu_ptr_(NULL), gpu_cache_ptr_(NULL), size_(size),
+          head_(UNINITIALIZED), own_cpu_data_(false), data_layer_(false) {
 #ifndef CPU_ONLY
 	ocl_setup();
 #endif
@@ -87,6 +94,17 @@ class SyncedMemory {
     const void* gpu_cache_data();
     void* mutable_cpu_data();
     void* mutable_gpu_data();
+#ifndef CPU_ONLY
+    // Starts copying host data to the device on CommandQueue_helper and
+    // returns at once, so that a prefetch thread can overlap the upload with
+    // compute on CommandQueue. Work using gpu_data() afterwards is ordered
+    // after the copy on the device, without blocking the host.
+    void async_gpu_push();
+    // Whether host and device share one buffer, see the class comment.
+    inline bool zero_copy() const {
+      return zero_copy_;
+    }
+#endif
     enum SyncedHead {
       UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED
     };
@@ -102,6 +120,32 @@ class SyncedMemory {
 #ifndef CPU_ONLY
   private:
     void ocl_setup();
+    // Blocks until the pending transfer is done and forgets it.
+    void wait_transfer();
+    // Makes CommandQueue wait for a pending transfer of another queue.
+    void order_gpu_after_transfer();
+    void set_transfer(cl_event event, bool other_queue);
+    // Records that work on the device buffer is enqueued on queue.
+    void note_gpu_use(cl_command_queue queue);
+    // An event completing once the device work enqueued so far on the
+    // buffer is done, NULL if there is none; the caller releases it.
+    cl_event gpu_last_use();
+    // Allocate or map/unmap the shared buffer of a zero-copy memory.
+    void zero_copy_to_cpu();
+    void zero_copy_to_gpu();
+
+    // the last copy between the host and device buffers, NULL once done
+    cl_event transfer_event_;
+    // whether the copy ran on a queue other than CommandQueue, which has not
+    // been ordered after it yet
+    bool transfer_other_queue_;
+    // gpu_cache_ptr_ is also the device buffer; cpu_ptr_ is NULL while it
+    // is unmapped
+    bool zero_copy_;
+    // the queue the device buffer was last used on, which the pool fences
+    // it on when it is freed; NULL if it was used on several
+    cl_command_queue last_queue_;
+    bool mixed_queues_;
 #endif
   protected:
     cl_kernel oclmem_kernel;
@@ -0,0 +1,43 @@
+#ifndef CAFFE_UTIL_DATUM_VIEW_HPP_
+#define CAFFE_UTIL_DATUM_VIEW_HPP_
+
+#include <cstddef>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief The fields of a Datum, with its pixels left where they are.
+ *
+ * Parse() reads a serialized Datum without copying its data bytes, which
+ * ParseFromString spends most of its time on for raw uint8 records. The
+ * view then points into the buffer it was parsed from, and is valid as
+ * long as the buffer is.
+ */
+struct DatumView {
+    DatumView();
+    // Views the fields of datum, which must outlive the view.
+    explicit DatumView(const Datum& datum);
+
+    // Parses a serialized Datum of raw uint8 pixels. Returns false for
+    // float_data, which can't be viewed in place, and malformed input;
+    // those must be parsed into a Datum.
+    bool Parse(const char* buffer, const size_t size);
+
+    int channels;
+    int height;
+    int width;
+    int label;
+    bool encoded;
+    // The data field, NULL if absent.
+    const char* data;
+    size_t data_size;
+    // The float_data field, NULL if absent. Only set from a Datum.
+    const float* float_data;
+    size_t float_data_size;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATUM_VIEW_HPP_
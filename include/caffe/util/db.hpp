@@ -23,8 +23,19 @@ class Cursor {
     virtual void Next() = 0;
     virtual string key() = 0;
     virtual string value() = 0;
+    // The value in place, valid until the cursor moves, which saves copying
+    // it out. Backends that can't hand out their storage copy it into a
+    // buffer of the cursor.
+    virtual void value_view(const char** data, size_t* size) {
+      value_buffer_ = value();
+      *data = value_buffer_.data();
+      *size = value_buffer_.size();
+    }
     virtual bool valid() = 0;
 
+  private:
+    string value_buffer_;
+
     DISABLE_COPY_AND_ASSIGN (Cursor);
 };
 
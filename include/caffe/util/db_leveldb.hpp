@@ -32,6 +32,11 @@ class LevelDBCursor: public Cursor {
     virtual string value() {
       return iter_->value().ToString();
     }
+    virtual void value_view(const char** data, size_t* size) {
+      const leveldb::Slice value = iter_->value();
+      *data = value.data();
+      *size = value.size();
+    }
     virtual bool valid() {
       return iter_->Valid();
     }
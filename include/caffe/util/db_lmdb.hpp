@@ -38,6 +38,10 @@ class LMDBCursor: public Cursor {
       return string(static_cast<const char*>(mdb_value_.mv_data),
           mdb_value_.mv_size);
     }
+    virtual void value_view(const char** data, size_t* size) {
+      *data = static_cast<const char*>(mdb_value_.mv_data);
+      *size = mdb_value_.mv_size;
+    }
     virtual bool valid() {
       return valid_;
     }
@@ -0,0 +1,139 @@
+#ifndef CAFFE_UTIL_DB_PACKED_HPP
+#define CAFFE_UTIL_DB_PACKED_HPP
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/util/db.hpp"
+
+namespace caffe {
+namespace db {
+
+// Precedes the key and value of every record of a PackedDB.
+struct PackedRecordHeader {
+    uint32_t key_size;
+    uint32_t value_size;
+};
+
+class PackedCursor: public Cursor {
+  public:
+    PackedCursor(const char* data, const uint64_t* index, const size_t size)
+        : data_(data), index_(index), size_(size), position_(0) {
+    }
+    virtual void SeekToFirst() {
+      position_ = 0;
+    }
+    virtual void Next() {
+      ++position_;
+    }
+    // Moves to the record put position-th, for random access.
+    void Seek(const size_t position) {
+      position_ = position;
+    }
+    virtual string key() {
+      const PackedRecordHeader* header = record();
+      return string(reinterpret_cast<const char*>(header + 1),
+          header->key_size);
+    }
+    virtual string value() {
+      const char* data;
+      size_t size;
+      value_view(&data, &size);
+      return string(data, size);
+    }
+    virtual void value_view(const char** data, size_t* size) {
+      const PackedRecordHeader* header = record();
+      *data = reinterpret_cast<const char*>(header + 1) + header->key_size;
+      *size = header->value_size;
+    }
+    virtual bool valid() {
+      return position_ < size_;
+    }
+
+  private:
+    inline const PackedRecordHeader* record() const {
+      CHECK_LT(position_, size_);
+      return reinterpret_cast<const PackedRecordHeader*>(
+          data_ + index_[position_]);
+    }
+
+    const char* data_;
+    const uint64_t* index_;
+    size_t size_;
+    size_t position_;
+};
+
+class PackedDB;
+
+class PackedTransaction: public Transaction {
+  public:
+    explicit PackedTransaction(PackedDB* db)
+        : db_(db) {
+    }
+    // Records are buffered until Commit.
+    virtual void Put(const string& key, const string& value);
+    virtual void Commit();
+
+  private:
+    PackedDB* db_;
+    string records_;
+    // Offsets in records_.
+    std::vector<uint64_t> offsets_;
+
+    DISABLE_COPY_AND_ASSIGN (PackedTransaction);
+};
+
+/**
+ * @brief A read-optimized store of records packed back to back in a file.
+ *
+ * The source is a directory of two files:
+ *   data:  records, each a PackedRecordHeader, the key, then the value,
+ *          padded to 8 bytes;
+ *   index: the offset of every record in data, as uint64.
+ * Both are appended to by transactions and memory-mapped for reading, so
+ * cursors hand out values in place and reads cost what the page cache
+ * does. Records are kept in the order they were put, not sorted by key, and
+ * in the byte order of the host that wrote them.
+ */
+class PackedDB: public DB {
+  public:
+    PackedDB()
+        : mode_(READ), data_fd_(-1), index_fd_(-1), data_size_(0),
+          num_records_(0), data_map_(NULL), index_map_(NULL) {
+    }
+    virtual ~PackedDB() {
+      Close();
+    }
+    virtual void Open(const string& source, Mode mode);
+    virtual void Close();
+    virtual PackedCursor* NewCursor();
+    virtual PackedTransaction* NewTransaction();
+
+    // Number of records.
+    inline size_t size() const {
+      return num_records_;
+    }
+
+  protected:
+    friend class PackedTransaction;
+    // Appends records holding the given offsets from their start.
+    void Append(const string& records, const std::vector<uint64_t>& offsets);
+
+    string source_;
+    Mode mode_;
+    int data_fd_;
+    int index_fd_;
+    // End of the last record in data.
+    uint64_t data_size_;
+    size_t num_records_;
+    // Mapped when reading.
+    char* data_map_;
+    uint64_t* index_map_;
+};
+
+}  // namespace db
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DB_PACKED_HPP
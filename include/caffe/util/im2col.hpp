@@ -34,6 +34,26 @@ void im2col_cpu(const Dtype* data_im, const int channels, const int height,
     const int width, const int kernel_h, const int kernel_w, const int pad_h,
     const int pad_w, const int stride_h, const int stride_w, Dtype* data_col);
 
+// im2col_cpu and col2im_cpu for 1x1 kernels without padding, where the
+// column buffer is just the strided subsampling of the image.
+template <typename Dtype>
+void im2col_1x1_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    Dtype* data_col);
+
+template <typename Dtype>
+void col2im_1x1_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    Dtype* data_im);
+
+// Packs optnum consecutive images into one column buffer whose rows hold the
+// columns of every image side by side.
+template <typename Dtype>
+void im2col_cpu_opt(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    Dtype* data_col, const int optnum);
+
 template <typename Dtype>
 void col2im_cpu(const Dtype* data_col, const int channels, const int height,
     const int width, const int patch_h, const int patch_w, const int pad_h,
@@ -0,0 +1,110 @@
+#ifndef CAFFE_UTIL_IMAGE_CACHE_HPP_
+#define CAFFE_UTIL_IMAGE_CACHE_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+struct ImageCacheStats {
+    ImageCacheStats()
+        : hits(0), disk_hits(0), misses(0), images_cached(0),
+          bytes_cached(0) {
+    }
+    // lookups served from memory
+    size_t hits;
+    // lookups served from the disk file
+    size_t disk_hits;
+    // lookups that found nothing, which the caller decodes
+    size_t misses;
+    // images and bytes held in memory
+    size_t images_cached;
+    size_t bytes_cached;
+    inline double hit_rate() const {
+      const size_t lookups = hits + disk_hits + misses;
+      return lookups ? static_cast<double>(hits + disk_hits) / lookups : 0;
+    }
+};
+
+/**
+ * @brief A cache of decoded images keyed by a string, e.g. their path and
+ *        decode parameters, so that data layers decode every image once.
+ *
+ * The memory tier holds up to capacity bytes of pixels. LRU evicts the
+ * least recently used images; FILL keeps the first images that fit and
+ * never evicts, which beats LRU on the cyclic access of epochs larger than
+ * the cache and holds a whole epoch when it fits.
+ *
+ * With a disk file, every image put is also appended to it, and the file is
+ * memory-mapped for reading. The file is reopened by later runs, so its
+ * keys must describe the decoded image completely. It is locked while open:
+ * a cache finding it locked by another, e.g. of the test net or of another
+ * process, only caches in memory.
+ *
+ * Not thread-safe: meant to be owned by the prefetch thread of one layer.
+ */
+class ImageCache {
+  public:
+    enum Policy {
+      LRU, FILL
+    };
+
+    ImageCache(const size_t capacity, const Policy policy,
+        const std::string& disk_file = "");
+    ~ImageCache();
+
+    // Looks key up in memory, then on disk. The image is shared with the
+    // cache and must not be modified.
+    bool Get(const std::string& key, cv::Mat* image);
+    void Put(const std::string& key, const cv::Mat& image);
+
+    inline const ImageCacheStats& stats() const {
+      return stats_;
+    }
+    // Whether the disk file is open, see the class comment.
+    inline bool disk_enabled() const {
+      return fd_ >= 0;
+    }
+
+  protected:
+    struct Entry {
+        std::string key;
+        cv::Mat image;
+    };
+    typedef std::list<Entry> EntryList;
+
+    // Adds image to the memory tier if the policy lets it in.
+    void Admit(const std::string& key, const cv::Mat& image);
+    void OpenDiskFile();
+    bool ReadFromDisk(const std::string& key, cv::Mat* image);
+    void AppendToDisk(const std::string& key, const cv::Mat& image);
+    // Maps at least the first size bytes of the disk file.
+    void MapDiskFile(const size_t size);
+
+    size_t capacity_;
+    Policy policy_;
+    ImageCacheStats stats_;
+    // Most recently used first.
+    EntryList entries_;
+    std::map<std::string, EntryList::iterator> index_;
+
+    std::string disk_file_;
+    int fd_;
+    // End of the last complete record.
+    size_t disk_size_;
+    char* map_;
+    size_t map_size_;
+    // Offset of the record of every key on disk.
+    std::map<std::string, size_t> disk_index_;
+
+    DISABLE_COPY_AND_ASSIGN (ImageCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IMAGE_CACHE_HPP_
@@ -137,6 +137,21 @@ cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
 
 void CVMatToDatum(const cv::Mat& cv_img, Datum* datum);
 
+/**
+ * @brief Serializes HDF5 calls, as stock libhdf5 isn't thread-safe.
+ *
+ * The hdf5_* helpers below take it themselves; code calling the HDF5 API
+ * directly, e.g. to open a file, holds one in the scope of the calls. Locks
+ * nest, so a caller may hold one over several helpers.
+ */
+class HDF5Lock {
+  public:
+    HDF5Lock();
+    ~HDF5Lock();
+
+    DISABLE_COPY_AND_ASSIGN (HDF5Lock);
+};
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(hid_t file_id, const char* dataset_name_,
     int min_dim, int max_dim, Blob<Dtype>* blob);
@@ -145,6 +160,17 @@ template <typename Dtype>
 void hdf5_load_nd_dataset(hid_t file_id, const char* dataset_name_, int min_dim,
     int max_dim, Blob<Dtype>* blob);
 
+// The size of the first dimension of a dataset.
+hsize_t hdf5_get_num_rows(hid_t file_id, const char* dataset_name_);
+
+// Reads num_rows rows of a dataset from start_row on, checking it like
+// hdf5_load_nd_dataset. The rows go to plain host memory rather than a
+// Blob, so that large chunks stay out of the device-mapped buffers.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(hid_t file_id, const char* dataset_name_,
+    int min_dim, int max_dim, hsize_t start_row, hsize_t num_rows,
+    vector<int>* shape, vector<Dtype>* data);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(const hid_t file_id, const string& dataset_name,
     const Blob<Dtype>& blob);
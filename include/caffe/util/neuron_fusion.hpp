@@ -0,0 +1,59 @@
+#ifndef CAFFE_UTIL_NEURON_FUSION_HPP_
+#define CAFFE_UTIL_NEURON_FUSION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+/**
+ * @brief One OpenCL kernel computing a chain of element-wise neuron layers
+ *        (ReLU, Sigmoid, TanH, AbsVal, BNLL, Power, Exp, Log, Threshold).
+ *
+ * The source is generated from the layer params, which are baked in as
+ * literals, and built through Device::BuildProgramFromSource. Forward reads
+ * the chain's bottom and writes its top once, keeping the intermediate
+ * values in registers. Backward recomputes them from the bottom data and
+ * multiplies the top diff by the derivative of every layer, so the bottom
+ * data must still hold the chain's input.
+ */
+template <typename Dtype>
+class FusedNeuronChain {
+  public:
+    // Whether a layer can be part of a chain; with_backward also requires
+    // that it has a gradient, which Threshold has not.
+    static bool CanFuse(const LayerParameter& param, const bool with_backward);
+
+    // Builds the kernels for params in forward order. Check valid() before
+    // use, as a generated program that fails to build is not fatal.
+    FusedNeuronChain(const std::vector<LayerParameter>& params,
+        const bool with_backward);
+    ~FusedNeuronChain();
+
+    inline bool valid() const {
+      return forward_kernel_ != NULL;
+    }
+    inline const std::string& source() const {
+      return source_;
+    }
+
+    void Forward_gpu(Blob<Dtype>* bottom, Blob<Dtype>* top);
+    void Backward_gpu(Blob<Dtype>* top, Blob<Dtype>* bottom);
+
+  protected:
+    std::string source_;
+    cl_kernel forward_kernel_;
+    cl_kernel backward_kernel_;
+
+    DISABLE_COPY_AND_ASSIGN (FusedNeuronChain);
+};
+#endif
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_NEURON_FUSION_HPP_
@@ -0,0 +1,107 @@
+#ifndef CAFFE_UTIL_OCL_BUFFER_POOL_HPP_
+#define CAFFE_UTIL_OCL_BUFFER_POOL_HPP_
+
+#include <map>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+struct BufferPoolStats {
+    BufferPoolStats()
+        : hits(0), misses(0), bytes_cached(0), bytes_in_use(0),
+          high_water(0) {
+    }
+    // allocations served from the cache
+    size_t hits;
+    // allocations that created a new buffer
+    size_t misses;
+    // bytes of free buffers held by the cache
+    size_t bytes_cached;
+    // bytes of buffers handed out and not freed yet
+    size_t bytes_in_use;
+    // peak of bytes_cached + bytes_in_use
+    size_t high_water;
+};
+
+/**
+ * @brief A size-bucketed cache of the cl_mem objects of one device.
+ *
+ * Sizes are rounded up to eight buckets per power of two, and a freed
+ * buffer is handed out again for any request of its bucket or the seven
+ * below it, so reshaping nets and per-batch blobs stop creating and
+ * releasing driver allocations. Mapped host buffers stay mapped while cached.
+ *
+ * Freed device buffers may still be used by commands on the queue they
+ * were last used on. They are reused as is by work enqueued on that queue,
+ * which is in order; a caller enqueueing on another queue gets them once
+ * those commands are done.
+ *
+ * Host buffers are mapped and unmapped on CommandQueue_helper, which unlike
+ * CommandQueue doesn't change once the device is set up, so that prefetch
+ * threads can allocate them while the net switches queues.
+ */
+class BufferPool {
+  public:
+    BufferPool();
+    ~BufferPool();
+
+    // Returns a CL_MEM_READ_WRITE buffer of at least size bytes, to be
+    // first used on queue.
+    cl_mem AllocateDevice(const size_t size, cl_command_queue queue);
+    // queue is the one the buffer was last used on, NULL if it was used on
+    // several, in which case it is fenced on every queue of the device.
+    void FreeDevice(cl_mem buffer, cl_command_queue queue);
+    // Returns a CL_MEM_ALLOC_HOST_PTR buffer of at least size bytes, mapped
+    // for reading and writing at *host_ptr.
+    cl_mem AllocateHost(const size_t size, void** host_ptr);
+    void FreeHost(cl_mem buffer, void* host_ptr);
+
+    // A disabled pool creates and releases every buffer; disabling it
+    // releases the cached ones.
+    void set_enabled(const bool enabled);
+    bool enabled() const;
+    // Releases every cached buffer. Buffers in use are not affected.
+    void Trim();
+
+    BufferPoolStats stats() const;
+    void ResetStats();
+
+    // The capacity of the buffers serving size bytes.
+    static size_t BucketSize(const size_t size);
+
+  protected:
+    struct Entry {
+        cl_mem buffer;
+        // the mapping of a host buffer
+        void* host_ptr;
+        // completes when the last commands using a device buffer are done
+        cl_event released;
+        // the queue released was enqueued on, NULL if it fences several
+        cl_command_queue queue;
+    };
+    typedef std::multimap<size_t, Entry> FreeList;
+
+    cl_mem Allocate(FreeList* free_list, const size_t size,
+        cl_command_queue queue, void** host_ptr);
+    void Free(FreeList* free_list, cl_mem buffer, void* host_ptr,
+        cl_command_queue queue);
+    static void Release(const Entry& entry);
+    void TrimLocked();
+
+    class sync;
+    shared_ptr<sync> sync_;
+
+    bool enabled_;
+    FreeList device_free_;
+    FreeList host_free_;
+    BufferPoolStats stats_;
+
+    DISABLE_COPY_AND_ASSIGN (BufferPool);
+};
+#endif
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_OCL_BUFFER_POOL_HPP_
@@ -0,0 +1,40 @@
+#ifndef CAFFE_UTIL_OCL_TUNING_HPP_
+#define CAFFE_UTIL_OCL_TUNING_HPP_
+
+#include <boost/function.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+/**
+ * @brief Launch configs worth timing for a kernel on amdDevice.
+ *
+ * Local sizes are powers of two from the preferred work group size multiple
+ * of the kernel up to its maximum work group size, both queried with
+ * clGetKernelWorkGroupInfo. Grid-stride kernels also try 1 to 16 items per
+ * work item.
+ */
+std::vector<LaunchConfig> LaunchCandidates(const std::string& kernel_name,
+    const bool grid_stride);
+
+/**
+ * @brief Times launch() under every candidate config of kernel_name and
+ *        keeps the fastest one in the launch profile of amdDevice.
+ *
+ * launch must enqueue kernel_name through its KernelHandle. Each candidate
+ * is run once to warm up, then timed over runs launches. Returns the chosen
+ * config, and its average time in milliseconds in best_ms if not NULL.
+ */
+LaunchConfig TuneLaunchConfig(const std::string& kernel_name,
+    const bool grid_stride, const boost::function<void()>& launch,
+    const int runs, float* best_ms = NULL);
+#endif
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_OCL_TUNING_HPP_
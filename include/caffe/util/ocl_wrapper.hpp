@@ -50,6 +50,16 @@ template <typename dtype> inline std::string get_dtype_suffix() {
 }
 
 #ifndef CPU_ONLY
+// A KernelHandle for the Dtype variant of a kernel, e.g. kernel_mul_float.
+// Held in a function-local static, there is one handle per Dtype.
+template <typename Dtype>
+class TypedKernelHandle : public KernelHandle {
+  public:
+    explicit TypedKernelHandle(const std::string& kernel_name)
+        : KernelHandle(kernel_name + get_dtype_suffix<Dtype>()) {
+    }
+};
+
 template <typename Dtype>
 void transform_gpu(Dtype* src, Dtype* dst, const int top_offset, const int N_,
     const int M_, const int packing_num);
@@ -200,6 +210,13 @@ template <typename Dtype>
 void ReLUBackward(const int count, const Dtype* top_diff,
     const Dtype* bottom_data, Dtype* bottom_diff, Dtype negative_slope);
 
+// In place on data + offset: adds bias[c] of channel c, skipped if bias is
+// NULL, then applies a ReLU with negative_slope.
+template <typename Dtype>
+void BiasReLUForward(const int count, const int channels,
+    const int spatial_dim, const Dtype* bias, Dtype* data, const int offset,
+    Dtype negative_slope);
+
 template <typename Dtype>
 void caffe_gpu_div(const int n, const Dtype* a, const Dtype* b, Dtype* y);
 
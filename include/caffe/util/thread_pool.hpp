@@ -0,0 +1,68 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace boost {
+class thread;
+}
+
+namespace caffe {
+
+/**
+ * @brief A fork-join pool for intra-op parallelism on the CPU.
+ *
+ * ParallelFor splits a range into contiguous chunks and runs them on the
+ * pool threads and the calling thread, returning once every chunk is done.
+ * Chunk boundaries only depend on the range, the grain and the pool size,
+ * so reductions combining per-chunk results in order are reproducible.
+ * A call made while the pool is busy (from another thread, or nested inside
+ * a chunk) runs serially on the caller instead of waiting.
+ */
+class ThreadPool {
+  public:
+    typedef boost::function<void(int, int)> RangeFunction;
+    typedef boost::function<void(int, int, int)> ChunkFunction;
+
+    // num_threads counts the calling thread, so a pool of one runs serially.
+    explicit ThreadPool(const int num_threads);
+    ~ThreadPool();
+
+    inline int size() const {
+      return threads_.size() + 1;
+    }
+
+    // Number of chunks ParallelFor will use for n elements; at most size().
+    // Every chunk is non-empty.
+    int NumChunks(const int n, const int grain) const;
+
+    // Calls fn(begin, end) for the chunks of [0, n), each at least grain
+    // elements long except for the last one.
+    void ParallelFor(const int n, const int grain, const RangeFunction& fn);
+
+    // Same as above, also passing the chunk index to fn(chunk, begin, end).
+    void ParallelForChunks(const int n, const int grain,
+        const ChunkFunction& fn);
+
+  protected:
+    // Elements per chunk, the last one excepted.
+    int ChunkSize(const int n, const int grain) const;
+    void WorkerEntry();
+    // Runs the chunks of the current job until none are left.
+    void RunChunks();
+
+    class sync;
+
+    std::vector<shared_ptr<boost::thread> > threads_;
+    shared_ptr<sync> sync_;
+
+    DISABLE_COPY_AND_ASSIGN (ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
@@ -0,0 +1,136 @@
+#ifndef CAFFE_UTIL_TRACE_HPP_
+#define CAFFE_UTIL_TRACE_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records a timeline of host work and OpenCL commands and writes it
+ *        as a Chrome trace (chrome://tracing, Perfetto).
+ *
+ * Host events are complete events on the track of the thread that recorded
+ * them, e.g. layer forward and backward passes, prefetch waits and loads.
+ * Device events are read from the profiling info of the cl_event of a
+ * command, which every queue is created with, and go on one track per
+ * queue. Device times are moved onto the host clock by a marker enqueued
+ * when recording starts, so the two agree to within its latency.
+ *
+ * Recording is off until Start(); until then TraceScope and the enqueue
+ * hooks cost a branch.
+ */
+class Tracer {
+  public:
+    static Tracer& Get();
+
+    // Drops the events recorded so far and starts recording.
+    void Start();
+    // Stops recording. Device events still in flight are waited for.
+    void Stop();
+    inline bool enabled() const {
+      return enabled_;
+    }
+
+    // Microseconds since Start().
+    double Now() const;
+    void AddHostEvent(const std::string& name, const char* category,
+        const double start_us, const double end_us);
+#ifndef CPU_ONLY
+    // Where an enqueue call should return its event: event when recording,
+    // NULL otherwise.
+    inline cl_event* event_out(cl_event* event) const {
+      *event = NULL;
+      return enabled_ ? event : NULL;
+    }
+    // Records a command once it completes; event is retained, the caller
+    // keeps its reference. NULL events are ignored.
+    void AddDeviceEvent(const std::string& name, const char* category,
+        cl_event event);
+#endif
+
+    // Number of events recorded, device events in flight included.
+    size_t num_events() const;
+    // Writes the events recorded so far. Returns false if the file can't be
+    // written.
+    bool Write(const std::string& file_name);
+
+  protected:
+    Tracer();
+
+    struct Event {
+        std::string name;
+        // a string literal
+        const char* category;
+        // 0 for host threads, 1 for device queues
+        int pid;
+        int tid;
+        double start_us;
+        double duration_us;
+    };
+#ifndef CPU_ONLY
+    struct DeviceEvent {
+        std::string name;
+        const char* category;
+        cl_event event;
+    };
+    // Moves the completed device events, or all of them if wait, to
+    // events_. Called with the lock held.
+    void ResolveDeviceEvents(const bool wait);
+#endif
+    // The track of the calling thread. Called with the lock held.
+    int ThreadTrack();
+
+    class sync;
+    shared_ptr<sync> sync_;
+
+    volatile bool enabled_;
+    boost::posix_time::ptime start_time_;
+    std::vector<Event> events_;
+    // Names of the host thread and device queue tracks, indexed by tid.
+    std::vector<std::string> thread_names_;
+    std::vector<std::string> queue_names_;
+#ifndef CPU_ONLY
+    std::vector<DeviceEvent> device_events_;
+    std::vector<cl_command_queue> queues_;
+    // Device time of Start() in nanoseconds.
+    cl_ulong device_start_ns_;
+#endif
+
+    DISABLE_COPY_AND_ASSIGN (Tracer);
+};
+
+// Records the lifetime of the scope as a host event while tracing.
+class TraceScope {
+  public:
+    TraceScope(const std::string& name, const char* category)
+        : category_(category), enabled_(Tracer::Get().enabled()),
+          start_us_(0) {
+      if (enabled_) {
+        name_ = name;
+        start_us_ = Tracer::Get().Now();
+      }
+    }
+    ~TraceScope() {
+      if (enabled_) {
+        Tracer::Get().AddHostEvent(name_, category_, start_us_,
+            Tracer::Get().Now());
+      }
+    }
+
+  protected:
+    std::string name_;
+    const char* category_;
+    const bool enabled_;
+    double start_us_;
+
+    DISABLE_COPY_AND_ASSIGN (TraceScope);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TRACE_HPP_
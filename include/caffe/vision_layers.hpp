@@ -1,6 +1,7 @@
 #ifndef CAFFE_VISION_LAYERS_HPP_
 #define CAFFE_VISION_LAYERS_HPP_
 
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -24,7 +25,7 @@ template <typename Dtype>
 class BaseConvolutionLayer: public Layer<Dtype> {
   public:
     explicit BaseConvolutionLayer(const LayerParameter& param)
-        : Layer<Dtype>(param) {
+        : Layer<Dtype>(param), fused_relu_(false), relu_negative_slope_(0) {
     }
     virtual ~BaseConvolutionLayer();
     virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
@@ -42,6 +43,33 @@ class BaseConvolutionLayer: public Layer<Dtype> {
       return true;
     }
 
+    // Packing numbers (images per gemm) worth timing for the current mode
+    // and shape; just 1 when the layer has no packed path.
+    vector<int> packing_candidates();
+    // Scratch memory in bytes used by the packed path for packing_num images.
+    size_t packing_memory(const int packing_num);
+    // Identifies the mode and shape a packing number is tuned for.
+    string packing_key();
+    // 0 lets the layer pick the packing number from its shape.
+    inline void set_packing_num(const int packing_num) {
+      CHECK_GE(packing_num, 0);
+      packing_num_ = packing_num;
+    }
+    inline int packing_num() const {
+      return packing_num_;
+    }
+    // Makes ConvolutionLayer apply a ReLU with negative_slope in the same
+    // pass as the bias, so that a ReLU layer run in place on its top can
+    // skip its forward. Set by Net, see NetParameter.fuse_conv_relu.
+    inline void set_fused_relu(const bool fused,
+        const Dtype negative_slope = Dtype(0)) {
+      fused_relu_ = fused;
+      relu_negative_slope_ = negative_slope;
+    }
+    inline bool fused_relu() const {
+      return fused_relu_;
+    }
+
   protected:
     // Helper functions that abstract away the column buffer and gemm arguments.
     // The last argument in forward_cpu_gemm is so that we can skip the im2col if
@@ -49,11 +77,17 @@ class BaseConvolutionLayer: public Layer<Dtype> {
     void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
         Dtype* output, bool skip_im2col = false);
     void forward_cpu_bias(Dtype* output, const Dtype* bias);
+    // Adds the bias, if any, and applies the fused ReLU to one image.
+    void forward_cpu_bias_relu(Dtype* output);
     void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
         Dtype* output);
     void weight_cpu_gemm(const Dtype* input, const Dtype* output,
         Dtype* weights);
     void backward_cpu_bias(Dtype* bias, const Dtype* input);
+    // Packed variant of forward_cpu_gemm: convolves optnum consecutive images
+    // with a single gemm per group, optnum <= cpu_opt_num_.
+    void forward_cpu_gemm_opt(const Dtype* input, const Dtype* weights,
+        Dtype* output, const int optnum);
     //opencl related setup
     void ocl_setup();
 
@@ -64,6 +98,9 @@ class BaseConvolutionLayer: public Layer<Dtype> {
         Dtype* output, bool skip_im2col = false);
     void forward_gpu_bias(Dtype* output, const Dtype* bias);
     void forward_gpu_bias_opt(Dtype* output, const Dtype* bias);
+    // Adds the bias, if any, and applies the fused ReLU to num images from
+    // top_offset_ in one kernel.
+    void forward_gpu_bias_relu(Dtype* output, const int num);
     void backward_gpu_gemm(const Dtype* input, const Dtype* weights,
         Dtype* col_output);
     void backward_gpu_gemm_opt(const Dtype* input, const Dtype* weights,
@@ -92,14 +129,46 @@ class BaseConvolutionLayer: public Layer<Dtype> {
     int height_out_, width_out_;
     bool bias_term_;
     bool is_1x1_;
+    // 1x1 kernel without padding but with a stride: the column buffer is a
+    // plain subsampling of the input.
+    bool is_strided_1x1_;
+    // Requested packing number, 0 for automatic.
+    int packing_num_;
+    // Number of images packed into one gemm by Forward_cpu; 1 disables it.
+    int cpu_opt_num_;
+    // See set_fused_relu.
+    bool fused_relu_;
+    Dtype relu_negative_slope_;
+#ifndef CPU_ONLY
+    // Number of images packed into one gemm by Forward_gpu and Backward_gpu.
+    int gpu_packing_num() const;
+#endif
 
   private:
+    // Picks cpu_opt_num_ for the current shape.
+    int cpu_packing_num();
     // wrap im2col/col2im so we don't have to remember the (long) argument lists
     inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
+      if (is_strided_1x1_) {
+        im2col_1x1_cpu(data, conv_in_channels_, conv_in_height_,
+            conv_in_width_, stride_h_, stride_w_, col_buff);
+        return;
+      }
       im2col_cpu(data, conv_in_channels_, conv_in_height_, conv_in_width_,
           kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_, col_buff);
     }
+    inline void conv_im2col_cpu_opt(const Dtype* data, Dtype* col_buff,
+        const int optnum) {
+      im2col_cpu_opt(data, conv_in_channels_, conv_in_height_, conv_in_width_,
+          kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_, col_buff,
+          optnum);
+    }
     inline void conv_col2im_cpu(const Dtype* col_buff, Dtype* data) {
+      if (is_strided_1x1_) {
+        col2im_1x1_cpu(col_buff, conv_in_channels_, conv_in_height_,
+            conv_in_width_, stride_h_, stride_w_, data);
+        return;
+      }
       col2im_cpu(col_buff, conv_in_channels_, conv_in_height_, conv_in_width_,
           kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_, stride_w_, data);
     }
@@ -118,11 +187,12 @@ class BaseConvolutionLayer: public Layer<Dtype> {
     inline void conv_im2col_gpu_opt(const Dtype* data) {
       im2col_gpu_opt(data, bottom_offset_, conv_in_channels_, conv_in_height_,
           conv_in_width_, kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_,
-          stride_w_, (Dtype*) transMem, 0,
+          stride_w_, (Dtype*) trans_mem(), 0,
           opt_num2);
     }
     inline void conv_col2im_gpu_opt(Dtype* data) {
-      col2im_gpu_opt((Dtype*) transMem, 0, conv_in_channels_, conv_in_height_,
+      col2im_gpu_opt((Dtype*) trans_mem(), 0, conv_in_channels_,
+          conv_in_height_,
           conv_in_width_, kernel_h_, kernel_w_, pad_h_, pad_w_, stride_h_,
           stride_w_, data, bottom_offset_,
           opt_num2);
@@ -133,8 +203,8 @@ class BaseConvolutionLayer: public Layer<Dtype> {
           M_ * opt_num2, opt_num2);
     }
     inline void conv_transpose_gpu(const Dtype* data) {
-      opttrans(data, top_offset_, 1, M_ * group_, N_, (Dtype*) subTopMem, 0,
-          opt_num2);
+      opttrans(data, top_offset_, 1, M_ * group_, N_, (Dtype*) sub_top_mem(),
+          0, opt_num2);
     }
   protected:
     inline void gpu_memset(Dtype* data, Dtype value, int count) {
@@ -152,6 +222,8 @@ class BaseConvolutionLayer: public Layer<Dtype> {
 
     Blob<Dtype> col_buffer_;
     Blob<Dtype> bias_multiplier_;
+    // gemm output of the packed path, scattered to the top afterwards
+    Blob<Dtype> output_buffer_opt_;
 
 //opencl related data structures
   protected:
@@ -161,9 +233,28 @@ class BaseConvolutionLayer: public Layer<Dtype> {
     int col_offset_;
     int output_offset_;
     int top_offset_, top_offset_opt, bottom_offset_;
+#ifndef CPU_ONLY
+    // Queues the group gemms are spread over, see Device::ForkQueues. A
+    // net running branches on the queues keeps the groups on the active one.
+    inline int group_queues() const {
+      return amdDevice.branch_queues() ? 1 :
+          std::min(group_, amdDevice.num_queues());
+    }
+#endif
   public:
-    static cl_mem subTopMem, transMem;
+    // Scratch of the packing scheme shared by all conv layers, one buffer
+    // per queue of amdDevice so that layers running on different queues
+    // don't overwrite each other's.
+    static std::vector<cl_mem> subTopMem, transMem;
     static size_t subtop_mem_size, trans_mem_size;
+#ifndef CPU_ONLY
+    static inline cl_mem sub_top_mem() {
+      return subTopMem[amdDevice.active_queue()];
+    }
+    static inline cl_mem trans_mem() {
+      return transMem[amdDevice.active_queue()];
+    }
+#endif
 };
 
 /**
@@ -286,6 +377,53 @@ class DeconvolutionLayer: public BaseConvolutionLayer<Dtype> {
     virtual void compute_output_shape();
 };
 
+/**
+ * @brief Winograd F(2x2, 3x3) implementation of ConvolutionLayer for the CPU.
+ *        Falls back to ConvolutionLayer for GPU mode and for Backward.
+ *
+ * Each 2x2 output tile is computed from a 4x4 input tile with 16 multiplies
+ * per input channel instead of 36. The transformed inputs of all the tiles
+ * of an image are multiplied by the transformed filters with 16 gemms per
+ * group. The filter transform is cached and only recomputed when the
+ * weights change. Only 3x3 kernels with stride 1 are supported; see
+ * GetConvolutionLayer for the fallback.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+  public:
+    explicit WinogradConvolutionLayer(const LayerParameter& param)
+        : ConvolutionLayer<Dtype>(param) {
+    }
+    virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+        const vector<Blob<Dtype>*>& top);
+    virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+        const vector<Blob<Dtype>*>& top);
+
+    // Whether conv_param describes a convolution this layer can run.
+    static bool IsSupported(const ConvolutionParameter& conv_param);
+
+  protected:
+    virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+        const vector<Blob<Dtype>*>& top);
+
+    // Recomputes filter_transform_ if the weights changed since last time.
+    void TransformFilters();
+    // Scatters the 4x4 input tiles of one image into input_transform_.
+    void TransformInput(const Dtype* input);
+    // Gathers the 2x2 output tiles of one image from output_transform_.
+    void TransformOutput(Dtype* output);
+
+    int tiles_h_, tiles_w_;
+    // 16 x num_output x (channels / group): G g G^T of every filter
+    Blob<Dtype> filter_transform_;
+    // 16 x channels x tiles: B^T d B of every input tile
+    Blob<Dtype> input_transform_;
+    // 16 x num_output x tiles: elementwise products summed over channels
+    Blob<Dtype> output_transform_;
+    // the weights filter_transform_ was computed from
+    Blob<Dtype> transformed_weights_;
+};
+
 #ifdef USE_CUDNN
 /*
  * @brief cuDNN implementation of ConvolutionLayer.
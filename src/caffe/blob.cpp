@@ -33,7 +33,9 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
   if (count_ > capacity_) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
-    diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    if (!diff_disabled_) {
+      diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    }
   }
 }
 
@@ -55,16 +57,22 @@ void Blob<Dtype>::ReshapeLike(const Blob<Dtype>& other) {
 template <typename Dtype>
 Blob<Dtype>::Blob(const int num, const int channels, const int height,
     const int width)
-    : capacity_(0) {
+    : capacity_(0), diff_disabled_(false) {
   Reshape(num, channels, height, width);
 }
 
 template <typename Dtype>
 Blob<Dtype>::Blob(const vector<int>& shape)
-    : capacity_(0) {
+    : capacity_(0), diff_disabled_(false) {
   Reshape(shape);
 }
 
+template <typename Dtype>
+void Blob<Dtype>::DisableDiff() {
+  diff_disabled_ = true;
+  diff_.reset();
+}
+
 template <typename Dtype>
 const Dtype* Blob<Dtype>::cpu_data() const {
   CHECK (data_);
@@ -134,7 +142,16 @@ void Blob<Dtype>::ShareData(const Blob& other) {
 template <typename Dtype>
 void Blob<Dtype>::ShareDiff(const Blob& other) {
   CHECK_EQ(count_, other.count());
-  diff_ = other.diff();
+  // A disabled diff is shared as such, see DisableDiff.
+  diff_ = other.diff_;
+  diff_disabled_ = other.diff_disabled_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::SetDataStorage(const shared_ptr<SyncedMemory>& storage) {
+  CHECK(storage);
+  CHECK_GE(storage->size(), count_ * sizeof(Dtype));
+  data_ = storage;
 }
 
 // The "update" method is used for parameter blobs in a Net, which are stored
@@ -149,6 +166,7 @@ template <> void Blob<int>::Update() {
 
 template <typename Dtype>
 void Blob<Dtype>::Update() {
+  CHECK(diff_);
   // We will perform update based on where the data is located.
   switch (data_->head()) {
   case SyncedMemory::HEAD_AT_CPU:
@@ -425,6 +443,7 @@ void Blob<Dtype>::CopyFrom(const Blob& source, bool copy_diff, bool reshape) {
   }
   switch (Caffe::mode()) {
   case Caffe::GPU:
+  case Caffe::APU:
     if (copy_diff) {
       caffe_gpu_copy(count_, source.gpu_diff(),
           static_cast<Dtype*>(diff_->mutable_gpu_data()));
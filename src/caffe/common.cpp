@@ -3,12 +3,27 @@
 #include <ctime>
 
 #include "caffe/common.hpp"
+#include "caffe/util/ocl_buffer_pool.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 shared_ptr<Caffe> Caffe::singleton_;
 
+void Caffe::set_cpu_threads(const int num_threads) {
+  CHECK_GT(num_threads, 0);
+  Caffe& caffe = Get();
+  if (num_threads == caffe.cpu_threads_) {
+    return;
+  }
+  caffe.cpu_threads_ = num_threads;
+  caffe.cpu_thread_pool_.reset();
+  if (num_threads > 1) {
+    caffe.cpu_thread_pool_.reset(new ThreadPool(num_threads));
+  }
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   //To fix: for now we use fixed seed to get same result each time
@@ -42,7 +57,8 @@ void GlobalInit(int* pargc, char*** pargv) {
 #ifdef CPU_ONLY  // CPU-only Caffe.
 
 Caffe::Caffe()
-: random_generator_(), mode_(Caffe::CPU) {
+: random_generator_(), mode_(Caffe::CPU), cpu_threads_(1),
+  cpu_grain_(32768) {
 }
 
 Caffe::~Caffe() {
@@ -85,7 +101,8 @@ void* Caffe::RNG::generator() {
 
 #else  // Normal GPU + CPU Caffe.
 
-Caffe::Caffe() {
+Caffe::Caffe()
+: cpu_threads_(1), cpu_grain_(32768) {
   amdDevice.Init();
   cl_int err = clblasSetup();
   if (err != CL_SUCCESS) {
@@ -115,6 +132,14 @@ void Caffe::DeviceQuery() {
   amdDevice.DeviceQuery();
 }
 
+void Caffe::set_buffer_pool(const bool enabled) {
+  amdDevice.buffer_pool().set_enabled(enabled);
+}
+
+void Caffe::TrimBufferPool() {
+  amdDevice.buffer_pool().Trim();
+}
+
 class Caffe::RNG::Generator {
   public:
     Generator()
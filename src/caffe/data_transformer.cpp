@@ -35,23 +35,26 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
 }
 
 template <typename Dtype>
-void DataTransformer<Dtype>::Transform(const Datum& datum,
+void DataTransformer<Dtype>::Transform(const DatumView& datum,
     Dtype* transformed_data) {
-  const string& data = datum.data();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
+  const char* data = datum.data;
+  const int datum_channels = datum.channels;
+  const int datum_height = datum.height;
+  const int datum_width = datum.width;
 
   const int crop_size = param_.crop_size();
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = datum.data_size > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
   CHECK_GE(datum_width, crop_size);
+  // Views come straight from the db, so their sizes are checked.
+  CHECK_GE(has_uint8 ? datum.data_size : datum.float_data_size,
+      static_cast<size_t>(datum_channels) * datum_height * datum_width);
 
   Dtype* mean = NULL;
   if (has_mean_file) {
@@ -105,7 +108,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
           datum_element =
               static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
         } else {
-          datum_element = datum.float_data(data_index);
+          datum_element = datum.float_data[data_index];
         }
         if (has_mean_file) {
           transformed_data[top_index] = (datum_element - mean[data_index])
@@ -145,11 +148,17 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
       LOG(ERROR) << "force_color and force_gray only for encoded datum";
     }
   }
+  Transform(DatumView(datum), transformed_blob);
+}
 
+template <typename Dtype>
+void DataTransformer<Dtype>::Transform(const DatumView& datum,
+    Blob<Dtype>* transformed_blob) {
+  CHECK(!datum.encoded) << "Encoded data must be decoded from a Datum";
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
+  const int datum_channels = datum.channels;
+  const int datum_height = datum.height;
+  const int datum_width = datum.width;
 
   // Check dimensions.
   const int channels = transformed_blob->channels();
@@ -443,11 +452,16 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
     // InferBlobShape using the cv::image.
     return InferBlobShape(cv_img);
   }
+  return InferBlobShape(DatumView(datum));
+}
 
+template <typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const DatumView& datum) {
+  CHECK(!datum.encoded) << "Encoded data must be decoded from a Datum";
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
+  const int datum_channels = datum.channels;
+  const int datum_height = datum.height;
+  const int datum_width = datum.width;
   // Check dimensions.
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
@@ -506,11 +520,22 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(
 
 template <typename Dtype>
 void DataTransformer<Dtype>::InitRand() {
+  const bool needs_rand = param_.mirror()
+      || (phase_ == TRAIN && param_.crop_size());
+  // Only draw from the Caffe RNG when needed to keep its sequence unchanged.
+  if (needs_rand) {
+    InitRand(caffe_rng_rand());
+  } else {
+    rng_.reset();
+  }
+}
+
+template <typename Dtype>
+void DataTransformer<Dtype>::InitRand(unsigned int seed) {
   const bool needs_rand = param_.mirror()
       || (phase_ == TRAIN && param_.crop_size());
   if (needs_rand) {
-    const unsigned int rng_seed = caffe_rng_rand();
-    rng_.reset(new Caffe::RNG(rng_seed));
+    rng_.reset(new Caffe::RNG(seed));
   } else {
     rng_.reset();
   }
@@ -24,26 +24,94 @@
  * POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************************/
 
+#include <boost/thread.hpp>
+
 #include "caffe/common.hpp"
 #include "caffe/device.hpp"
+#include "caffe/util/ocl_buffer_pool.hpp"
+#include "caffe/util/trace.hpp"
 #include <stdio.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <malloc.h>
 #include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <deque>
 
 namespace caffe {
 #ifndef CPU_ONLY
 string buildOption = "-x clc++ ";
 std::string oclKernelPath = "./src/caffe/ocl/";
+std::string oclBinaryCachePath = "./.oclcache/";
+cl_device_type oclDeviceType = CL_DEVICE_TYPE_GPU;
+int oclNumQueues = 4;
 Device amdDevice;
 
+static const char kProgramBinaryMagic[8] = { 'C', 'A', 'F', 'F', 'E', 'C',
+    'L', 'B' };
+
+// 64-bit FNV-1a, used to key cached program binaries.
+static unsigned long long HashString(const std::string& str) {
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < str.size(); ++i) {
+    hash ^= (unsigned char) str[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Thread-local kernel instances are released when their thread exits.
+static void ReleaseThreadKernels(std::vector<cl_kernel>* kernels) {
+  for (int i = 0; i < kernels->size(); ++i) {
+    if ((*kernels)[i] != NULL) {
+      clReleaseKernel((*kernels)[i]);
+    }
+  }
+  delete kernels;
+}
+
+class Device::KernelTable {
+  public:
+    KernelTable()
+        : thread_kernels_(&ReleaseThreadKernels) {
+    }
+
+    boost::mutex mutex_;  // guards everything but thread_kernels_
+    std::vector<std::string> names_;
+    std::map<std::string, int> ids_;
+    // indexed by kernel id; a deque so KernelHandle can keep pointers
+    std::deque<LaunchConfig> configs_;
+    // launch profile by kernel name, including kernels not registered yet
+    std::map<std::string, LaunchConfig> profile_;
+    // indexed by kernel id, created on first use by each thread
+    boost::thread_specific_ptr<std::vector<cl_kernel> > thread_kernels_;
+    // programs of BuildProgramFromSource by source
+    std::map<std::string, cl_program> generated_programs_;
+};
+
+Device::Device()
+    : numPlatforms(0), numDevices(0), device_id(INT_MIN),
+      kernel_table_(new KernelTable()), buffer_pool_(new BufferPool()),
+      active_queue_(0), branch_queues_(false) {
+}
+
 Device::~Device() {
+  buffer_pool_->Trim();
   ReleaseKernels();
   free((void*) platformIDs);
   free (DeviceIDs);
   clReleaseProgram (Program);
-  clReleaseCommandQueue (CommandQueue);
+  std::map<std::string, cl_program>::iterator program;
+  for (program = kernel_table_->generated_programs_.begin();
+      program != kernel_table_->generated_programs_.end(); ++program) {
+    clReleaseProgram(program->second);
+  }
+  for (int i = 0; i < queues_.size(); ++i) {
+    clReleaseCommandQueue(queues_[i]);
+  }
   clReleaseCommandQueue (CommandQueue_helper);
   clReleaseContext (Context);
   LOG(INFO) << "device destructor";
@@ -69,16 +137,19 @@ cl_int Device::Init(int deviceId) {
   GetDeviceInfo();
   cl_uint uiNumDevices;
   cl_bool unified_memory = false;
-  clGetDeviceIDs(PlatformIDs[0], CL_DEVICE_TYPE_GPU, 0, NULL, &numDevices);
+  clGetDeviceIDs(PlatformIDs[0], oclDeviceType, 0, NULL, &numDevices);
   uiNumDevices = numDevices;
   if (0 == uiNumDevices) {
-    LOG(FATAL) << "Err: No GPU devices";
+    LOG(FATAL) << "Err: No OpenCL devices of type " << oclDeviceType;
   } else {
     pDevices = (cl_device_id *) malloc(uiNumDevices * sizeof(cl_device_id));
     OCL_CHECK(
-        clGetDeviceIDs(PlatformIDs[0], CL_DEVICE_TYPE_GPU, uiNumDevices,
+        clGetDeviceIDs(PlatformIDs[0], oclDeviceType, uiNumDevices,
             pDevices, &uiNumDevices));
-    if (deviceId == -1) {
+    if (deviceId == -1 && oclDeviceType != CL_DEVICE_TYPE_GPU) {
+      device_id = 0;
+      LOG(INFO) << "Picked default device " << device_id;
+    } else if (deviceId == -1) {
       int i;
       for (i = 0; i < (int) uiNumDevices; i++) {
         clGetDeviceInfo(pDevices[i], CL_DEVICE_HOST_UNIFIED_MEMORY,
@@ -103,6 +174,8 @@ cl_int Device::Init(int deviceId) {
     }
   }
 
+  // Cached buffers belong to the context of the previous device.
+  buffer_pool_->Trim();
   Context = clCreateContext(NULL, 1, pDevices, NULL, NULL, NULL);
   if (NULL == Context) {
     fprintf(stderr, "Err: Failed to Create Context\n");
@@ -116,12 +189,99 @@ cl_int Device::Init(int deviceId) {
     fprintf(stderr, "Err: Failed to Create Commandqueue\n");
     return 0;
   }
+  queues_.assign(1, CommandQueue);
+  active_queue_ = 0;
+  for (int i = 1; i < oclNumQueues; ++i) {
+    cl_int err = CL_SUCCESS;
+    queues_.push_back(clCreateCommandQueue(Context, pDevices[0],
+        CL_QUEUE_PROFILING_ENABLE, &err));
+    OCL_CHECK(err);
+  }
   BuildProgram (oclKernelPath);
+  const std::string profile_file = LaunchProfilePath();
+  if (!profile_file.empty() && LoadLaunchProfile(profile_file)) {
+    LOG(INFO) << "Loaded launch profile " << profile_file;
+  }
   row = clblasRowMajor;
   col = clblasColumnMajor;
   return 0;
 }
 
+void Device::SetActiveQueue(const int queue_id) {
+  CHECK_GE(queue_id, 0);
+  CHECK_LT(queue_id, num_queues());
+  active_queue_ = queue_id;
+  CommandQueue = queues_[queue_id];
+}
+
+cl_command_queue Device::ForkedQueue(const int k) const {
+  return queues_[(active_queue_ + k) % queues_.size()];
+}
+
+void Device::ForkQueues(const int n) {
+  const int num_forked = std::min(n, num_queues());
+  if (num_forked <= 1) {
+    return;
+  }
+  cl_event event = NULL;
+  OCL_CHECK(clEnqueueMarkerWithWaitList(CommandQueue, 0, NULL, &event));
+  OCL_CHECK(clFlush(CommandQueue));
+  for (int k = 1; k < num_forked; ++k) {
+    OCL_CHECK(clEnqueueBarrierWithWaitList(ForkedQueue(k), 1, &event, NULL));
+  }
+  OCL_CHECK(clReleaseEvent(event));
+}
+
+void Device::JoinQueues(const int n) {
+  const int num_forked = std::min(n, num_queues());
+  if (num_forked <= 1) {
+    return;
+  }
+  std::vector<cl_event> events(num_forked - 1);
+  for (int k = 1; k < num_forked; ++k) {
+    OCL_CHECK(
+        clEnqueueMarkerWithWaitList(ForkedQueue(k), 0, NULL, &events[k - 1]));
+    OCL_CHECK(clFlush(ForkedQueue(k)));
+  }
+  OCL_CHECK(
+      clEnqueueBarrierWithWaitList(CommandQueue, events.size(), &events[0],
+          NULL));
+  for (int i = 0; i < events.size(); ++i) {
+    OCL_CHECK(clReleaseEvent(events[i]));
+  }
+}
+
+void Device::WaitForQueue(const int queue_id) {
+  if (queue_id == active_queue_) {
+    return;
+  }
+  cl_event event = NULL;
+  OCL_CHECK(
+      clEnqueueMarkerWithWaitList(queues_[queue_id], 0, NULL, &event));
+  OCL_CHECK(clFlush(queues_[queue_id]));
+  OCL_CHECK(clEnqueueBarrierWithWaitList(CommandQueue, 1, &event, NULL));
+  OCL_CHECK(clReleaseEvent(event));
+}
+
+cl_event Device::MarkAllQueues() {
+  // The helper queue is in order, so the marker on it needs no wait for it.
+  std::vector<cl_event> markers(queues_.size());
+  for (int i = 0; i < queues_.size(); ++i) {
+    OCL_CHECK(
+        clEnqueueMarkerWithWaitList(queues_[i], 0, NULL, &markers[i]));
+    OCL_CHECK(clFlush(queues_[i]));
+  }
+  cl_event event = NULL;
+  OCL_CHECK(
+      clEnqueueMarkerWithWaitList(CommandQueue_helper, markers.size(),
+          &markers[0], &event));
+  OCL_CHECK(clFlush(CommandQueue_helper));
+  for (int i = 0; i < markers.size(); ++i) {
+    OCL_CHECK(clReleaseEvent(markers[i]));
+  }
+  return event;
+}
+
 void Device::BuildProgram(std::string kernel_dir) {
   std::string strSource = "";
   DIR *ocl_dir;
@@ -129,6 +289,7 @@ void Device::BuildProgram(std::string kernel_dir) {
   if ((ocl_dir = opendir(kernel_dir.c_str())) == NULL) {
     fprintf(stderr, "Err: Open ocl dir failed!\n");
   }
+  std::vector<std::string> file_names;
   while ((dirp = readdir(ocl_dir)) != NULL) {
     //Ignore hidden files
     if (dirp->d_name[0] == '.')
@@ -138,12 +299,31 @@ void Device::BuildProgram(std::string kernel_dir) {
     size_t last_dot_pos = file_name.find_last_of(".");
     if (file_name.substr(last_dot_pos + 1) != "cl")
       continue;
-
-    std::string ocl_kernel_full_path = kernel_dir + file_name;
+    file_names.push_back(file_name);
+  }
+  closedir(ocl_dir);
+  //Concatenate in a fixed order so the cache key does not depend on readdir
+  std::sort(file_names.begin(), file_names.end());
+  for (int i = 0; i < file_names.size(); ++i) {
+    std::string ocl_kernel_full_path = kernel_dir + file_names[i];
     std::string tmpSource = "";
     ConvertToString(ocl_kernel_full_path.c_str(), tmpSource);
     strSource += tmpSource;
   }
+  // Programs are cached per source, build options and device/driver, so any
+  // change to one of them simply misses the cache and rebuilds from source.
+  std::string binary_file = "";
+  unsigned long long key = HashString(
+      strSource + '\0' + buildOption + '\0' + DeviceSignature());
+  if (!oclBinaryCachePath.empty()) {
+    std::ostringstream file_name;
+    file_name << oclBinaryCachePath << "caffe_" << std::hex << key << ".bin";
+    binary_file = file_name.str();
+    if (LoadProgramBinary(binary_file, key, &Program)) {
+      LOG(INFO) << "Loaded program binary " << binary_file;
+      return;
+    }
+  }
   const char *pSource;
   pSource = strSource.c_str();
   size_t uiArrSourceSize[] = { 0 };
@@ -164,7 +344,159 @@ void Device::BuildProgram(std::string kernel_dir) {
         sizeof(szBuildLog), szBuildLog, NULL);
     std::cout << szBuildLog;
     clReleaseProgram (Program);
+    return;
+  }
+  if (!binary_file.empty()) {
+    SaveProgramBinary(binary_file, key, Program);
+  }
+}
+
+cl_program Device::BuildProgramFromSource(const std::string& source) {
+  // Held while building so that nets set up by several threads build each
+  // source once.
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+  std::map<std::string, cl_program>::iterator it =
+      kernel_table_->generated_programs_.find(source);
+  if (it != kernel_table_->generated_programs_.end()) {
+    return it->second;
+  }
+  cl_program program = NULL;
+  std::string binary_file = "";
+  unsigned long long key = HashString(
+      source + '\0' + buildOption + '\0' + DeviceSignature());
+  if (!oclBinaryCachePath.empty()) {
+    std::ostringstream file_name;
+    file_name << oclBinaryCachePath << "caffe_gen_" << std::hex << key
+        << ".bin";
+    binary_file = file_name.str();
+    LoadProgramBinary(binary_file, key, &program);
+  }
+  if (program == NULL) {
+    const char* pSource = source.c_str();
+    const size_t uiSourceSize = source.size();
+    cl_int err = CL_SUCCESS;
+    program = clCreateProgramWithSource(Context, 1, &pSource, &uiSourceSize,
+        &err);
+    OCL_CHECK(err);
+    err = clBuildProgram(program, 1, pDevices, buildOption.c_str(), NULL,
+        NULL);
+    if (CL_SUCCESS != err) {
+      char szBuildLog[16384] = { 0 };
+      clGetProgramBuildInfo(program, *pDevices, CL_PROGRAM_BUILD_LOG,
+          sizeof(szBuildLog) - 1, szBuildLog, NULL);
+      LOG(ERROR) << "Failed to build generated program:\n" << szBuildLog
+          << "\n" << source;
+      clReleaseProgram(program);
+      return NULL;
+    }
+    if (!binary_file.empty()) {
+      SaveProgramBinary(binary_file, key, program);
+    }
+  }
+  kernel_table_->generated_programs_[source] = program;
+  return program;
+}
+
+// Identifies the device and driver a program binary was built for.
+std::string Device::DeviceSignature() {
+  const cl_device_info device_infos[] = { CL_DEVICE_NAME, CL_DEVICE_VENDOR,
+      CL_DEVICE_VERSION, CL_DRIVER_VERSION };
+  char platform_version[256] = { 0 };
+  clGetPlatformInfo(platformIDs[0], CL_PLATFORM_VERSION,
+      sizeof(platform_version) - 1, platform_version, NULL);
+  std::string signature = std::string(platformName) + '|' + platform_version;
+  for (int i = 0; i < sizeof(device_infos) / sizeof(device_infos[0]); ++i) {
+    char info[256] = { 0 };
+    clGetDeviceInfo(pDevices[0], device_infos[i], sizeof(info) - 1, info,
+        NULL);
+    signature += '|';
+    signature += info;
   }
+  return signature;
+}
+
+bool Device::LoadProgramBinary(std::string file_name, unsigned long long key,
+    cl_program* program) {
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  char magic[sizeof(kProgramBinaryMagic)];
+  unsigned long long file_key = 0;
+  unsigned long long binary_size = 0;
+  file.read(magic, sizeof(magic));
+  file.read((char*) &file_key, sizeof(file_key));
+  file.read((char*) &binary_size, sizeof(binary_size));
+  if (!file || memcmp(magic, kProgramBinaryMagic, sizeof(magic)) != 0
+      || file_key != key || binary_size == 0) {
+    LOG(INFO) << "Ignoring stale program binary " << file_name;
+    return false;
+  }
+  std::vector<unsigned char> binary(binary_size);
+  file.read((char*) &binary[0], binary_size);
+  if (!file) {
+    LOG(INFO) << "Ignoring truncated program binary " << file_name;
+    return false;
+  }
+  const unsigned char* pBinary = &binary[0];
+  size_t uiBinarySize = binary_size;
+  cl_int binary_status = CL_SUCCESS;
+  cl_int err = CL_SUCCESS;
+  *program = clCreateProgramWithBinary(Context, 1, pDevices, &uiBinarySize,
+      &pBinary, &binary_status, &err);
+  if (CL_SUCCESS != err || CL_SUCCESS != binary_status) {
+    LOG(INFO) << "Device rejected program binary " << file_name;
+    *program = NULL;
+    return false;
+  }
+  err = clBuildProgram(*program, 1, pDevices, buildOption.c_str(), NULL,
+      NULL);
+  if (CL_SUCCESS != err) {
+    LOG(INFO) << "Failed to build program binary " << file_name;
+    clReleaseProgram(*program);
+    *program = NULL;
+    return false;
+  }
+  return true;
+}
+
+void Device::SaveProgramBinary(std::string file_name, unsigned long long key,
+    cl_program program) {
+  size_t uiBinarySize = 0;
+  if (CL_SUCCESS != clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+      sizeof(uiBinarySize), &uiBinarySize, NULL) || uiBinarySize == 0) {
+    LOG(WARNING) << "Program binary is not available for caching";
+    return;
+  }
+  std::vector<unsigned char> binary(uiBinarySize);
+  unsigned char* pBinary = &binary[0];
+  OCL_CHECK(
+      clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(pBinary),
+          &pBinary, NULL));
+  mkdir(oclBinaryCachePath.c_str(), 0755);
+  // Write to a temporary file first so concurrent processes never load a
+  // partially written binary.
+  std::ostringstream tmp_name;
+  tmp_name << file_name << "." << getpid() << ".tmp";
+  std::ofstream file(tmp_name.str().c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    LOG(WARNING) << "Failed to open " << tmp_name.str()
+        << " for caching program binary";
+    return;
+  }
+  unsigned long long binary_size = uiBinarySize;
+  file.write(kProgramBinaryMagic, sizeof(kProgramBinaryMagic));
+  file.write((const char*) &key, sizeof(key));
+  file.write((const char*) &binary_size, sizeof(binary_size));
+  file.write((const char*) pBinary, uiBinarySize);
+  file.close();
+  if (!file || rename(tmp_name.str().c_str(), file_name.c_str()) != 0) {
+    LOG(WARNING) << "Failed to cache program binary " << file_name;
+    remove(tmp_name.str().c_str());
+    return;
+  }
+  LOG(INFO) << "Cached program binary " << file_name;
 }
 
 //Use to read OpenCL source code
@@ -196,6 +528,7 @@ cl_int Device::ConvertToString(std::string pFileName, std::string &Str) {
 }
 
 cl_kernel Device::GetKernel(std::string kernel_name) {
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
   std::map<std::string, cl_kernel>::iterator it = Kernels.find(kernel_name);
   if (it == Kernels.end()) {
     cl_int _err = 0;
@@ -211,6 +544,159 @@ void Device::ReleaseKernels() {
   for (it = Kernels.begin(); it != Kernels.end(); it++) {
     clReleaseKernel(it->second);
   }
+  Kernels.clear();
+  kernel_table_->thread_kernels_.reset();
+}
+
+std::string Device::KernelName(int kernel_id) {
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+  CHECK_LT(kernel_id, kernel_table_->names_.size());
+  return kernel_table_->names_[kernel_id];
+}
+
+int Device::RegisterKernel(const std::string& kernel_name) {
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+  std::map<std::string, int>::iterator it =
+      kernel_table_->ids_.find(kernel_name);
+  if (it != kernel_table_->ids_.end()) {
+    return it->second;
+  }
+  const int kernel_id = kernel_table_->names_.size();
+  kernel_table_->names_.push_back(kernel_name);
+  kernel_table_->ids_[kernel_name] = kernel_id;
+  std::map<std::string, LaunchConfig>::iterator config =
+      kernel_table_->profile_.find(kernel_name);
+  kernel_table_->configs_.push_back(
+      config == kernel_table_->profile_.end() ?
+          LaunchConfig() : config->second);
+  return kernel_id;
+}
+
+cl_kernel Device::GetKernel(int kernel_id) {
+  std::vector<cl_kernel>* kernels = kernel_table_->thread_kernels_.get();
+  if (kernels == NULL) {
+    kernels = new std::vector<cl_kernel>();
+    kernel_table_->thread_kernels_.reset(kernels);
+  }
+  if (kernel_id >= kernels->size()) {
+    kernels->resize(kernel_id + 1, NULL);
+  }
+  cl_kernel& kernel = (*kernels)[kernel_id];
+  if (kernel == NULL) {
+    std::string kernel_name;
+    {
+      boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+      CHECK_LT(kernel_id, kernel_table_->names_.size());
+      kernel_name = kernel_table_->names_[kernel_id];
+    }
+    cl_int _err = 0;
+    kernel = clCreateKernel(Program, kernel_name.c_str(), &_err);
+    OCL_CHECK(_err);
+  }
+  return kernel;
+}
+
+const LaunchConfig* Device::GetLaunchConfig(int kernel_id) {
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+  CHECK_LT(kernel_id, kernel_table_->configs_.size());
+  return &kernel_table_->configs_[kernel_id];
+}
+
+void Device::SetLaunchConfig(const std::string& kernel_name,
+    const LaunchConfig& config) {
+  CHECK_GT(config.local_size, 0);
+  CHECK_GT(config.items_per_thread, 0);
+  boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+  kernel_table_->profile_[kernel_name] = config;
+  std::map<std::string, int>::iterator it =
+      kernel_table_->ids_.find(kernel_name);
+  if (it != kernel_table_->ids_.end()) {
+    kernel_table_->configs_[it->second] = config;
+  }
+}
+
+std::string Device::LaunchProfilePath() {
+  if (oclBinaryCachePath.empty()) {
+    return "";
+  }
+  std::ostringstream file_name;
+  file_name << oclBinaryCachePath << "launch_" << std::hex
+      << HashString(DeviceSignature()) << ".txt";
+  return file_name.str();
+}
+
+// One "kernel_name local_size items_per_thread" line per kernel.
+bool Device::LoadLaunchProfile(const std::string& file_name) {
+  std::ifstream file(file_name.c_str());
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string kernel_name;
+  LaunchConfig config;
+  while (file >> kernel_name >> config.local_size
+      >> config.items_per_thread) {
+    if (config.local_size == 0 || config.items_per_thread <= 0) {
+      LOG(WARNING) << "Ignoring launch config of " << kernel_name << " in "
+          << file_name;
+      continue;
+    }
+    SetLaunchConfig(kernel_name, config);
+  }
+  return true;
+}
+
+bool Device::SaveLaunchProfile(const std::string& file_name) {
+  std::map<std::string, LaunchConfig> profile;
+  {
+    boost::mutex::scoped_lock lock(kernel_table_->mutex_);
+    profile = kernel_table_->profile_;
+  }
+  if (!oclBinaryCachePath.empty()) {
+    mkdir(oclBinaryCachePath.c_str(), 0755);
+  }
+  std::ostringstream tmp_name;
+  tmp_name << file_name << "." << getpid() << ".tmp";
+  std::ofstream file(tmp_name.str().c_str(), std::ios::out | std::ios::trunc);
+  if (!file.is_open()) {
+    LOG(WARNING) << "Failed to open " << tmp_name.str();
+    return false;
+  }
+  std::map<std::string, LaunchConfig>::iterator it;
+  for (it = profile.begin(); it != profile.end(); ++it) {
+    file << it->first << " " << it->second.local_size << " "
+        << it->second.items_per_thread << "\n";
+  }
+  file.close();
+  if (!file || rename(tmp_name.str().c_str(), file_name.c_str()) != 0) {
+    LOG(WARNING) << "Failed to write launch profile " << file_name;
+    remove(tmp_name.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+void KernelHandle::Enqueue(cl_kernel kernel, const int count,
+    const bool grid_stride) const {
+  if (count <= 0) {
+    return;
+  }
+  size_t local_size = config_->local_size;
+  size_t work_items = count;
+  if (grid_stride) {
+    work_items = (work_items + config_->items_per_thread - 1)
+        / config_->items_per_thread;
+  }
+  size_t global_size = (work_items + local_size - 1) / local_size
+      * local_size;
+  Tracer& tracer = Tracer::Get();
+  cl_event event;
+  OCL_CHECK(
+      clEnqueueNDRangeKernel(amdDevice.CommandQueue, kernel, 1, NULL,
+          &global_size, &local_size, 0, NULL, tracer.event_out(&event)));
+  if (event) {
+    tracer.AddDeviceEvent(amdDevice.KernelName(kernel_id_), "kernel", event);
+    OCL_CHECK(clReleaseEvent(event));
+  }
 }
 
 void Device::DisplayPlatformInfo() {
@@ -4,7 +4,7 @@
 namespace caffe {
 
 InternalThread::~InternalThread() {
-  WaitForInternalThreadToExit();
+  StopInternalThread();
 }
 
 bool InternalThread::is_started() const {
@@ -36,4 +36,20 @@ bool InternalThread::WaitForInternalThreadToExit() {
   return true;
 }
 
+void InternalThread::StopInternalThread() {
+  if (is_started()) {
+    thread_->interrupt();
+    try {
+      thread_->join();
+    } catch (boost::thread_interrupted&) {
+    } catch (std::exception& e) {
+      LOG(FATAL) << "Thread exception: " << e.what();
+    }
+  }
+}
+
+bool InternalThread::must_stop() {
+  return boost::this_thread::interruption_requested();
+}
+
 }  // namespace caffe
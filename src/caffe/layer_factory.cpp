@@ -28,6 +28,15 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(const LayerParameter& param) {
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr < Layer<Dtype> > (new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    if (!WinogradConvolutionLayer<Dtype>::IsSupported(
+        param.convolution_param())) {
+      LOG(INFO) << "WINOGRAD only supports 3x3 kernels with stride 1. "
+          << "Using Caffe's own convolution layer.";
+      return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+    }
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     return shared_ptr<Layer<Dtype> >(new CuDNNConvolutionLayer<Dtype>(param));
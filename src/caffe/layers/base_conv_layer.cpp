@@ -1,3 +1,7 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
 #include <vector>
 
 #include "caffe/filler.hpp"
@@ -13,26 +17,49 @@ namespace caffe {
 #ifdef use_packing_scheme
 template <typename Dtype> size_t BaseConvolutionLayer<Dtype>::subtop_mem_size = sizeof(Dtype);
 template <typename Dtype> size_t BaseConvolutionLayer<Dtype>::trans_mem_size = sizeof(Dtype);
-template <typename Dtype> cl_mem BaseConvolutionLayer<Dtype>::subTopMem = clCreateBuffer(amdDevice.Context, CL_MEM_READ_WRITE, BaseConvolutionLayer<Dtype>::subtop_mem_size, NULL, NULL);
-template <typename Dtype> cl_mem BaseConvolutionLayer<Dtype>::transMem = clCreateBuffer(amdDevice.Context, CL_MEM_READ_WRITE, BaseConvolutionLayer<Dtype>::trans_mem_size, NULL, NULL);
+template <typename Dtype> std::vector<cl_mem> BaseConvolutionLayer<Dtype>::subTopMem;
+template <typename Dtype> std::vector<cl_mem> BaseConvolutionLayer<Dtype>::transMem;
 #endif
 
+// Grows the scratch buffers of every queue to size bytes; queues added since
+// the last call get theirs.
+static void Alloc_queue_tmp_mem(std::vector<cl_mem>* buffers,
+    size_t* buffer_size, size_t size) {
+  const bool grow = size > *buffer_size;
+  if (grow) {
+    *buffer_size = size;
+  }
+  const int num_queues = amdDevice.num_queues();
+  for (int i = 0; i < num_queues; ++i) {
+    if (i < buffers->size() && !grow) {
+      continue;
+    }
+    if (i < buffers->size()) {
+      OCL_CHECK(clReleaseMemObject((*buffers)[i]));
+    } else {
+      buffers->push_back(NULL);
+    }
+    cl_int err = CL_SUCCESS;
+    (*buffers)[i] = clCreateBuffer(amdDevice.Context, CL_MEM_READ_WRITE,
+        *buffer_size, NULL, &err);
+    OCL_CHECK(err);
+  }
+}
+
 template <typename Dtype>
 void Alloc_public_tmp_mem(size_t subtop_size, size_t trans_size) {
-  if (subtop_size > BaseConvolutionLayer < Dtype > ::subtop_mem_size) {
-    ConvolutionLayer < Dtype > ::subtop_mem_size = subtop_size;
-    clReleaseMemObject(ConvolutionLayer < Dtype > ::subTopMem);
-    ConvolutionLayer < Dtype > ::subTopMem = clCreateBuffer(amdDevice.Context,
-        CL_MEM_READ_WRITE, BaseConvolutionLayer < Dtype > ::subtop_mem_size,
-        NULL, NULL);
-  }
-  if (trans_size > ConvolutionLayer < Dtype > ::trans_mem_size) {
-    ConvolutionLayer < Dtype > ::trans_mem_size = trans_size;
-    clReleaseMemObject(ConvolutionLayer < Dtype > ::transMem);
-    ConvolutionLayer < Dtype > ::transMem = clCreateBuffer(amdDevice.Context,
-        CL_MEM_READ_WRITE, BaseConvolutionLayer < Dtype > ::trans_mem_size,
-        NULL, NULL);
-  }
+  Alloc_queue_tmp_mem(&BaseConvolutionLayer<Dtype>::subTopMem,
+      &BaseConvolutionLayer<Dtype>::subtop_mem_size, subtop_size);
+  Alloc_queue_tmp_mem(&BaseConvolutionLayer<Dtype>::transMem,
+      &BaseConvolutionLayer<Dtype>::trans_mem_size, trans_size);
+}
+
+// Packing number of the GPU path when neither the layer nor the tuner set one.
+static const int kDefaultGpuPackingNum = 16;
+
+template <typename Dtype>
+int BaseConvolutionLayer<Dtype>::gpu_packing_num() const {
+  return packing_num_ > 0 ? packing_num_ : kDefaultGpuPackingNum;
 }
 
 template <typename Dtype>
@@ -41,8 +68,8 @@ void BaseConvolutionLayer<Dtype>::ocl_setup() {
   K_ = conv_in_channels_ * kernel_w_ * kernel_h_ / group_;
   N_ = height_out_ * width_out_;
 #ifdef use_packing_scheme
-  size_t subtop_size = (size_t)((M_ * group_) * N_ * global_packing_N * sizeof(Dtype));
-  size_t trans_size = (size_t)((K_ * group_ )* N_ * global_packing_N * sizeof(Dtype));
+  size_t subtop_size = (size_t)((M_ * group_) * N_ * gpu_packing_num() * sizeof(Dtype));
+  size_t trans_size = (size_t)((K_ * group_ )* N_ * gpu_packing_num() * sizeof(Dtype));
   Alloc_public_tmp_mem<Dtype>(subtop_size, trans_size);
 #endif
 }
@@ -53,6 +80,43 @@ template <typename Dtype>
 BaseConvolutionLayer<Dtype>::~BaseConvolutionLayer() {
 }
 
+// Narrow gemms (few output pixels per image) use BLAS poorly. Pack enough
+// images to make the gemm at least this many columns wide...
+static const int kCpuGemmMinWidth = 1024;
+
+// ... as long as the packed column buffer fits in the last level cache.
+static size_t cpu_cache_size() {
+  long cache = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  cache = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (cache <= 0) {
+    cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  }
+#endif
+  return cache > 0 ? cache : 8 * 1024 * 1024;
+}
+
+template <typename Dtype>
+int BaseConvolutionLayer<Dtype>::cpu_packing_num() {
+  // Deconvolution runs its forward pass through backward_cpu_gemm, and 1x1
+  // convolution has no column buffer to pack.
+  if (reverse_dimensions() || is_1x1_) {
+    return 1;
+  }
+  if (packing_num_ > 0) {
+    return std::min(packing_num_, num_);
+  }
+  if (conv_out_spatial_dim_ >= kCpuGemmMinWidth) {
+    return 1;
+  }
+  const size_t col_bytes = (size_t) kernel_dim_ * conv_out_spatial_dim_
+      * sizeof(Dtype);
+  int optnum = (kCpuGemmMinWidth + conv_out_spatial_dim_ - 1)
+      / conv_out_spatial_dim_;
+  optnum = std::min<int>(optnum, cpu_cache_size() / col_bytes);
+  return std::max(1, std::min(optnum, num_));
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -101,6 +165,8 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // and no padding, so flag for skipping the buffer and transformation.
   is_1x1_ = kernel_w_ == 1 && kernel_h_ == 1 && stride_h_ == 1 && stride_w_ == 1
       && pad_h_ == 0 && pad_w_ == 0;
+  is_strided_1x1_ = kernel_w_ == 1 && kernel_h_ == 1 && pad_h_ == 0
+      && pad_w_ == 0 && !is_1x1_;
   // Configure output channels and groups.
   channels_ = bottom[0]->channels();
   num_output_ = this->layer_param_.convolution_param().num_output();
@@ -152,6 +218,39 @@ void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   // Propagate gradients to the parameters (as directed by backward pass).
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  packing_num_ = conv_param.packing_num();
+}
+
+template <typename Dtype>
+vector<int> BaseConvolutionLayer<Dtype>::packing_candidates() {
+  vector<int> candidates(1, 1);
+  if (reverse_dimensions() || is_1x1_) {
+    return candidates;
+  }
+  for (int packing_num = 2; packing_num <= std::min(num_, 64);
+      packing_num *= 2) {
+    candidates.push_back(packing_num);
+  }
+  return candidates;
+}
+
+template <typename Dtype>
+size_t BaseConvolutionLayer<Dtype>::packing_memory(const int packing_num) {
+  // Column buffer plus gemm output, on either device.
+  return (size_t) (kernel_dim_ + conv_out_channels_) * conv_out_spatial_dim_
+      * packing_num * sizeof(Dtype);
+}
+
+template <typename Dtype>
+string BaseConvolutionLayer<Dtype>::packing_key() {
+  std::ostringstream key;
+  key << this->type() << "_" << (Caffe::mode() == Caffe::CPU ? "cpu" : "gpu")
+      << "_" << (sizeof(Dtype) == sizeof(float) ? "float" : "double")
+      << "_n" << num_ << "_c" << channels_ << "_" << height_ << "x" << width_
+      << "_o" << num_output_ << "_k" << kernel_h_ << "x" << kernel_w_
+      << "_s" << stride_h_ << "x" << stride_w_ << "_p" << pad_h_ << "x"
+      << pad_w_ << "_g" << group_;
+  return key.str();
 }
 
 template <typename Dtype>
@@ -194,11 +293,17 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   output_offset_ = conv_out_channels_ * conv_out_spatial_dim_ / group_;
   // The im2col result buffer will only hold one image at a time to avoid
   // overly large memory usage. In the special case of 1x1 convolution
-  // it goes lazily unused to save memory.
-  if (reverse_dimensions()) {
+  // the input is used as is and the buffer is never even shaped.
+  // Forward_cpu may pack cpu_opt_num_ images in it instead.
+  cpu_opt_num_ = cpu_packing_num();
+  if (!is_1x1_ && reverse_dimensions()) {
     col_buffer_.Reshape(1, kernel_dim_, height_, width_);
-  } else {
-    col_buffer_.Reshape(1, kernel_dim_, height_out_, width_out_);
+  } else if (!is_1x1_) {
+    col_buffer_.Reshape(cpu_opt_num_, kernel_dim_, height_out_, width_out_);
+  }
+  if (cpu_opt_num_ > 1) {
+    output_buffer_opt_.Reshape(cpu_opt_num_, conv_out_channels_, height_out_,
+        width_out_);
   }
   // Set up the all ones "bias multiplier" for adding biases by BLAS
   if (bias_term_) {
@@ -230,6 +335,31 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_opt(const Dtype* input,
+    const Dtype* weights, Dtype* output, const int optnum) {
+  CHECK_LE(optnum, cpu_opt_num_);
+  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  Dtype* out_buff = output_buffer_opt_.mutable_cpu_data();
+  conv_im2col_cpu_opt(input, col_buff, optnum);
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
+        conv_out_channels_ / group_, conv_out_spatial_dim_ * optnum,
+        kernel_dim_ / group_, (Dtype) 1., weights + weight_offset_ * g,
+        col_buff + col_offset_ * optnum * g, (Dtype) 0.,
+        out_buff + output_offset_ * optnum * g);
+  }
+  // Rows of out_buff hold one channel of every image; scatter them back to
+  // the (num, channels, height, width) layout of the top.
+  for (int n = 0; n < optnum; ++n) {
+    for (int c = 0; c < conv_out_channels_; ++c) {
+      caffe_copy(conv_out_spatial_dim_,
+          out_buff + (c * optnum + n) * conv_out_spatial_dim_,
+          output + (n * conv_out_channels_ + c) * conv_out_spatial_dim_);
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -237,13 +367,24 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       > (CblasNoTrans, CblasNoTrans, num_output_, height_out_ * width_out_, 1, (Dtype) 1., bias, bias_multiplier_.cpu_data(), (Dtype) 1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_bias_relu(Dtype* output) {
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const int spatial_dim = height_out_ * width_out_;
+  for (int c = 0; c < num_output_; ++c) {
+    const Dtype bias_value = bias ? bias[c] : Dtype(0);
+    for (int j = 0; j < spatial_dim; ++j) {
+      const Dtype value = output[j] + bias_value;
+      output[j] = value > 0 ? value : value * relu_negative_slope_;
+    }
+    output += spatial_dim;
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
-  if (is_1x1_) {
-    col_buff = input;
-  }
+  Dtype* col_buff = is_1x1_ ? input : col_buffer_.mutable_cpu_data();
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm < Dtype
         > (CblasTrans, CblasNoTrans, kernel_dim_ / group_, conv_out_spatial_dim_, conv_out_channels_
@@ -291,13 +432,16 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_gemm(const Dtype* input,
     }
     col_buff = col_buffer_.gpu_data();
   } 
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
-     caffe_gpu_gemm < Dtype > (&(amdDevice.CommandQueue), CblasNoTrans, CblasNoTrans, conv_out_channels_
+     cl_command_queue queue = amdDevice.ForkedQueue(g % num_queues);
+     caffe_gpu_gemm < Dtype > (&queue, CblasNoTrans, CblasNoTrans, conv_out_channels_
             / group_, conv_out_spatial_dim_, kernel_dim_ / group_, (Dtype) 1., weights, weight_offset_
             * g, col_buff, is_1x1_ * bottom_offset_ + col_offset_ * g, (Dtype) 0., output, top_offset_
             + output_offset_ * g);
   }
-  
+  amdDevice.JoinQueues(num_queues);
 }
 
 template <typename Dtype>
@@ -307,21 +451,29 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias(Dtype* output,
       > (CblasNoTrans, CblasNoTrans, num_output_, height_out_ * width_out_, 1, (Dtype) 1., bias, 0, reinterpret_cast<const Dtype*>(bias_multiplier_.gpu_data()), 0, (Dtype) 1., output, top_offset_);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_gpu_bias_relu(Dtype* output,
+    const int num) {
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->gpu_data() : NULL;
+  BiasReLUForward(num * num_output_ * height_out_ * width_out_, num_output_,
+      height_out_ * width_out_, bias, output, top_offset_,
+      relu_negative_slope_);
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_gpu_data();
-  if (is_1x1_) {
-    col_buff = input;
-  }
- 
+  Dtype* col_buff = is_1x1_ ? input : col_buffer_.mutable_gpu_data();
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
-      caffe_gpu_gemm < Dtype> (&(amdDevice.CommandQueue), CblasTrans, CblasNoTrans, kernel_dim_
+      cl_command_queue queue = amdDevice.ForkedQueue(g % num_queues);
+      caffe_gpu_gemm < Dtype> (&queue, CblasTrans, CblasNoTrans, kernel_dim_
             / group_, conv_out_spatial_dim_, conv_out_channels_ / group_, (Dtype) 1., weights, weight_offset_
             * g, output, top_offset_ + output_offset_ * g, (Dtype) 0., col_buff, is_1x1_ * bottom_offset_ + col_offset_
             * g);
   }
-  
+  amdDevice.JoinQueues(num_queues);
   if (!is_1x1_) {
     conv_col2im_gpu(col_buff, input);
   }
@@ -335,11 +487,15 @@ void BaseConvolutionLayer<Dtype>::weight_gpu_gemm(const Dtype* input,
     conv_im2col_gpu(input, col_buffer_.mutable_gpu_data());
     col_buff = col_buffer_.gpu_data();
   }
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
+    cl_command_queue queue = amdDevice.ForkedQueue(g % num_queues);
     caffe_gpu_gemm < Dtype
-        > (&(amdDevice.CommandQueue), CblasNoTrans, CblasTrans, conv_out_channels_
+        > (&queue, CblasNoTrans, CblasTrans, conv_out_channels_
             / group_, kernel_dim_ / group_, conv_out_spatial_dim_, (Dtype) 1., output, top_offset_ + output_offset_*g, (Dtype*) col_buff, is_1x1_*bottom_offset_ + col_offset_ * g, (Dtype) 1., (Dtype*) weights, weight_offset_ * g);
   }
+  amdDevice.JoinQueues(num_queues);
 }
 
 template <typename Dtype>
@@ -353,31 +509,21 @@ void BaseConvolutionLayer<Dtype>::backward_gpu_bias(Dtype* bias,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_gpu_gemm_opt(const Dtype* input,
     const Dtype* weight, Dtype* output, bool skip_im2col) {
-    cl_command_queue Queue;
     if (!skip_im2col) {
       conv_im2col_gpu_opt(input);
     }
-#ifdef multiQ
-  for (int g = 0; g < group_; ++g) {
-    if(g == 0) Queue = amdDevice.CommandQueue;
-    else Queue = amdDevice.CommandQueue_helper;
-    caffe_gpu_gemm<Dtype>(&(Queue), CblasNoTrans, CblasNoTrans, M_, N_ * opt_num2, K_,
-        (Dtype)1., weight, weight_offset_ * g, (Dtype*)transMem, col_offset_ * g,
-        (Dtype)0., (Dtype*)subTopMem, top_offset_opt * g);
-  }
-  if(group_ == 2) {
-    clFinish(amdDevice.CommandQueue);
-    clFinish(amdDevice.CommandQueue_helper);
-  }
-#else
-  Queue = amdDevice.CommandQueue;
+  cl_mem subTopMem = sub_top_mem();
+  cl_mem transMem = trans_mem();
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
+    cl_command_queue Queue = amdDevice.ForkedQueue(g % num_queues);
     caffe_gpu_gemm < Dtype
         > (&(Queue), CblasNoTrans, CblasNoTrans, M_, N_ * opt_num2, K_, (Dtype) 1., weight, weight_offset_
             * g, (Dtype*) transMem, col_offset_ * g, (Dtype) 0., (Dtype*) subTopMem, top_offset_opt
             * g);
   }
-#endif
+  amdDevice.JoinQueues(num_queues);
   transform_gpu((Dtype*) subTopMem, output, top_offset_, N_, M_ * group_,
       opt_num2);
 }
@@ -394,25 +540,18 @@ void BaseConvolutionLayer<Dtype>::forward_gpu_bias_opt(Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_gpu_gemm_opt(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  cl_command_queue Queue;
+  cl_mem subTopMem = sub_top_mem();
+  cl_mem transMem = trans_mem();
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
-#ifdef multiQ
-    if(g == 0) Queue = amdDevice.CommandQueue;
-    else Queue = amdDevice.CommandQueue_helper;
-#else
-    Queue = amdDevice.CommandQueue;
-#endif
+    cl_command_queue Queue = amdDevice.ForkedQueue(g % num_queues);
     caffe_gpu_gemm < Dtype
         > (&(Queue), CblasTrans, CblasNoTrans, K_, N_ * opt_num2, M_, (Dtype) 1., weights, weight_offset_
             * g, (Dtype*) subTopMem, top_offset_opt * g, (Dtype) 0., (Dtype*) transMem, col_offset_
             * g);
   }
-#ifdef multiQ
-  if(group_ ==2) {
-    clFinish(amdDevice.CommandQueue);
-    clFinish(amdDevice.CommandQueue_helper);
-  }
-#endif
+  amdDevice.JoinQueues(num_queues);
 
     conv_col2im_gpu_opt(input);
 }
@@ -420,29 +559,22 @@ void BaseConvolutionLayer<Dtype>::backward_gpu_gemm_opt(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_gpu_gemm_opt(const Dtype* input,
     const Dtype* output, Dtype* weights) {
-  cl_command_queue Queue;
+  cl_mem subTopMem = sub_top_mem();
+  cl_mem transMem = trans_mem();
    conv_im2col_gpu_opt(input);
    opttrans(output, top_offset_, 1, M_ * group_, N_, (Dtype*) subTopMem, 0,
       opt_num2);
 
+  const int num_queues = group_queues();
+  amdDevice.ForkQueues(num_queues);
   for (int g = 0; g < group_; ++g) {
-#ifdef multiQ
-    if(g == 0) Queue = amdDevice.CommandQueue;
-    else Queue = amdDevice.CommandQueue_helper;
-#else
-    Queue = amdDevice.CommandQueue;
-#endif
+    cl_command_queue Queue = amdDevice.ForkedQueue(g % num_queues);
     caffe_gpu_gemm < Dtype
         > (&(Queue), CblasNoTrans, CblasTrans, M_, K_, N_ * opt_num2, (Dtype) 1., (Dtype*) subTopMem, top_offset_opt
             * g, (Dtype*) transMem, col_offset_ * g, (Dtype) 1., (Dtype*) weights, weight_offset_
             * g);
-#ifdef multiQ
-    if(group_ == 2) {
-      clFinish(amdDevice.CommandQueue);
-      clFinish(amdDevice.CommandQueue_helper);
-    }
-#endif
   }
+  amdDevice.JoinQueues(num_queues);
 }
 
 // end: code is modified for OpenCL
@@ -1,9 +1,12 @@
+#include <boost/thread.hpp>
 #include <string>
 #include <vector>
 
 #include "caffe/data_layers.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/trace.hpp"
 
 namespace caffe {
 
@@ -27,88 +30,174 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   DataLayerSetUp(bottom, top);
 }
 
+template <typename Dtype>
+BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
+    const LayerParameter& param)
+    : BaseDataLayer<Dtype>(param),
+      prefetch_(param.data_param().prefetch()) {
+  CHECK_GT(prefetch_.size(), 0) << "prefetch must be positive";
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i].reset(new Batch<Dtype>());
+  }
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // Setting up again restarts the producer on an empty ring.
+  StopInternalThread();
+  Batch<Dtype>* batch;
+  while (prefetch_full_.try_pop(&batch)) {
+  }
+  while (prefetch_free_.try_pop(&batch)) {
+  }
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_free_.push(prefetch_[i].get());
+  }
   BaseDataLayer < Dtype > ::LayerSetUp(bottom, top);
-  // Now, start the prefetch thread. Before calling prefetch, we make two
-  // cpu_data calls so that the prefetch thread does not accidentally make
-  // simultaneous cudaMalloc calls when the main thread is running. In some
-  // GPUs this seems to cause failures if we do not so.
-  this->prefetch_data_.mutable_cpu_data();
-  if (this->output_labels_) {
-    this->prefetch_label_.mutable_cpu_data();
+  // Before starting the prefetch thread, we make cpu_data calls so that the
+  // prefetch thread does not accidentally make simultaneous buffer
+  // allocations when the main thread is running. In some GPUs this seems to
+  // cause failures if we do not so.
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i]->data_.mutable_cpu_data();
+    prefetch_[i]->data_.set_data_layer();
+    if (this->output_labels_) {
+      prefetch_[i]->label_.mutable_cpu_data();
+      prefetch_[i]->label_.set_data_layer();
+    }
+    for (int j = 0; j < prefetch_[i]->extra_.size(); ++j) {
+      prefetch_[i]->extra_[j]->mutable_cpu_data();
+      prefetch_[i]->extra_[j]->set_data_layer();
+    }
   }
   DLOG(INFO) << "Initializing prefetch";
-  this->CreatePrefetchThread();
+  this->data_transformer_->InitRand();
+  CHECK(StartInternalThread()) << "Thread execution failed";
   DLOG(INFO) << "Prefetch initialized.";
 }
 
 template <typename Dtype>
-void BasePrefetchingDataLayer<Dtype>::CreatePrefetchThread() {
-  this->data_transformer_->InitRand();
-  CHECK(StartInternalThread()) << "Thread execution failed";
+void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      Batch<Dtype>* batch = prefetch_free_.pop();
+#ifndef CPU_ONLY
+      // Whatever the mode is now, the batch may have been forwarded by
+      // Forward_gpu, whose copies may still read it: in the APU brew its
+      // host buffers are the device ones.
+      WaitBatchCopied(batch);
+#endif
+      {
+        TraceScope trace(this->layer_param_.name(), "load_batch");
+        load_batch(batch);
+      }
+#ifndef CPU_ONLY
+      if (Caffe::mode() == Caffe::GPU) {
+        PushBatchToGpu(batch);
+      }
+#endif
+      prefetch_full_.push(batch);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
 }
 
 template <typename Dtype>
-void BasePrefetchingDataLayer<Dtype>::JoinPrefetchThread() {
-  CHECK(WaitForInternalThreadToExit()) << "Thread joining failed";
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::PopFullBatch() {
+  prefetch_stats_.depth_sum += prefetch_full_.size();
+  ++prefetch_stats_.batches;
+  Batch<Dtype>* batch = NULL;
+  if (!prefetch_full_.try_pop(&batch)) {
+    ++prefetch_stats_.empty_waits;
+    CPUTimer wait_timer;
+    wait_timer.Start();
+    TraceScope trace(this->layer_param_.name(), "prefetch_wait");
+    batch = prefetch_full_.pop("Data layer prefetch queue empty");
+    prefetch_stats_.wait_ms += wait_timer.MicroSeconds() / 1000.;
+  }
+  return batch;
 }
 
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  // First, join the thread
-  JoinPrefetchThread();
-
-  DLOG(INFO) << "Thread joined";
+  Batch<Dtype>* batch = PopFullBatch();
   // Reshape to loaded data.
-  top[0]->ReshapeLike(prefetch_data_);
+  top[0]->ReshapeLike(batch->data_);
   // Copy the data
-  caffe_copy(prefetch_data_.count(), prefetch_data_.cpu_data(),
+  caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
       top[0]->mutable_cpu_data());
   DLOG(INFO) << "Prefetch copied";
   if (this->output_labels_) {
     // Reshape to loaded labels.
-    top[1]->ReshapeLike(prefetch_label_);
+    top[1]->ReshapeLike(batch->label_);
     // Copy the labels.
-    caffe_copy(prefetch_label_.count(), prefetch_label_.cpu_data(),
+    caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
         top[1]->mutable_cpu_data());
   }
-  // Start a new prefetch thread
-  DLOG(INFO) << "CreatePrefetchThread";
-  CreatePrefetchThread();
+  for (int i = 0; i < batch->extra_.size(); ++i) {
+    top[i + 2]->ReshapeLike(*batch->extra_[i]);
+    caffe_copy(batch->extra_[i]->count(), batch->extra_[i]->cpu_data(),
+        top[i + 2]->mutable_cpu_data());
+  }
+  prefetch_free_.push(batch);
 }
 
 #ifndef CPU_ONLY
 
 template <typename Dtype>
-void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+void BasePrefetchingDataLayer<Dtype>::WaitBatchCopied(Batch<Dtype>* batch) {
+  if (batch->copied_) {
+    OCL_CHECK(clWaitForEvents(1, &batch->copied_));
+    OCL_CHECK(clReleaseEvent(batch->copied_));
+    batch->copied_ = NULL;
+  }
+}
 
-  JoinPrefetchThread();
-  DLOG(INFO) << "Thread joined";
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::PushBatchToGpu(Batch<Dtype>* batch) {
+  batch->data_.data()->async_gpu_push();
+  if (this->output_labels_) {
+    batch->label_.data()->async_gpu_push();
+  }
+  for (int i = 0; i < batch->extra_.size(); ++i) {
+    batch->extra_[i]->data()->async_gpu_push();
+  }
+}
 
-  top[0]->ReshapeLike(this->prefetch_data_);
-  OCL_CHECK(
-      clEnqueueWriteBuffer(amdDevice.CommandQueue,
-          (cl_mem) top[0]->mutable_gpu_data(), CL_TRUE, 0,
-          sizeof(Dtype) * prefetch_data_.count(), prefetch_data_.cpu_data(), 0,
-          NULL, NULL));
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  Batch<Dtype>* batch = PopFullBatch();
+  // Reshape to loaded data.
+  top[0]->ReshapeLike(batch->data_);
+  // Copy the data; gpu_data() orders this after the prefetch upload.
+  caffe_gpu_copy(batch->data_.count(), batch->data_.gpu_data(),
+      top[0]->mutable_gpu_data());
   DLOG(INFO) << "Prefetch copied";
   if (this->output_labels_) {
     // Reshape to loaded labels.
-    top[1]->ReshapeLike(prefetch_label_);
-    OCL_CHECK(
-        clEnqueueWriteBuffer(amdDevice.CommandQueue,
-            (cl_mem) top[1]->mutable_gpu_data(), CL_TRUE, 0,
-            sizeof(Dtype) * prefetch_label_.count(), prefetch_label_.cpu_data(),
-            0, NULL, NULL));
+    top[1]->ReshapeLike(batch->label_);
+    // Copy the labels.
+    caffe_gpu_copy(batch->label_.count(), batch->label_.gpu_data(),
+        top[1]->mutable_gpu_data());
   }
-
-  // Start a new prefetch thread
-  DLOG(INFO) << "CreatePrefetchThread";
-  CreatePrefetchThread();
+  for (int i = 0; i < batch->extra_.size(); ++i) {
+    top[i + 2]->ReshapeLike(*batch->extra_[i]);
+    caffe_gpu_copy(batch->extra_[i]->count(), batch->extra_[i]->gpu_data(),
+        top[i + 2]->mutable_gpu_data());
+  }
+  // The batch can be refilled on the host right away, but its device
+  // buffers are read until the copies above have run.
+  if (batch->copied_) {
+    OCL_CHECK(clReleaseEvent(batch->copied_));
+  }
+  OCL_CHECK(
+      clEnqueueMarkerWithWaitList(amdDevice.CommandQueue, 0, NULL,
+          &batch->copied_));
+  prefetch_free_.push(batch);
 }
 
 #else
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include "caffe/filler.hpp"
 #include "caffe/layer.hpp"
@@ -22,10 +23,31 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
+    if (this->cpu_opt_num_ > 1) {
+      // Packed path: one wide gemm for every cpu_opt_num_ images.
+      for (int n = 0; n < this->num_; n += this->cpu_opt_num_) {
+        const int optnum = std::min(this->cpu_opt_num_, this->num_ - n);
+        this->forward_cpu_gemm_opt(bottom_data + bottom[i]->offset(n), weight,
+            top_data + top[i]->offset(n), optnum);
+        if (this->fused_relu_) {
+          for (int k = n; k < n + optnum; ++k) {
+            this->forward_cpu_bias_relu(top_data + top[i]->offset(k));
+          }
+        } else if (this->bias_term_) {
+          const Dtype* bias = this->blobs_[1]->cpu_data();
+          for (int k = n; k < n + optnum; ++k) {
+            this->forward_cpu_bias(top_data + top[i]->offset(k), bias);
+          }
+        }
+      }
+      continue;
+    }
     for (int n = 0; n < this->num_; ++n) {
       this->forward_cpu_gemm(bottom_data + bottom[i]->offset(n), weight,
           top_data + top[i]->offset(n));
-      if (this->bias_term_) {
+      if (this->fused_relu_) {
+        this->forward_cpu_bias_relu(top_data + top[i]->offset(n));
+      } else if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + top[i]->offset(n), bias);
       }
@@ -74,7 +96,7 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  if (!this->is_1x1_ && use_packing_scheme && global_packing_N > 1)
+  if (!this->is_1x1_ && use_packing_scheme && this->gpu_packing_num() > 1)
     Forward_gpu_batched(bottom, top);
   else
     Forward_gpu_org(bottom, top);
@@ -83,7 +105,7 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  if (!this->is_1x1_ && use_packing_scheme && global_packing_N > 1)
+  if (!this->is_1x1_ && use_packing_scheme && this->gpu_packing_num() > 1)
     Backward_gpu_batched(top, propagate_down, bottom);
   else
     Backward_gpu_org(top, propagate_down, bottom);
@@ -98,7 +120,7 @@ void ConvolutionLayer<Dtype>::Forward_gpu_batched(
     //CHECK_BLOB_DATA(bottom[i],10,"bottom");
 
     Dtype* top_data = top[i]->mutable_gpu_data();
-    this->opt_num2 = global_packing_N;
+    this->opt_num2 = this->gpu_packing_num();
     this->weight_offset_ = this->M_ * this->K_;
     for (int n = 0; n < this->num_; n += this->opt_num2) {
       this->opt_num2 =
@@ -109,7 +131,9 @@ void ConvolutionLayer<Dtype>::Forward_gpu_batched(
       this->col_offset_ = this->K_ * this->N_ * this->opt_num2;
       this->bottom_offset_ = bottom[i]->offset(n);
       this->forward_gpu_gemm_opt(bottom_data, weight, top_data);
-      if (this->bias_term_) {
+      if (this->fused_relu_) {
+        this->forward_gpu_bias_relu(top_data, this->opt_num2);
+      } else if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->gpu_data();
         this->forward_gpu_bias_opt(top_data, bias);
       }
@@ -135,7 +159,9 @@ void ConvolutionLayer<Dtype>::Forward_gpu_org(
       this->col_offset_ = this->K_ * this->N_;
       this->forward_gpu_gemm(bottom_data, weight, top_data);
 
-      if (this->bias_term_) {
+      if (this->fused_relu_) {
+        this->forward_gpu_bias_relu(top_data, 1);
+      } else if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->gpu_data();
         this->forward_gpu_bias(top_data, bias);
       }
@@ -166,7 +192,7 @@ void ConvolutionLayer<Dtype>::Backward_gpu_batched(const vector<Blob<Dtype>*>& t
       const Dtype* bottom_data = bottom[i]->gpu_data();
       Dtype* bottom_diff = bottom[i]->mutable_gpu_diff();
       this->weight_offset_ = this->M_ * this->K_;
-      this->opt_num2 = global_packing_N;
+      this->opt_num2 = this->gpu_packing_num();
       for (int n = 0; n < this->num_; n += this->opt_num2) {
         this->opt_num2 =
             this->opt_num2 > (this->num_ - n) ?
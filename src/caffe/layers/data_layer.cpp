@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <opencv2/core/core.hpp>
 
 #include <stdint.h>
@@ -13,12 +14,13 @@
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
 DataLayer<Dtype>::~DataLayer<Dtype>() {
-  this->JoinPrefetchThread();
+  this->StopInternalThread();
 }
 
 template <typename Dtype>
@@ -39,16 +41,18 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }
   // Read a data point, to initialize the prefetch and top blobs.
-  Datum datum;
-  datum.ParseFromString(cursor_->value());
+  const char* value;
+  size_t value_size;
+  cursor_->value_view(&value, &value_size);
   // Use data_transformer to infer the expected blob shape from datum.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  vector<int> top_shape = InferRecordShape(value, value_size);
   this->transformed_data_.Reshape(top_shape);
   // Reshape top[0] and prefetch_data according to the batch_size.
   top_shape[0] = this->layer_param_.data_param().batch_size();
-  this->prefetch_data_.Reshape(top_shape);
-  top[0]->ReshapeLike(this->prefetch_data_);
-  this->prefetch_data_.set_data_layer();
+  top[0]->Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
+  }
 
   LOG(INFO) << "output data size: " << top[0]->num() << ","
       << top[0]->channels() << "," << top[0]->height() << ","
@@ -57,54 +61,176 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   if (this->output_labels_) {
     vector<int> label_shape(1, this->layer_param_.data_param().batch_size());
     top[1]->Reshape(label_shape);
-    this->prefetch_label_.Reshape(label_shape);
-    this->prefetch_label_.set_data_layer();
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(label_shape);
+    }
+  }
+  // Transform workers, each seeded from the Caffe RNG in turn so that a
+  // given seed and thread count always produce the same batches.
+  const int num_workers = this->layer_param_.data_param().transform_threads();
+  CHECK_GT(num_workers, 0) << "transform_threads must be positive";
+  workers_.clear();
+  transform_pool_.reset();
+  if (num_workers > 1) {
+    for (int w = 0; w < num_workers; ++w) {
+      shared_ptr<TransformWorker> worker(new TransformWorker());
+      worker->transformer.reset(new DataTransformer<Dtype>(
+          this->transform_param_, this->phase_));
+      worker->transformer->InitRand(caffe_rng_rand());
+      worker->transformed_data.Reshape(this->transformed_data_.shape());
+      workers_.push_back(worker);
+    }
+    // The pool counts the prefetch thread, which runs workers too.
+    transform_pool_.reset(new ThreadPool(num_workers));
+    LOG(INFO) << "Transforming with " << num_workers << " threads";
+  }
+  if (!load_stats_mutex_) {
+    load_stats_mutex_.reset(new boost::mutex());
+  }
+  boost::mutex::scoped_lock lock(*load_stats_mutex_);
+  load_stats_ = DataLoadStats();
+  load_stats_.worker_transform_ms.resize(workers_.size());
+}
+
+template <typename Dtype>
+DataLoadStats DataLayer<Dtype>::load_stats() const {
+  CHECK(load_stats_mutex_) << "DataLayer is not set up";
+  boost::mutex::scoped_lock lock(*load_stats_mutex_);
+  return load_stats_;
+}
+
+template <typename Dtype>
+vector<int> DataLayer<Dtype>::InferRecordShape(const char* value,
+    const size_t size) {
+  DatumView view;
+  if (view.Parse(value, size) && !view.encoded) {
+    return this->data_transformer_->InferBlobShape(view);
   }
+  Datum datum;
+  CHECK(datum.ParseFromArray(value, size)) << "Failed to parse Datum";
+  return this->data_transformer_->InferBlobShape(datum);
 }
 
-// This function is used to create a thread that prefetches the data.
 template <typename Dtype>
-void DataLayer<Dtype>::InternalThreadEntry() {
+int DataLayer<Dtype>::TransformRecord(const char* value, const size_t size,
+    DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data) {
+  DatumView view;
+  if (view.Parse(value, size) && !view.encoded) {
+    transformer->Transform(view, transformed_data);
+    return view.label;
+  }
+  Datum datum;
+  CHECK(datum.ParseFromArray(value, size)) << "Failed to parse Datum";
+  transformer->Transform(datum, transformed_data);
+  return datum.label();
+}
+
+// This function is called on the transform pool threads, once per worker
+// and batch. Items are assigned round-robin so every worker consumes its
+// RNG in a fixed order, whichever thread runs it.
+template <typename Dtype>
+void DataLayer<Dtype>::TransformItems(const int worker_id,
+    Batch<Dtype>* batch, Dtype* top_data, Dtype* top_label) {
+  TransformWorker* worker = workers_[worker_id].get();
+  CPUTimer timer;
+  for (int item_id = worker_id; item_id < batch_values_.size();
+      item_id += workers_.size()) {
+    timer.Start();
+    worker->transformed_data.set_cpu_data(
+        top_data + batch->data_.offset(item_id));
+    const string& value = batch_values_[item_id];
+    const int label = TransformRecord(value.data(), value.size(),
+        worker->transformer.get(), &(worker->transformed_data));
+    if (top_label) {
+      top_label[item_id] = label;
+    }
+    worker->trans_time += timer.MicroSeconds();
+  }
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer batch_timer;
   batch_timer.Start();
   double read_time = 0;
   double trans_time = 0;
   CPUTimer timer;
-  CHECK(this->prefetch_data_.count());
+  CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
 
   // Reshape according to the first datum of each batch
   // on single input batches allows for inputs of varying dimension.
   const int batch_size = this->layer_param_.data_param().batch_size();
-  Datum datum;
-  datum.ParseFromString(cursor_->value());
+  const char* value;
+  size_t value_size;
+  cursor_->value_view(&value, &value_size);
   // Use data_transformer to infer the expected blob shape from datum.
-  vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
+  vector<int> top_shape = InferRecordShape(value, value_size);
   this->transformed_data_.Reshape(top_shape);
   // Reshape prefetch_data according to the batch_size.
   top_shape[0] = batch_size;
-  this->prefetch_data_.Reshape(top_shape);
+  batch->data_.Reshape(top_shape);
 
-  Dtype* top_data = this->prefetch_data_.mutable_cpu_data();
+  Dtype* top_data = batch->data_.mutable_cpu_data();
   Dtype* top_label = NULL;  // suppress warnings about uninitialized variables
 
   if (this->output_labels_) {
-    top_label = this->prefetch_label_.mutable_cpu_data();
+    top_label = batch->label_.mutable_cpu_data();
+  }
+  if (workers_.size() > 0) {
+    // The cursor is not thread safe: read the batch here, then hand the
+    // parsing and transformation of the items to the workers.
+    timer.Start();
+    batch_values_.resize(batch_size);
+    for (int item_id = 0; item_id < batch_size; ++item_id) {
+      batch_values_[item_id] = cursor_->value();
+      cursor_->Next();
+      if (!cursor_->valid()) {
+        DLOG(INFO) << "Restarting data prefetching from start.";
+        cursor_->SeekToFirst();
+      }
+    }
+    read_time += timer.MicroSeconds();
+    top_shape[0] = 1;
+    for (int w = 0; w < workers_.size(); ++w) {
+      workers_[w]->transformed_data.Reshape(top_shape);
+      workers_[w]->trans_time = 0;
+    }
+    {
+      // Workers write into the batch: do not let StopInternalThread unwind
+      // this thread before they are done.
+      boost::this_thread::disable_interruption no_interrupt;
+      // One chunk per worker, chunk c being [c, c + 1).
+      transform_pool_->ParallelForChunks(workers_.size(), 1,
+          boost::bind(&DataLayer<Dtype>::TransformItems, this, _1, batch,
+              top_data, top_label));
+    }
+    batch_timer.Stop();
+    DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
+    boost::mutex::scoped_lock lock(*load_stats_mutex_);
+    ++load_stats_.batches;
+    load_stats_.read_ms += read_time / 1000;
+    for (int w = 0; w < workers_.size(); ++w) {
+      load_stats_.transform_ms += workers_[w]->trans_time / 1000;
+      load_stats_.worker_transform_ms[w] += workers_[w]->trans_time / 1000;
+    }
+    return;
   }
   timer.Start();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a datum
-    Datum datum;
-    datum.ParseFromString(cursor_->value());
+    // get a datum, in place
+    cursor_->value_view(&value, &value_size);
     read_time += timer.MicroSeconds();
     timer.Start();
     // Apply data transformations (mirror, scale, crop...)
-    int offset = this->prefetch_data_.offset(item_id);
+    int offset = batch->data_.offset(item_id);
     this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
+    const int label = TransformRecord(value, value_size,
+        this->data_transformer_.get(), &(this->transformed_data_));
     // Copy label.
     if (this->output_labels_) {
-      top_label[item_id] = datum.label();
+      top_label[item_id] = label;
     }
     trans_time += timer.MicroSeconds();
     timer.Start();
@@ -118,8 +244,10 @@ void DataLayer<Dtype>::InternalThreadEntry() {
   timer.Stop();
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
-  DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
-  DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  boost::mutex::scoped_lock lock(*load_stats_mutex_);
+  ++load_stats_.batches;
+  load_stats_.read_ms += read_time / 1000;
+  load_stats_.transform_ms += trans_time / 1000;
 }
 
 INSTANTIATE_CLASS (DataLayer);
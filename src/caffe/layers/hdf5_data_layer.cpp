@@ -1,11 +1,6 @@
-/*
- TODO:
- - load file in a separate thread ("prefetch")
- - can be smarter about the memcpy call instead of doing it row-by-row
- :: use util functions caffe_copy, and Blob->offset()
- :: don't forget to update hdf5_daa_layer.cu accordingly
- - add ability to shuffle filenames if flag is set
- */
+#include <boost/thread.hpp>
+
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -17,67 +12,187 @@
 #include "caffe/data_layers.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/trace.hpp"
 
 namespace caffe {
 
+template <typename T>
+static void Shuffle(Caffe::RNG* rng, vector<T>* values) {
+  shuffle(values->begin(), values->end(),
+      static_cast<caffe::rng_t*>(rng->generator()));
+}
+
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+HDF5ChunkReader<Dtype>::HDF5ChunkReader(const vector<string>& filenames,
+    const vector<string>& datasets, const int chunk_rows, const bool shuffle)
+    : filenames_(filenames), datasets_(datasets), chunk_rows_(chunk_rows),
+      shuffle_(shuffle), resident_(false), current_(NULL) {
+  CHECK_GE(filenames_.size(), 1);
+  CHECK_GE(datasets_.size(), 1);
+  CHECK_GE(chunk_rows_, 0);
+  if (shuffle_) {
+    // The global RNG isn't safe to use from the reader thread.
+    rng_.reset(new Caffe::RNG(caffe_rng_rand()));
+  }
+  if (filenames_.size() == 1) {
+    const char* filename = filenames_[0].c_str();
+    HDF5Lock lock;
+    hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    const hsize_t rows = NumRows(file_id, filenames_[0]);
+    if (chunk_rows_ == 0 || rows <= (hsize_t) chunk_rows_) {
+      ReadChunk(file_id, 0, rows, &chunks_[0]);
+      resident_ = true;
+    }
+    herr_t status = H5Fclose(file_id);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  }
+  if (!resident_) {
+    free_.push(&chunks_[0]);
+    free_.push(&chunks_[1]);
+    CHECK(StartInternalThread()) << "Thread execution failed";
+  }
+}
+
+template <typename Dtype>
+HDF5ChunkReader<Dtype>::~HDF5ChunkReader() {
+  // The thread uses the queues, which go before the base class.
+  StopInternalThread();
+}
+
+template <typename Dtype>
+HDF5Chunk<Dtype>* HDF5ChunkReader<Dtype>::Next() {
+  if (resident_) {
+    if (current_ == NULL) {
+      current_ = &chunks_[0];
+    } else if (shuffle_) {
+      Shuffle(rng_.get(), &current_->order);
+    }
+    return current_;
+  }
+  if (current_) {
+    free_.push(current_);
+  }
+  current_ = full_.pop("Waiting for HDF5 data");
+  return current_;
 }
 
-// Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
-  DLOG(INFO) << "Loading HDF5 file: " << filename;
-  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+void HDF5ChunkReader<Dtype>::InternalThreadEntry() {
+  try {
+    vector<int> files(filenames_.size());
+    for (int i = 0; i < files.size(); ++i) {
+      files[i] = i;
+    }
+    while (!must_stop()) {
+      if (shuffle_) {
+        Shuffle(rng_.get(), &files);
+      }
+      for (int i = 0; i < files.size(); ++i) {
+        ReadFile(filenames_[files[i]]);
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template <typename Dtype>
+void HDF5ChunkReader<Dtype>::ReadFile(const string& filename) {
+  DLOG(INFO) << "Streaming HDF5 file: " << filename;
+  hid_t file_id;
+  {
+    // The lock isn't held while waiting for a free chunk, so that other
+    // threads can use HDF5 meanwhile; the helpers take it per read.
+    HDF5Lock lock;
+    file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  }
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
   }
+  try {
+    const hsize_t rows = NumRows(file_id, filename);
+    const hsize_t chunk_rows =
+        (chunk_rows_ == 0) ? rows : std::min<hsize_t>(chunk_rows_, rows);
+    vector<hsize_t> starts;
+    for (hsize_t start = 0; start < rows; start += chunk_rows) {
+      starts.push_back(start);
+    }
+    if (shuffle_) {
+      Shuffle(rng_.get(), &starts);
+    }
+    for (int i = 0; i < starts.size(); ++i) {
+      HDF5Chunk<Dtype>* chunk = free_.pop();
+      {
+        TraceScope trace(filename, "hdf5_read");
+        ReadChunk(file_id, starts[i], std::min(chunk_rows, rows - starts[i]),
+            chunk);
+      }
+      full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    HDF5Lock lock;
+    H5Fclose(file_id);
+    throw;
+  }
+  HDF5Lock lock;
+  herr_t status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+}
 
-  int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
+template <typename Dtype>
+hsize_t HDF5ChunkReader<Dtype>::NumRows(hid_t file_id,
+    const string& filename) {
+  const hsize_t rows = hdf5_get_num_rows(file_id, datasets_[0].c_str());
+  CHECK_GT(rows, 0) << "No rows in HDF5 file: " << filename;
+  for (int i = 1; i < datasets_.size(); ++i) {
+    CHECK_EQ(hdf5_get_num_rows(file_id, datasets_[i].c_str()), rows);
+  }
+  return rows;
+}
 
+template <typename Dtype>
+void HDF5ChunkReader<Dtype>::ReadChunk(hid_t file_id, const hsize_t start_row,
+    const hsize_t num_rows, HDF5Chunk<Dtype>* chunk) {
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
 
-  for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr < Blob<Dtype> > (new Blob<Dtype>());
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get());
+  chunk->shapes.resize(datasets_.size());
+  chunk->data.resize(datasets_.size());
+  for (int i = 0; i < datasets_.size(); ++i) {
+    hdf5_load_nd_dataset_rows(file_id, datasets_[i].c_str(), MIN_DATA_DIM,
+        MAX_DATA_DIM, start_row, num_rows, &chunk->shapes[i],
+        &chunk->data[i]);
   }
-
-  herr_t status = H5Fclose(file_id);
-  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
-
-  // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
-  }
-  // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
-    data_permutation_[i] = i;
-
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successully loaded " << hdf_blobs_[0]->shape(0)
-        << " rows (shuffled)";
-  } else {
-    DLOG(INFO) << "Successully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+  chunk->order.resize(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    chunk->order[i] = i;
+  }
+  if (shuffle_) {
+    Shuffle(rng_.get(), &chunk->order);
   }
 }
 
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  // The prefetch thread reads from reader_.
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   // Refuse transformation parameters since HDF5 is totally generic.
   CHECK(!this->layer_param_.has_transform_param()) << this->type()
       << " does not transform data.";
   // Read the source to parse the filenames.
-  const string& source = this->layer_param_.hdf5_data_param().source();
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  const string& source = param.source();
   LOG(INFO) << "Loading list of HDF5 filenames from: " << source;
   hdf_filenames_.clear();
   std::ifstream source_file(source.c_str());
@@ -90,119 +205,79 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     LOG(FATAL) << "Failed to open source file: " << source;
   }
   source_file.close();
-  num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
-  LOG(INFO) << "Number of HDF5 files: " << num_files_;
-  CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
-      << source;
-
-  file_permutation_.clear();
-  file_permutation_.resize(num_files_);
-  // Default to identity permutation.
-  for (int i = 0; i < num_files_; i++) {
-    file_permutation_[i] = i;
-  }
+  LOG(INFO) << "Number of HDF5 files: " << hdf_filenames_.size();
+  CHECK_GE(hdf_filenames_.size(), 1)
+      << "Must have at least 1 HDF5 filename listed in " << source;
 
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
+  // Start streaming, and take the first chunk for the shapes.
+  const int top_size = this->layer_param_.top_size();
+  vector<string> datasets(top_size);
+  for (int i = 0; i < top_size; ++i) {
+    datasets[i] = this->layer_param_.top(i);
   }
-
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
-  current_row_ = 0;
+  reader_.reset(new HDF5ChunkReader<Dtype>(hdf_filenames_, datasets,
+      param.chunk_size(), param.shuffle()));
+  chunk_ = reader_->Next();
+  chunk_row_ = 0;
 
   // Reshape blobs.
-  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  const int top_size = this->layer_param_.top_size();
-  vector<int> top_shape;
+  const int batch_size = param.batch_size();
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->extra_.resize(std::max(top_size - 2, 0));
+    for (int j = 0; j < this->prefetch_[i]->extra_.size(); ++j) {
+      this->prefetch_[i]->extra_[j].reset(new Blob<Dtype>());
+    }
+  }
   for (int i = 0; i < top_size; ++i) {
-    top_shape.resize(hdf_blobs_[i]->num_axes());
+    vector<int> top_shape = chunk_->shapes[i];
     top_shape[0] = batch_size;
-    for (int j = 1; j < top_shape.size(); ++j) {
-      top_shape[j] = hdf_blobs_[i]->shape(j);
-    }
     top[i]->Reshape(top_shape);
+    for (int j = 0; j < this->prefetch_.size(); ++j) {
+      batch_blob(this->prefetch_[j].get(), i)->Reshape(top_shape);
+    }
   }
 }
 
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
-  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i, ++current_row_) {
-    if (current_row_ == hdf_blobs_[0]->shape(0)) {
-      if (num_files_ > 1) {
-        ++current_file_;
-        if (current_file_ == num_files_) {
-          current_file_ = 0;
-          if (this->layer_param_.hdf5_data_param().shuffle()) {
-            std::random_shuffle(file_permutation_.begin(),
-                file_permutation_.end());
-          }
-          DLOG(INFO) << "Looping around to first file.";
-        }
-        LoadHDF5FileData(
-            hdf_filenames_[file_permutation_[current_file_]].c_str());
-      }
-      current_row_ = 0;
-      if (this->layer_param_.hdf5_data_param().shuffle())
-        std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    }
-    for (int j = 0; j < this->layer_param_.top_size(); ++j) {
-      int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_] * data_dim],
-          &top[j]->mutable_cpu_data()[i * data_dim]);
-    }
+Blob<Dtype>* HDF5DataLayer<Dtype>::batch_blob(Batch<Dtype>* batch,
+    const int i) {
+  if (i == 0) {
+    return &batch->data_;
   }
+  return (i == 1) ? &batch->label_ : batch->extra_[i - 2].get();
 }
 
-// begin: code modified for OpenCL port
-#ifndef CPU_ONLY
+// This function is called on prefetch thread
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
-    const vector<Blob<Dtype>*>& top) {
+void HDF5DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i, ++current_row_) {
-    if (current_row_ == hdf_blobs_[0]->shape(0)) {
-      if (num_files_ > 1) {
-        current_file_ += 1;
-        if (current_file_ == num_files_) {
-          current_file_ = 0;
-          if (this->layer_param_.hdf5_data_param().shuffle()) {
-            std::random_shuffle(file_permutation_.begin(),
-                file_permutation_.end());
-          }
-          DLOG(INFO) << "Looping around to first file.";
-        }
-        LoadHDF5FileData(
-            hdf_filenames_[file_permutation_[current_file_]].c_str());
+  const int top_size = this->layer_param_.top_size();
+  vector<Dtype*> batch_data(top_size);
+  vector<int> data_dims(top_size);
+  for (int j = 0; j < top_size; ++j) {
+    Blob<Dtype>* blob = batch_blob(batch, j);
+    batch_data[j] = blob->mutable_cpu_data();
+    data_dims[j] = blob->count() / blob->shape(0);
+  }
+  for (int i = 0; i < batch_size; ++i, ++chunk_row_) {
+    if (chunk_row_ == chunk_->order.size()) {
+      chunk_ = reader_->Next();
+      chunk_row_ = 0;
+      for (int j = 0; j < top_size; ++j) {
+        CHECK_EQ(chunk_->data[j].size(), chunk_->order.size() * data_dims[j])
+            << "Rows of " << this->layer_param_.top(j)
+            << " differ in shape between HDF5 files";
       }
-      current_row_ = 0;
-      if (this->layer_param_.hdf5_data_param().shuffle())
-        std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
     }
-    for (int j = 0; j < this->layer_param_.top_size(); ++j) {
-      int data_dim = top[j]->count() / top[j]->shape(0);
-      OCL_CHECK(
-          clEnqueueWriteBuffer(amdDevice.CommandQueue,
-              (cl_mem) top[j]->mutable_gpu_data(), CL_TRUE,
-              i * data_dim * sizeof(Dtype), sizeof(Dtype) * data_dim,
-              &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-                  * data_dim], 0, NULL, NULL));
-      //caffe_copy(data_dim,
-      //    &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-      //      * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
+    const size_t row = chunk_->order[chunk_row_];
+    for (int j = 0; j < top_size; ++j) {
+      caffe_copy(data_dims[j], &chunk_->data[j][row * data_dims[j]],
+          batch_data[j] + i * data_dims[j]);
     }
   }
 }
-// end: code modified for OpenCL port
-
-#else
-STUB_GPU_FORWARD(HDF5DataLayer, Forward);
-#endif
 
+INSTANTIATE_CLASS (HDF5ChunkReader);
 INSTANTIATE_CLASS (HDF5DataLayer);
 REGISTER_LAYER_CLASS (HDF5Data);
 
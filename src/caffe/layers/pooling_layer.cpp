@@ -149,7 +149,7 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
       caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
+    } else if (!this->inference_only_) {
       mask = max_idx_.mutable_cpu_data();
       caffe_set(top_count, -1, mask);
     }
@@ -173,7 +173,7 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                   top_data[pool_index] = bottom_data[index];
                   if (use_top_mask) {
                     top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
+                  } else if (mask) {
                     mask[pool_index] = index;
                   }
                 }
@@ -186,7 +186,7 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
         top_data += top[0]->offset(0, 1);
         if (use_top_mask) {
           top_mask += top[0]->offset(0, 1);
-        } else {
+        } else if (mask) {
           mask += top[0]->offset(0, 1);
         }
       }
@@ -330,7 +330,7 @@ void PoolingLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
   case PoolingParameter_PoolMethod_MAX:
     if (use_top_mask) {
       top_mask = top[1]->mutable_gpu_data();
-    } else {
+    } else if (!this->inference_only_) {
       mask = max_idx_.mutable_gpu_data();
     }
     // NOLINT_NEXT_LINE(whitespace/operators)
@@ -0,0 +1,200 @@
+#include <cstring>
+#include <vector>
+
+#include "caffe/layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/vision_layers.hpp"
+
+namespace caffe {
+
+// F(2x2, 3x3): 4x4 input tiles, 2x2 output tiles, 16 transformed elements.
+static const int kTileElements = 16;
+
+template <typename Dtype>
+bool WinogradConvolutionLayer<Dtype>::IsSupported(
+    const ConvolutionParameter& conv_param) {
+  const bool kernel_3x3 = conv_param.has_kernel_size() ?
+      conv_param.kernel_size() == 3 :
+      conv_param.kernel_h() == 3 && conv_param.kernel_w() == 3;
+  const bool stride_1 = conv_param.has_stride_h() ?
+      conv_param.stride_h() == 1 && conv_param.stride_w() == 1 :
+      conv_param.stride() == 1;
+  return kernel_3x3 && stride_1;
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  CHECK(this->kernel_h_ == 3 && this->kernel_w_ == 3)
+      << "WINOGRAD convolution only supports 3x3 kernels.";
+  CHECK(this->stride_h_ == 1 && this->stride_w_ == 1)
+      << "WINOGRAD convolution only supports stride 1.";
+  filter_transform_.Reshape(kTileElements, this->num_output_,
+      this->channels_ / this->group_, 1);
+  // Forces the first filter transform.
+  transformed_weights_.Reshape(0, 1, 1, 1);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  tiles_h_ = (this->height_out_ + 1) / 2;
+  tiles_w_ = (this->width_out_ + 1) / 2;
+  input_transform_.Reshape(kTileElements, this->channels_, tiles_h_,
+      tiles_w_);
+  output_transform_.Reshape(kTileElements, this->num_output_, tiles_h_,
+      tiles_w_);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformFilters() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (transformed_weights_.count() == weights.count()
+      && memcmp(transformed_weights_.cpu_data(), weights.cpu_data(),
+          sizeof(Dtype) * weights.count()) == 0) {
+    return;
+  }
+  transformed_weights_.ReshapeLike(weights);
+  caffe_copy(weights.count(), weights.cpu_data(),
+      transformed_weights_.mutable_cpu_data());
+  const int num_filters = this->num_output_ * this->channels_ / this->group_;
+  const Dtype* weight = weights.cpu_data();
+  Dtype* U = filter_transform_.mutable_cpu_data();
+  for (int f = 0; f < num_filters; ++f) {
+    const Dtype* g = weight + f * 9;
+    // t = G g
+    Dtype t[4][3];
+    for (int j = 0; j < 3; ++j) {
+      t[0][j] = g[j];
+      t[1][j] = (g[j] + g[3 + j] + g[6 + j]) / 2;
+      t[2][j] = (g[j] - g[3 + j] + g[6 + j]) / 2;
+      t[3][j] = g[6 + j];
+    }
+    // u = t G^T
+    for (int i = 0; i < 4; ++i) {
+      U[(i * 4 + 0) * num_filters + f] = t[i][0];
+      U[(i * 4 + 1) * num_filters + f] = (t[i][0] + t[i][1] + t[i][2]) / 2;
+      U[(i * 4 + 2) * num_filters + f] = (t[i][0] - t[i][1] + t[i][2]) / 2;
+      U[(i * 4 + 3) * num_filters + f] = t[i][2];
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformInput(const Dtype* input) {
+  const int num_tiles = tiles_h_ * tiles_w_;
+  Dtype* V = input_transform_.mutable_cpu_data();
+  for (int c = 0; c < this->channels_; ++c) {
+    const Dtype* im = input + c * this->height_ * this->width_;
+    for (int ty = 0; ty < tiles_h_; ++ty) {
+      for (int tx = 0; tx < tiles_w_; ++tx) {
+        Dtype d[4][4];
+        for (int i = 0; i < 4; ++i) {
+          const int y = ty * 2 - this->pad_h_ + i;
+          for (int j = 0; j < 4; ++j) {
+            const int x = tx * 2 - this->pad_w_ + j;
+            d[i][j] = (y >= 0 && y < this->height_ && x >= 0
+                && x < this->width_) ? im[y * this->width_ + x] : Dtype(0);
+          }
+        }
+        // t = B^T d
+        Dtype t[4][4];
+        for (int j = 0; j < 4; ++j) {
+          t[0][j] = d[0][j] - d[2][j];
+          t[1][j] = d[1][j] + d[2][j];
+          t[2][j] = d[2][j] - d[1][j];
+          t[3][j] = d[1][j] - d[3][j];
+        }
+        // v = t B
+        Dtype* v = V + c * num_tiles + ty * tiles_w_ + tx;
+        const int stride = this->channels_ * num_tiles;
+        for (int i = 0; i < 4; ++i) {
+          v[(i * 4 + 0) * stride] = t[i][0] - t[i][2];
+          v[(i * 4 + 1) * stride] = t[i][1] + t[i][2];
+          v[(i * 4 + 2) * stride] = t[i][2] - t[i][1];
+          v[(i * 4 + 3) * stride] = t[i][1] - t[i][3];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformOutput(Dtype* output) {
+  const int num_tiles = tiles_h_ * tiles_w_;
+  const int stride = this->num_output_ * num_tiles;
+  const Dtype* M = output_transform_.cpu_data();
+  for (int o = 0; o < this->num_output_; ++o) {
+    Dtype* out = output + o * this->height_out_ * this->width_out_;
+    for (int ty = 0; ty < tiles_h_; ++ty) {
+      for (int tx = 0; tx < tiles_w_; ++tx) {
+        const Dtype* m = M + o * num_tiles + ty * tiles_w_ + tx;
+        // r = A^T m
+        Dtype r[2][4];
+        for (int j = 0; j < 4; ++j) {
+          r[0][j] = m[j * stride] + m[(4 + j) * stride]
+              + m[(8 + j) * stride];
+          r[1][j] = m[(4 + j) * stride] - m[(8 + j) * stride]
+              - m[(12 + j) * stride];
+        }
+        // y = r A, clipped at the bottom and right borders
+        for (int i = 0; i < 2; ++i) {
+          const int y = ty * 2 + i;
+          if (y >= this->height_out_) {
+            break;
+          }
+          const int x = tx * 2;
+          out[y * this->width_out_ + x] = r[i][0] + r[i][1] + r[i][2];
+          if (x + 1 < this->width_out_) {
+            out[y * this->width_out_ + x + 1] = r[i][1] - r[i][2] - r[i][3];
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  TransformFilters();
+  const int num_tiles = tiles_h_ * tiles_w_;
+  const int out_per_group = this->num_output_ / this->group_;
+  const int in_per_group = this->channels_ / this->group_;
+  const int num_filters = this->num_output_ * in_per_group;
+  const Dtype* U = filter_transform_.cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      TransformInput(bottom_data + bottom[i]->offset(n));
+      const Dtype* V = input_transform_.cpu_data();
+      Dtype* M = output_transform_.mutable_cpu_data();
+      // One (outputs x inputs) by (inputs x tiles) gemm per tile element
+      // and group.
+      for (int e = 0; e < kTileElements; ++e) {
+        for (int g = 0; g < this->group_; ++g) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_per_group,
+              num_tiles, in_per_group, (Dtype) 1.,
+              U + e * num_filters + g * out_per_group * in_per_group,
+              V + (e * this->channels_ + g * in_per_group) * num_tiles,
+              (Dtype) 0.,
+              M + (e * this->num_output_ + g * out_per_group) * num_tiles);
+        }
+      }
+      TransformOutput(top_data + top[i]->offset(n));
+      if (this->fused_relu_) {
+        this->forward_cpu_bias_relu(top_data + top[i]->offset(n));
+      } else if (this->bias_term_) {
+        const Dtype* bias = this->blobs_[1]->cpu_data();
+        this->forward_cpu_bias(top_data + top[i]->offset(n), bias);
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS (WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <limits>
 #include <map>
 #include <set>
 #include <string>
@@ -12,13 +15,99 @@
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/neuron_fusion.hpp"
+#include "caffe/util/trace.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/vision_layers.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
 namespace caffe {
 
+#ifndef CPU_ONLY
+// Queue use of blob storage over one pass run on the layer queues. It is
+// keyed by SyncedMemory rather than blob, as split tops share the data of
+// their bottom: an in-place layer on one of them overwrites what the other
+// branches read.
+class StorageQueues {
+  public:
+    // Orders the active queue after the last writes of what the layer reads
+    // and writes, and after the reads of what it writes (write-after-read).
+    template <typename Dtype>
+    void Wait(const vector<Blob<Dtype>*>& reads,
+        const vector<Blob<Dtype>*>& writes, const bool diff) {
+      for (int j = 0; j < reads.size(); ++j) {
+        WaitForWriter(Storage(reads[j], diff));
+      }
+      for (int j = 0; j < writes.size(); ++j) {
+        const SyncedMemory* storage = Storage(writes[j], diff);
+        if (storage == NULL) {
+          continue;
+        }
+        WaitForWriter(storage);
+        std::map<const SyncedMemory*, std::set<int> >::iterator it =
+            readers_.find(storage);
+        if (it != readers_.end()) {
+          for (std::set<int>::iterator q = it->second.begin();
+              q != it->second.end(); ++q) {
+            amdDevice.WaitForQueue(*q);
+          }
+          readers_.erase(it);
+        }
+      }
+    }
+
+    template <typename Dtype>
+    void Record(const vector<Blob<Dtype>*>& reads,
+        const vector<Blob<Dtype>*>& writes, const bool diff,
+        const int queue) {
+      for (int j = 0; j < reads.size(); ++j) {
+        const SyncedMemory* storage = Storage(reads[j], diff);
+        if (storage != NULL) {
+          readers_[storage].insert(queue);
+        }
+      }
+      // Later accesses wait for the writer, which follows its own reads.
+      for (int j = 0; j < writes.size(); ++j) {
+        const SyncedMemory* storage = Storage(writes[j], diff);
+        if (storage == NULL) {
+          continue;
+        }
+        writer_[storage] = queue;
+        readers_.erase(storage);
+      }
+    }
+
+  protected:
+    // NULL for empty blobs, which may have no storage.
+    template <typename Dtype>
+    static const SyncedMemory* Storage(const Blob<Dtype>* blob,
+        const bool diff) {
+      if (blob->count() == 0) {
+        return NULL;
+      }
+      return diff ? blob->diff().get() : blob->data().get();
+    }
+
+    void WaitForWriter(const SyncedMemory* storage) {
+      if (storage == NULL) {
+        return;
+      }
+      std::map<const SyncedMemory*, int>::const_iterator it =
+          writer_.find(storage);
+      if (it != writer_.end()) {
+        amdDevice.WaitForQueue(it->second);
+      }
+    }
+
+    // Storage not written yet in the pass was written before ForkQueues.
+    std::map<const SyncedMemory*, int> writer_;
+    // The queues that read the storage since its last write
+    std::map<const SyncedMemory*, std::set<int> > readers_;
+};
+#endif
+
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param) {
   Init(param);
@@ -36,6 +125,9 @@ template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   // Set phase from the state.
   phase_ = in_param.state().phase();
+  inference_only_ = in_param.inference_only();
+  CHECK(!inference_only_ || !in_param.force_backward())
+      << "An inference-only net can't force backward.";
   // Filter layers based on their include/exclude rules and
   // the current NetState.
   NetParameter filtered_param;
@@ -60,6 +152,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         << "Exactly one input_shape must be specified per input.";
   }
   memory_used_ = 0;
+  memory_planned_ = 0;
   // set the input blobs
   for (int input_id = 0; input_id < param.input_size(); ++input_id) {
     const int layer_id = -1;  // inputs have fake layer ID -1
@@ -86,6 +179,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
           << "either 0 or bottom_size times ";
     }
     layers_.push_back(LayerRegistry < Dtype > ::CreateLayer(layer_param));
+    layers_.back()->set_inference_only(inference_only_);
     layer_names_.push_back(layer_param.name());
     LOG(INFO) << "Creating Layer " << layer_param.name();
     bool need_backward = false;
@@ -140,7 +234,8 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       const ParamSpec* param_spec =
           (param_id < param_size) ?
               &layer_param.param(param_id) : &default_param_spec;
-      const bool param_need_backward = param_spec->lr_mult() > 0;
+      const bool param_need_backward = !inference_only_
+          && param_spec->lr_mult() > 0;
       need_backward |= param_need_backward;
       layers_[layer_id]->set_param_propagate_down(param_id,
           param_need_backward);
@@ -156,60 +251,63 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       }
     }
   }
-  // Go through the net backwards to determine which blobs contribute to the
-  // loss.  We can skip backward computation for blobs that don't contribute
-  // to the loss.
-  // Also checks if all bottom blobs don't need backward computation (possible
-  // because the skip_propagate_down param) and so we can skip bacward
-  // computation for the entire layer
-  set < string > blobs_under_loss;
-  set < string > blobs_skip_backp;
-  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
-    bool layer_contributes_loss = false;
-    bool layer_skip_propagate_down = true;
-    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
-      const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
-      if (layers_[layer_id]->loss(top_id)
-          || (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
-        layer_contributes_loss = true;
+  // Nothing needs backward in an inference-only net.
+  if (!inference_only_) {
+    // Go through the net backwards to determine which blobs contribute to the
+    // loss.  We can skip backward computation for blobs that don't contribute
+    // to the loss.
+    // Also checks if all bottom blobs don't need backward computation (possible
+    // because the skip_propagate_down param) and so we can skip bacward
+    // computation for the entire layer
+    set < string > blobs_under_loss;
+    set < string > blobs_skip_backp;
+    for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+      bool layer_contributes_loss = false;
+      bool layer_skip_propagate_down = true;
+      for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+        const string& blob_name = blob_names_[top_id_vecs_[layer_id][top_id]];
+        if (layers_[layer_id]->loss(top_id)
+            || (blobs_under_loss.find(blob_name) != blobs_under_loss.end())) {
+          layer_contributes_loss = true;
+        }
+        if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
+          layer_skip_propagate_down = false;
+        }
+        if (layer_contributes_loss && !layer_skip_propagate_down)
+          break;
       }
-      if (blobs_skip_backp.find(blob_name) == blobs_skip_backp.end()) {
-        layer_skip_propagate_down = false;
+      // If this layer can skip backward computation, also all his bottom blobs
+      // don't need backpropagation
+      if (layer_need_backward_[layer_id] && layer_skip_propagate_down) {
+        layer_need_backward_[layer_id] = false;
+        for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+            ++bottom_id) {
+          bottom_need_backward_[layer_id][bottom_id] = false;
+        }
       }
-      if (layer_contributes_loss && !layer_skip_propagate_down)
-        break;
-    }
-    // If this layer can skip backward computation, also all his bottom blobs
-    // don't need backpropagation
-    if (layer_need_backward_[layer_id] && layer_skip_propagate_down) {
-      layer_need_backward_[layer_id] = false;
-      for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
-          ++bottom_id) {
-        bottom_need_backward_[layer_id][bottom_id] = false;
+      if (!layer_contributes_loss) {
+        layer_need_backward_[layer_id] = false;
       }
-    }
-    if (!layer_contributes_loss) {
-      layer_need_backward_[layer_id] = false;
-    }
-    if (layer_need_backward_[layer_id]) {
-      LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
-    } else {
-      LOG(INFO) << layer_names_[layer_id]
-          << " does not need backward computation.";
-    }
-    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
-        ++bottom_id) {
-      if (layer_contributes_loss) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_under_loss.insert(blob_name);
+      if (layer_need_backward_[layer_id]) {
+        LOG(INFO) << layer_names_[layer_id] << " needs backward computation.";
       } else {
-        bottom_need_backward_[layer_id][bottom_id] = false;
+        LOG(INFO) << layer_names_[layer_id]
+            << " does not need backward computation.";
       }
-      if (!bottom_need_backward_[layer_id][bottom_id]) {
-        const string& blob_name =
-            blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
-        blobs_skip_backp.insert(blob_name);
+      for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+          ++bottom_id) {
+        if (layer_contributes_loss) {
+          const string& blob_name =
+              blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
+          blobs_under_loss.insert(blob_name);
+        } else {
+          bottom_need_backward_[layer_id][bottom_id] = false;
+        }
+        if (!bottom_need_backward_[layer_id][bottom_id]) {
+          const string& blob_name =
+              blob_names_[bottom_id_vecs_[layer_id][bottom_id]];
+          blobs_skip_backp.insert(blob_name);
+        }
       }
     }
   }
@@ -247,8 +345,243 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   }
   GetLearningRateAndWeightDecay();
   debug_info_ = param.debug_info();
+  profile_ = param.profile();
+  ClearProfile();
+  if (param.tune_packing()) {
+    TunePacking(param.packing_tuning_file(),
+        (size_t) param.packing_memory_budget() << 20);
+  }
+  if (param.memory_optimize()) {
+    if (phase_ == TEST) {
+      PlanMemory();
+    } else {
+      LOG(WARNING) << "memory_optimize is only supported in the TEST phase.";
+    }
+  }
   LOG(INFO) << "Network initialization done.";
   LOG(INFO) << "Memory required for data: " << memory_used_ * sizeof(Dtype);
+  if (memory_planned_) {
+    LOG(INFO) << "Memory planned for data: " << memory_planned_;
+  }
+  layer_queues_.clear();
+  num_layer_queues_ = 1;
+  if (param.concurrent_branches()) {
+    AssignLayerQueues();
+  }
+  fused_chains_.assign(layers_.size(),
+      shared_ptr<FusedNeuronChain<Dtype> >());
+  fused_chain_end_.resize(layers_.size());
+  fused_chain_start_.resize(layers_.size());
+  for (int i = 0; i < layers_.size(); ++i) {
+    fused_chain_end_[i] = i;
+    fused_chain_start_[i] = i;
+  }
+  if (inference_only_) {
+    DisableDiffs();
+  }
+  layer_fused_.assign(layers_.size(), false);
+  if (param.fuse_conv_relu()) {
+    FuseConvReLU();
+  }
+  if (param.fuse_neurons()) {
+    FuseNeuronChains();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::DisableDiffs() {
+  // Loss layers keep their loss weights in the diffs of their tops and may
+  // use the diffs of their bottoms as scratch in Forward.
+  vector<bool> keep_diff(blobs_.size(), false);
+  for (int i = 0; i < layers_.size(); ++i) {
+    bool has_loss = false;
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      has_loss |= layers_[i]->loss(j) != Dtype(0);
+    }
+    if (!has_loss) {
+      continue;
+    }
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      keep_diff[bottom_id_vecs_[i][j]] = true;
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      keep_diff[top_id_vecs_[i][j]] = true;
+    }
+  }
+  for (int i = 0; i < blobs_.size(); ++i) {
+    if (!keep_diff[i]) {
+      blobs_[i]->DisableDiff();
+    }
+  }
+  for (int i = 0; i < params_.size(); ++i) {
+    params_[i]->DisableDiff();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FuseConvReLU() {
+  for (int i = 0; i + 1 < layers_.size(); ++i) {
+    ConvolutionLayer<Dtype>* conv_layer =
+        dynamic_cast<ConvolutionLayer<Dtype>*>(layers_[i].get());
+    const LayerParameter& relu_param = layers_[i + 1]->layer_param();
+    if (conv_layer == NULL || relu_param.type() != "ReLU"
+        || top_id_vecs_[i].size() != 1 || layers_[i]->loss(0) != Dtype(0)) {
+      continue;
+    }
+    // Layers reading the conv top before the ReLU would see it rectified.
+    const int top_id = top_id_vecs_[i][0];
+    if (bottom_id_vecs_[i + 1].size() != 1 || top_id_vecs_[i + 1].size() != 1
+        || bottom_id_vecs_[i + 1][0] != top_id
+        || top_id_vecs_[i + 1][0] != top_id) {
+      continue;
+    }
+    conv_layer->set_fused_relu(true, relu_param.relu_param().negative_slope());
+    layer_fused_[i + 1] = true;
+    LOG(INFO) << "Fused " << layer_names_[i + 1] << " into "
+        << layer_names_[i];
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FuseNeuronChains() {
+#ifndef CPU_ONLY
+  // Kernels are built for the device, so CPU nets keep their layers.
+  if (Caffe::mode() == Caffe::CPU) {
+    return;
+  }
+  const set<int> net_outputs(net_output_blob_indices_.begin(),
+      net_output_blob_indices_.end());
+  for (int i = 0; i < layers_.size(); ++i) {
+    const LayerParameter& head = layers_[i]->layer_param();
+    if (layer_fused_[i] || !FusedNeuronChain<Dtype>::CanFuse(head, false)) {
+      continue;
+    }
+    // Backward recomputes the chain from its bottom, which no layer of the
+    // chain may overwrite.
+    const bool with_backward = bottom_need_backward_[i][0];
+    const int bottom_id = bottom_id_vecs_[i][0];
+    int last = i - 1;
+    for (int k = i; k < layers_.size(); ++k) {
+      const LayerParameter& layer_param = layers_[k]->layer_param();
+      if (layer_fused_[k]
+          || !FusedNeuronChain<Dtype>::CanFuse(layer_param, with_backward)
+          || layers_[k]->loss(0) != Dtype(0)
+          || (with_backward && top_id_vecs_[k][0] == bottom_id)) {
+        break;
+      }
+      if (k > i && (bottom_id_vecs_[k][0] != top_id_vecs_[k - 1][0]
+          || net_outputs.count(top_id_vecs_[k - 1][0]))) {
+        break;
+      }
+      last = k;
+    }
+    if (last <= i) {
+      continue;
+    }
+    vector<LayerParameter> params;
+    for (int k = i; k <= last; ++k) {
+      params.push_back(layers_[k]->layer_param());
+    }
+    shared_ptr<FusedNeuronChain<Dtype> > chain(
+        new FusedNeuronChain<Dtype>(params, with_backward));
+    if (!chain->valid()) {
+      LOG(WARNING) << "Running layers " << layer_names_[i] << " to "
+          << layer_names_[last] << " unfused";
+    } else {
+      LOG(INFO) << "Fused layers " << layer_names_[i] << " to "
+          << layer_names_[last] << " into one kernel";
+      fused_chains_[i] = chain;
+      fused_chain_end_[i] = last;
+      fused_chain_start_[last] = i;
+    }
+    i = last;
+  }
+#endif
+}
+
+template <typename Dtype>
+int Net<Dtype>::ForwardChainEnd(const int layer_id, const int end) const {
+  // Debug info shows the top of every layer.
+  if (Caffe::mode() == Caffe::CPU || debug_info_
+      || fused_chain_end_[layer_id] > end) {
+    return layer_id;
+  }
+  return fused_chain_end_[layer_id];
+}
+
+template <typename Dtype>
+int Net<Dtype>::BackwardChainStart(const int layer_id, const int end) const {
+  if (Caffe::mode() == Caffe::CPU || debug_info_
+      || fused_chain_start_[layer_id] < end) {
+    return layer_id;
+  }
+  return fused_chain_start_[layer_id];
+}
+
+template <typename Dtype>
+void Net<Dtype>::AssignLayerQueues() {
+#ifndef CPU_ONLY
+  const int num_queues = amdDevice.num_queues();
+  if (num_queues <= 1) {
+    return;
+  }
+  // Planned blobs share storage by their lifetimes in layer order.
+  if (memory_planned_) {
+    return;
+  }
+  // Layers sharing a param would accumulate its diff concurrently.
+  for (int i = 0; i < param_owners_.size(); ++i) {
+    if (param_owners_[i] >= 0) {
+      return;
+    }
+  }
+  vector<int> queues(layers_.size(), 0);
+  vector<int> blob_producer(blobs_.size(), -1);
+  vector<bool> queue_continued(layers_.size(), false);
+  int last_queue = 0;
+  int max_queue = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    int queue = -1;
+    bool has_producer = false;
+    for (int j = 0; j < bottom_id_vecs_[i].size() && queue < 0; ++j) {
+      const int producer = blob_producer[bottom_id_vecs_[i][j]];
+      if (producer < 0) {
+        continue;
+      }
+      has_producer = true;
+      if (!queue_continued[producer]) {
+        queue_continued[producer] = true;
+        queue = queues[producer];
+      }
+    }
+    if (queue < 0) {
+      // Sources and layers fed only by net inputs start on the main queue.
+      if (has_producer) {
+        last_queue = (last_queue + 1) % num_queues;
+        queue = last_queue;
+      } else {
+        queue = 0;
+      }
+    }
+    queues[i] = queue;
+    max_queue = std::max(max_queue, queue);
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      blob_producer[top_id_vecs_[i][j]] = i;
+    }
+  }
+  if (max_queue == 0) {
+    return;
+  }
+  layer_queues_ = queues;
+  num_layer_queues_ = max_queue + 1;
+  LOG(INFO) << "Independent branches run on " << num_layer_queues_
+      << " command queues.";
+#endif
+}
+
+template <typename Dtype>
+bool Net<Dtype>::use_layer_queues() const {
+  return !layer_queues_.empty() && Caffe::mode() != Caffe::CPU;
 }
 
 template <typename Dtype>
@@ -506,6 +839,226 @@ void Net<Dtype>::GetLearningRateAndWeightDecay() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::TunePacking(const string& tuning_file,
+    const size_t memory_budget) {
+  const int kTuneRuns = 3;
+  map<string, int> tuned;
+  {
+    std::ifstream in(tuning_file.c_str());
+    string key;
+    int packing_num;
+    while (in >> key >> packing_num) {
+      tuned[key] = packing_num;
+    }
+  }
+  bool updated = false;
+  CPUTimer timer;
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    BaseConvolutionLayer<Dtype>* conv_layer =
+        dynamic_cast<BaseConvolutionLayer<Dtype>*>(layers_[layer_id].get());
+    if (!conv_layer
+        || layers_[layer_id]->layer_param().convolution_param()
+            .has_packing_num()) {
+      continue;
+    }
+    const vector<int> candidates = conv_layer->packing_candidates();
+    if (candidates.size() < 2) {
+      continue;
+    }
+    const string key = conv_layer->packing_key();
+    map<string, int>::const_iterator it = tuned.find(key);
+    if (it != tuned.end()) {
+      conv_layer->set_packing_num(it->second);
+      continue;
+    }
+    int best_num = candidates[0];
+    float best_ms = std::numeric_limits<float>::max();
+    for (int i = 0; i < candidates.size(); ++i) {
+      if (i > 0 && conv_layer->packing_memory(candidates[i]) > memory_budget) {
+        break;
+      }
+      conv_layer->set_packing_num(candidates[i]);
+      // The first pass allocates the scratch memory and is not timed.
+      for (int run = 0; run <= kTuneRuns; ++run) {
+        if (run == 1) {
+          timer.Start();
+        }
+        layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+#ifndef CPU_ONLY
+        clFinish(amdDevice.CommandQueue);
+#endif
+      }
+      const float ms = timer.MicroSeconds() / 1000. / kTuneRuns;
+      DLOG(INFO) << layer_names_[layer_id] << " packing " << candidates[i]
+          << ": " << ms << " ms";
+      if (ms < best_ms) {
+        best_ms = ms;
+        best_num = candidates[i];
+      }
+    }
+    conv_layer->set_packing_num(best_num);
+    tuned[key] = best_num;
+    updated = true;
+    LOG(INFO) << "Tuned " << layer_names_[layer_id] << " to pack " << best_num
+        << " images per gemm (" << best_ms << " ms)";
+  }
+  if (!updated) {
+    return;
+  }
+  // Write a temporary file first so concurrent runs never read a torn file.
+  const string tmp_file = tuning_file + ".tmp";
+  {
+    std::ofstream out(tmp_file.c_str());
+    for (map<string, int>::const_iterator it = tuned.begin();
+        it != tuned.end(); ++it) {
+      out << it->first << " " << it->second << "\n";
+    }
+    if (!out) {
+      LOG(WARNING) << "Could not write packing tuning file " << tmp_file;
+      return;
+    }
+  }
+  if (std::rename(tmp_file.c_str(), tuning_file.c_str()) != 0) {
+    LOG(WARNING) << "Could not write packing tuning file " << tuning_file;
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanMemory() {
+  const int num_layers = layers_.size();
+  const int num_blobs = blobs_.size();
+  // Blobs that already share a SyncedMemory after SetUp (in-place layers,
+  // Split, Flatten, Reshape, ...) are planned together as one storage group.
+  vector<int> blob_group(num_blobs, -1);
+  map<const SyncedMemory*, int> storage_to_group;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (blobs_[blob_id]->count() == 0) {
+      continue;
+    }
+    const SyncedMemory* storage = blobs_[blob_id]->data().get();
+    map<const SyncedMemory*, int>::iterator it = storage_to_group.find(storage);
+    if (it == storage_to_group.end()) {
+      const int group_id = storage_to_group.size();
+      storage_to_group[storage] = group_id;
+      blob_group[blob_id] = group_id;
+    } else {
+      blob_group[blob_id] = it->second;
+    }
+  }
+  const int num_groups = storage_to_group.size();
+  vector<size_t> group_bytes(num_groups, 0);
+  vector<int> group_first_use(num_groups, num_layers);
+  vector<int> group_last_use(num_groups, -1);
+  vector<bool> group_pinned(num_groups, false);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int group_id = blob_group[blob_id];
+    if (group_id >= 0) {
+      group_bytes[group_id] = std::max(group_bytes[group_id],
+          blobs_[blob_id]->data()->size());
+    }
+  }
+  // Net inputs and outputs must stay valid across Forward calls. Tops of
+  // layers without bottoms (data layers) are pinned as well, since such
+  // layers may fill or rebind their tops only once.
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    const int group_id = blob_group[net_input_blob_indices_[i]];
+    if (group_id >= 0) {
+      group_pinned[group_id] = true;
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    const int group_id = blob_group[net_output_blob_indices_[i]];
+    if (group_id >= 0) {
+      group_pinned[group_id] = true;
+    }
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int group_id = blob_group[top_id_vecs_[layer_id][top_id]];
+      if (group_id < 0) {
+        continue;
+      }
+      group_first_use[group_id] = std::min(group_first_use[group_id],
+          layer_id);
+      group_last_use[group_id] = std::max(group_last_use[group_id], layer_id);
+      if (bottom_id_vecs_[layer_id].empty()) {
+        group_pinned[group_id] = true;
+      }
+    }
+    for (int bottom_id = 0; bottom_id < bottom_id_vecs_[layer_id].size();
+        ++bottom_id) {
+      const int group_id = blob_group[bottom_id_vecs_[layer_id][bottom_id]];
+      if (group_id < 0) {
+        continue;
+      }
+      group_first_use[group_id] = std::min(group_first_use[group_id],
+          layer_id);
+      group_last_use[group_id] = std::max(group_last_use[group_id], layer_id);
+    }
+  }
+  // Walk the layers in order and give each group produced by a layer the
+  // best-fitting buffer whose previous occupants are all dead by then; grow
+  // the largest free buffer if none is big enough, or open a new one.
+  vector<size_t> buffer_bytes;
+  vector<int> buffer_free_after;
+  vector<int> group_buffer(num_groups, -1);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int top_id = 0; top_id < top_id_vecs_[layer_id].size(); ++top_id) {
+      const int group_id = blob_group[top_id_vecs_[layer_id][top_id]];
+      if (group_id < 0 || group_pinned[group_id]
+          || group_buffer[group_id] >= 0
+          || group_first_use[group_id] != layer_id) {
+        continue;
+      }
+      int best_fit = -1;
+      int largest = -1;
+      for (int buffer_id = 0; buffer_id < buffer_bytes.size(); ++buffer_id) {
+        if (buffer_free_after[buffer_id] >= layer_id) {
+          continue;
+        }
+        if (buffer_bytes[buffer_id] >= group_bytes[group_id]
+            && (best_fit < 0
+                || buffer_bytes[buffer_id] < buffer_bytes[best_fit])) {
+          best_fit = buffer_id;
+        }
+        if (largest < 0 || buffer_bytes[buffer_id] > buffer_bytes[largest]) {
+          largest = buffer_id;
+        }
+      }
+      int buffer_id = (best_fit >= 0) ? best_fit : largest;
+      if (buffer_id < 0) {
+        buffer_id = buffer_bytes.size();
+        buffer_bytes.push_back(0);
+        buffer_free_after.push_back(-1);
+      }
+      buffer_bytes[buffer_id] = std::max(buffer_bytes[buffer_id],
+          group_bytes[group_id]);
+      buffer_free_after[buffer_id] = group_last_use[group_id];
+      group_buffer[group_id] = buffer_id;
+    }
+  }
+  vector<shared_ptr<SyncedMemory> > buffers(buffer_bytes.size());
+  memory_planned_ = 0;
+  for (int buffer_id = 0; buffer_id < buffer_bytes.size(); ++buffer_id) {
+    buffers[buffer_id].reset(new SyncedMemory(buffer_bytes[buffer_id]));
+    memory_planned_ += buffer_bytes[buffer_id];
+  }
+  for (int group_id = 0; group_id < num_groups; ++group_id) {
+    if (group_buffer[group_id] < 0) {
+      memory_planned_ += group_bytes[group_id];
+    }
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int group_id = blob_group[blob_id];
+    if (group_id >= 0 && group_buffer[group_id] >= 0) {
+      blobs_[blob_id]->SetDataStorage(buffers[group_buffer[group_id]]);
+    }
+  }
+  LOG(INFO) << "Memory planner assigned " << num_groups << " blob groups to "
+      << buffer_bytes.size() << " shared buffers.";
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
@@ -517,28 +1070,70 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     }
   }
 
-  CPUTimer forward_timer;
-  CPUTimer layer_timer;
-  forward_timer.Start();
+#ifndef CPU_ONLY
+  const bool layer_queues = use_layer_queues();
+  StorageQueues storage_queues;
+  if (layer_queues) {
+    amdDevice.ForkQueues(num_layer_queues_);
+    amdDevice.set_branch_queues(true);
+  }
+#endif
 
+  CPUTimer layer_timer;
   for (int i = start; i <= end; ++i) {
-    layer_timer.Start();
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
-    loss += layer_loss;
+    if (layer_fused_[i]) {
+      // Computed by the layer before, see FuseConvReLU.
+      layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+      continue;
+    }
+    TraceScope trace(layer_names_[i], "forward");
+    if (profile_) {
+      layer_timer.Start();
+    }
+    // A fused chain is timed as its first layer.
+    const int last = ForwardChainEnd(i, end);
+#ifndef CPU_ONLY
+    if (layer_queues) {
+      amdDevice.SetActiveQueue(layer_queues_[i]);
+      storage_queues.Wait(bottom_vecs_[i], top_vecs_[last], false);
+    }
+#endif
+    if (last > i) {
+#ifndef CPU_ONLY
+      for (int k = i; k <= last; ++k) {
+        layers_[k]->Reshape(bottom_vecs_[k], top_vecs_[k]);
+      }
+      fused_chains_[i]->Forward_gpu(bottom_vecs_[i][0], top_vecs_[last][0]);
+#endif
+    } else {
+      Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+      loss += layer_loss;
+    }
+#ifndef CPU_ONLY
+    if (layer_queues) {
+      storage_queues.Record(bottom_vecs_[i], top_vecs_[last], false,
+          layer_queues_[i]);
+    }
+#endif
     if (debug_info_) {
       ForwardDebugInfo(i);
     }
+    if (profile_) {
 #ifndef CPU_ONLY
-    clFinish(amdDevice.CommandQueue);
+      clFinish(amdDevice.CommandQueue);
 #endif
-    layer_timer.Stop();
-    printf("Forwarding %s,\ttime %f ms\n", layer_names_[i].c_str(),
-        layer_timer.MilliSeconds());
+      layer_profiles_[i].forward_ms += layer_timer.MicroSeconds() / 1000.;
+      ++layer_profiles_[i].forward_calls;
+    }
+    i = last;
   }
-
-  forward_timer.Stop();
-  printf("Total Forward time: %f\n\n", forward_timer.MilliSeconds());
-
+#ifndef CPU_ONLY
+  if (layer_queues) {
+    amdDevice.set_branch_queues(false);
+    amdDevice.SetActiveQueue(0);
+    amdDevice.JoinQueues(num_layer_queues_);
+  }
+#endif
   return loss;
 }
 
@@ -597,30 +1192,70 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  CHECK_EQ(memory_planned_, 0)
+      << "Backward is not supported by a net with planned memory.";
+  CHECK(!inference_only_)
+      << "Backward is not supported by an inference-only net.";
 
-  CPUTimer backward_timer;
-  CPUTimer layer_timer;
-  backward_timer.Start();
+#ifndef CPU_ONLY
+  const bool layer_queues = use_layer_queues();
+  StorageQueues storage_queues;
+  if (layer_queues) {
+    amdDevice.ForkQueues(num_layer_queues_);
+    amdDevice.set_branch_queues(true);
+  }
+#endif
 
+  CPUTimer layer_timer;
   for (int i = start; i >= end; --i) {
-    layer_timer.Start();
     if (layer_need_backward_[i]) {
-      layers_[i]->Backward(top_vecs_[i], bottom_need_backward_[i],
-          bottom_vecs_[i]);
+      TraceScope trace(layer_names_[i], "backward");
+      if (profile_) {
+        layer_timer.Start();
+      }
+      // A fused chain is timed as its last layer.
+      const int first = BackwardChainStart(i, end);
+#ifndef CPU_ONLY
+      if (layer_queues) {
+        amdDevice.SetActiveQueue(layer_queues_[i]);
+        storage_queues.Wait(top_vecs_[i], bottom_vecs_[first], true);
+      }
+#endif
+      if (first < i) {
+#ifndef CPU_ONLY
+        fused_chains_[first]->Backward_gpu(top_vecs_[i][0],
+            bottom_vecs_[first][0]);
+#endif
+      } else {
+        layers_[i]->Backward(top_vecs_[i], bottom_need_backward_[i],
+            bottom_vecs_[i]);
+      }
+#ifndef CPU_ONLY
+      if (layer_queues) {
+        storage_queues.Record(top_vecs_[i], bottom_vecs_[first], true,
+            layer_queues_[i]);
+      }
+#endif
       if (debug_info_) {
         BackwardDebugInfo(i);
       }
+      if (profile_) {
 #ifndef CPU_ONLY
-      clFinish(amdDevice.CommandQueue);
+        clFinish(amdDevice.CommandQueue);
 #endif
-      layer_timer.Start();
-      printf("Backwarding %s,\ttime %f ms\n", layer_names_[i].c_str(),
-          layer_timer.MilliSeconds());
+        layer_profiles_[i].backward_ms += layer_timer.MicroSeconds() / 1000.;
+        ++layer_profiles_[i].backward_calls;
+      }
+      i = first;
     }
   }
-
-  backward_timer.Stop();
-  printf("Total Backward time: %f\n\n", backward_timer.MilliSeconds());
+#ifndef CPU_ONLY
+  if (layer_queues) {
+    amdDevice.set_branch_queues(false);
+    amdDevice.SetActiveQueue(0);
+    amdDevice.JoinQueues(num_layer_queues_);
+  }
+#endif
 }
 
 template <typename Dtype>
@@ -823,6 +1458,8 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::Update() {
+  CHECK(!inference_only_)
+      << "Update is not supported by an inference-only net.";
   // First, accumulate the diffs of any shared parameters into their owner's
   // diff. (Assumes that the learning rate, weight decay, etc. have already been
   // accounted for in the current diff.)
@@ -846,6 +1483,7 @@ void Net<Dtype>::Update() {
       caffe_add(count, this_diff, owner_diff, owner_diff);
       break;
     case Caffe::GPU:
+    case Caffe::APU:
 #ifndef CPU_ONLY
       this_diff = params_[i]->gpu_diff();
       owner_diff = params_[param_owners_[i]]->mutable_gpu_diff();
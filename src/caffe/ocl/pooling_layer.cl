@@ -54,7 +54,7 @@ __kernel void MaxPoolForward(const int nthreads, __global T* bottom_data, const
     top_data[index] = maxval;
     if (mask) {
       mask[index] = maxidx;
-    } else {
+    } else if (top_mask) {
       top_mask[index] = maxidx;
     }
   }
@@ -27,8 +27,10 @@
 template <class T>
 __kernel void ReLUForward(const int count, __global T* in, __global T* out, T negative_slope) {
   int index = get_global_id(0);
-  if(index < count)
-  out[index] = in[index] > 0? in[index]:in[index]*negative_slope;
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
+    out[index] = in[index] > 0? in[index]:in[index]*negative_slope;
+  }
 }
 
 template __attribute__ ((mangled_name(ReLUForward_float))) __kernel void ReLUForward(const int count, __global float* in, __global float* out, float negative_slope);
@@ -37,10 +39,28 @@ template __attribute__ ((mangled_name(ReLUForward_double))) __kernel void ReLUFo
 template <class T>
 __kernel void ReLUBackward(const int count, __global T* in_diff, __global T* in_data,__global T* out_diff,T negative_slope) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out_diff[index] = in_diff[index] * ((in_data[index] > 0) + (in_data[index] <= 0) * negative_slope);
   }
 }
 
 template __attribute__ ((mangled_name(ReLUBackward_float))) __kernel void ReLUBackward(const int count, __global float* in_diff, __global float* in_data, __global float* out_diff, float negative_slope);
 template __attribute__ ((mangled_name(ReLUBackward_double))) __kernel void ReLUBackward(const int count, __global double* in_diff, __global double* in_data, __global double* out_diff, double negative_slope);
+
+template <class T>
+__kernel void BiasReLUForward(const int count, const int channels, const int spatial_dim, __global const T* bias, const int has_bias, __global T* data, const int offset, T negative_slope) {
+  int index = get_global_id(0);
+  int tmp = get_global_size(0);
+  data = data + offset;
+  for(index; index < count; index += tmp) {
+    T value = data[index];
+    if (has_bias) {
+      value += bias[(index / spatial_dim) % channels];
+    }
+    data[index] = value > 0? value:value*negative_slope;
+  }
+}
+
+template __attribute__ ((mangled_name(BiasReLUForward_float))) __kernel void BiasReLUForward(const int count, const int channels, const int spatial_dim, __global const float* bias, const int has_bias, __global float* data, const int offset, float negative_slope);
+template __attribute__ ((mangled_name(BiasReLUForward_double))) __kernel void BiasReLUForward(const int count, const int channels, const int spatial_dim, __global const double* bias, const int has_bias, __global double* data, const int offset, double negative_slope);
@@ -117,7 +117,8 @@ template __attribute__ ((mangled_name(exp_double))) __kernel void exp (const int
 template <class T>
 __kernel void kernel_sub(const int count, __global const T* a, __global const T* b, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = a[index] - b[index];
   }
 }
@@ -128,7 +129,8 @@ template __attribute__ ((mangled_name(kernel_sub_double))) __kernel void kernel_
 template <class T>
 __kernel void kernel_add(const int count, __global const T* a, __global const T* b, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = a[index] + b[index];
   }
 }
@@ -139,7 +141,8 @@ template __attribute__ ((mangled_name(kernel_add_double))) __kernel void kernel_
 template <class T>
 __kernel void kernel_div(const int count, __global const T* a, __global const T* b, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = a[index] / b[index];
   }
 }
@@ -150,7 +153,8 @@ template __attribute__ ((mangled_name(kernel_div_double))) __kernel void kernel_
 template <class T>
 __kernel void kernel_mul(const int count, __global const T* a, __global const T* b, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = a[index] * b[index];
   }
 }
@@ -161,7 +165,8 @@ template __attribute__ ((mangled_name(kernel_mul_double))) __kernel void kernel_
 template <class T>
 __kernel void kernel_powx(const int count, __global const T* data, const T alpha, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = pow(data[index], alpha);
   }
 }
@@ -172,7 +177,8 @@ template __attribute__ ((mangled_name(kernel_powx_double))) __kernel void kernel
 template <class T>
 __kernel void kernel_exp(const int count, __global const T* data, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = exp(data[index]);
   }
 }
@@ -183,7 +189,8 @@ template __attribute__ ((mangled_name(kernel_exp_double))) __kernel void kernel_
 template <class T>
 __kernel void kernel_add_scalar(const int count, const T data, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = out[index] + data;
   }
 }
@@ -194,7 +201,8 @@ template __attribute__ ((mangled_name(kernel_add_scalar_double))) __kernel void
 template <class T>
 __kernel void kernel_log(const int count, __global const T* data, __global T* out) {
   int index = get_global_id(0);
-  if(index < count) {
+  int tmp = get_global_size(0);
+  for(index; index < count; index += tmp) {
     out[index] = log(data[index]);
   }
 }
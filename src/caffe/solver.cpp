@@ -177,12 +177,6 @@ void Solver<Dtype>::Step(int iters) {
             blob->mutable_cpu_diff());
         break;
       case Caffe::GPU:
-#ifndef CPU_ONLY
-        caffe_gpu_set(blob->count(), static_cast<Dtype>(0),
-            blob->mutable_gpu_diff());
-#else
-        NO_GPU;
-#endif
       case Caffe::APU:
 #ifndef CPU_ONLY
         caffe_gpu_set(blob->count(), static_cast<Dtype>(0),
@@ -518,7 +512,8 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
-  case Caffe::GPU: {
+  case Caffe::GPU:
+  case Caffe::APU: {
 #ifndef CPU_ONLY
     caffe_gpu_scal(net_params[param_id]->count(), accum_normalization,
         net_params[param_id]->mutable_gpu_diff());
@@ -562,7 +557,8 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
     }
     break;
   }
-  case Caffe::GPU: {
+  case Caffe::GPU:
+  case Caffe::APU: {
 #ifndef CPU_ONLY
     if (local_decay) {
       if (regularization_type == "L2") {
@@ -607,7 +603,8 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
-  case Caffe::GPU: {
+  case Caffe::GPU:
+  case Caffe::APU: {
 #ifndef CPU_ONLY
     caffe_gpu_axpby(net_params[param_id]->count(), local_rate,
         net_params[param_id]->gpu_diff(), momentum,
@@ -674,7 +671,8 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
-  case Caffe::GPU: {
+  case Caffe::GPU:
+  case Caffe::APU: {
 #ifndef CPU_ONLY
     // save history momentum for stepping back
     caffe_gpu_copy(net_params[param_id]->count(),
@@ -741,7 +739,8 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
         net_params[param_id]->mutable_cpu_diff());
     break;
   }
-  case Caffe::GPU: {
+  case Caffe::GPU:
+  case Caffe::APU: {
 #ifndef CPU_ONLY
     // compute square of gradient in update
     caffe_gpu_powx(net_params[param_id]->count(),
@@ -28,7 +28,9 @@
 
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/trace.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/ocl_buffer_pool.hpp"
 #include "caffe/util/ocl_util.hpp"
 
 #define CL_MEM_USE_PERSISTENT_MEM_AMD (1 << 6)//specific for AMD devices
@@ -37,17 +39,18 @@ namespace caffe {
 
 SyncedMemory::~SyncedMemory() {
 #ifndef CPU_ONLY
-  if (cpu_ptr_ && own_cpu_data_) {
-    OCL_CHECK(
-        clEnqueueUnmapMemObject(amdDevice.CommandQueue, (cl_mem) gpu_cache_ptr_,
-            cpu_ptr_, 0, NULL, NULL));
-    clFinish(amdDevice.CommandQueue);
+  wait_transfer();
+  if (zero_copy_) {
+    // The pool keeps host buffers mapped.
+    zero_copy_to_cpu();
+    gpu_ptr_ = NULL;
   }
   if (gpu_cache_ptr_ && own_cpu_data_) {
-    OCL_CHECK(clReleaseMemObject((cl_mem) gpu_cache_ptr_));
+    amdDevice.buffer_pool().FreeHost((cl_mem) gpu_cache_ptr_, cpu_ptr_);
   }
   if (gpu_ptr_) {
-    OCL_CHECK(clReleaseMemObject((cl_mem) gpu_ptr_));
+    amdDevice.buffer_pool().FreeDevice((cl_mem) gpu_ptr_,
+        mixed_queues_ ? NULL : last_queue_);
   }
 
   clReleaseKernel (oclmem_kernel);
@@ -60,18 +63,123 @@ void SyncedMemory::ocl_setup() {
   cl_int err = 0;
   oclmem_kernel = clCreateKernel(amdDevice.Program, "OCL_memset2", &err);
   OCL_CHECK(err);
+  transfer_event_ = NULL;
+  transfer_other_queue_ = false;
+  zero_copy_ = false;
+  last_queue_ = NULL;
+  mixed_queues_ = false;
+}
+
+void SyncedMemory::wait_transfer() {
+  if (transfer_event_ == NULL) {
+    return;
+  }
+  OCL_CHECK(clWaitForEvents(1, &transfer_event_));
+  OCL_CHECK(clReleaseEvent(transfer_event_));
+  transfer_event_ = NULL;
+  transfer_other_queue_ = false;
+}
+
+void SyncedMemory::order_gpu_after_transfer() {
+  if (!transfer_other_queue_) {
+    return;
+  }
+  OCL_CHECK(
+      clEnqueueBarrierWithWaitList(amdDevice.CommandQueue, 1,
+          &transfer_event_, NULL));
+  transfer_other_queue_ = false;
+}
+
+void SyncedMemory::set_transfer(cl_event event, bool other_queue) {
+  // A new copy reads or writes the buffers of the previous one.
+  wait_transfer();
+  transfer_event_ = event;
+  transfer_other_queue_ = other_queue;
+}
+
+void SyncedMemory::note_gpu_use(cl_command_queue queue) {
+  if (last_queue_ != NULL && last_queue_ != queue) {
+    mixed_queues_ = true;
+  }
+  last_queue_ = queue;
+}
+
+cl_event SyncedMemory::gpu_last_use() {
+  if (mixed_queues_) {
+    return amdDevice.MarkAllQueues();
+  }
+  if (last_queue_ == NULL) {
+    return NULL;
+  }
+  cl_event event = NULL;
+  OCL_CHECK(clEnqueueMarkerWithWaitList(last_queue_, 0, NULL, &event));
+  OCL_CHECK(clFlush(last_queue_));
+  return event;
+}
+
+void SyncedMemory::zero_copy_to_cpu() {
+  if (head_ == UNINITIALIZED) {
+    gpu_cache_ptr_ = amdDevice.buffer_pool().AllocateHost(size_, &cpu_ptr_);
+    memset(cpu_ptr_, 0, size_);
+    own_cpu_data_ = true;
+    head_ = HEAD_AT_CPU;
+  } else if (cpu_ptr_ == NULL) {
+    // Maps the whole buffer, as the pool hands it out mapped. The map runs
+    // on the helper queue, as prefetch threads get here too, and waits for
+    // the kernels using the buffer.
+    size_t capacity = 0;
+    OCL_CHECK(
+        clGetMemObjectInfo((cl_mem) gpu_cache_ptr_, CL_MEM_SIZE,
+            sizeof(capacity), &capacity, NULL));
+    cl_event last_use = gpu_last_use();
+    cl_int err = CL_SUCCESS;
+    cpu_ptr_ = clEnqueueMapBuffer(amdDevice.CommandQueue_helper,
+        (cl_mem) gpu_cache_ptr_, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0,
+        capacity, last_use ? 1 : 0, last_use ? &last_use : NULL, NULL, &err);
+    OCL_CHECK(err);
+    if (last_use) {
+      OCL_CHECK(clReleaseEvent(last_use));
+    }
+    head_ = SYNCED;
+  }
+}
+
+void SyncedMemory::zero_copy_to_gpu() {
+  if (head_ == UNINITIALIZED) {
+    zero_copy_to_cpu();
+  }
+  if (cpu_ptr_ != NULL) {
+    // Kernels ordered after the unmap see the host writes; gpu_data()
+    // orders CommandQueue after it.
+    cl_event event = NULL;
+    OCL_CHECK(
+        clEnqueueUnmapMemObject(amdDevice.CommandQueue_helper,
+            (cl_mem) gpu_cache_ptr_, cpu_ptr_, 0, NULL, &event));
+    OCL_CHECK(clFlush(amdDevice.CommandQueue_helper));
+    set_transfer(event, true);
+    cpu_ptr_ = NULL;
+  }
+  gpu_ptr_ = gpu_cache_ptr_;
+  if (head_ == HEAD_AT_CPU) {
+    head_ = SYNCED;
+  }
 }
 #endif
 
 inline void SyncedMemory::to_cpu() {
+#ifndef CPU_ONLY
+  if (head_ == UNINITIALIZED && Caffe::mode() == Caffe::APU) {
+    zero_copy_ = true;
+  }
+  if (zero_copy_) {
+    zero_copy_to_cpu();
+    return;
+  }
+#endif
   switch (head_) {
   case UNINITIALIZED:
 #ifndef CPU_ONLY
-    gpu_cache_ptr_ = clCreateBuffer(amdDevice.Context, CL_MEM_ALLOC_HOST_PTR,
-        size_, NULL, NULL);
-    cpu_ptr_ = clEnqueueMapBuffer(amdDevice.CommandQueue,
-        (cl_mem) gpu_cache_ptr_, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size_,
-        0, NULL, NULL, NULL);
+    gpu_cache_ptr_ = amdDevice.buffer_pool().AllocateHost(size_, &cpu_ptr_);
 #else
     CaffeMallocHost(&cpu_ptr_, size_);
 #endif
@@ -82,17 +190,26 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU: {
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
-      gpu_cache_ptr_ = clCreateBuffer(amdDevice.Context, CL_MEM_ALLOC_HOST_PTR,
-          size_, NULL, NULL);
-      cpu_ptr_ = clEnqueueMapBuffer(amdDevice.CommandQueue,
-          (cl_mem) gpu_cache_ptr_, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0,
-          size_, 0, NULL, NULL, NULL);
+      gpu_cache_ptr_ = amdDevice.buffer_pool().AllocateHost(size_, &cpu_ptr_);
       own_cpu_data_ = true;
     }
-    OCL_CHECK(
-        clEnqueueCopyBuffer(amdDevice.CommandQueue, (cl_mem) gpu_ptr_,
-            (cl_mem) gpu_cache_ptr_, 0, 0, size_, 0, NULL, NULL));
-    clFinish(amdDevice.CommandQueue);
+    TraceScope trace("to_cpu", "transfer");
+    note_gpu_use(amdDevice.CommandQueue);
+    cl_event event = NULL;
+    if (gpu_cache_ptr_ == NULL) {
+      // External host memory from set_cpu_data.
+      OCL_CHECK(
+          clEnqueueReadBuffer(amdDevice.CommandQueue, (cl_mem) gpu_ptr_,
+              CL_TRUE, 0, size_, cpu_ptr_, 0, NULL, &event));
+    } else {
+      OCL_CHECK(
+          clEnqueueCopyBuffer(amdDevice.CommandQueue, (cl_mem) gpu_ptr_,
+              (cl_mem) gpu_cache_ptr_, 0, 0, size_, 0, NULL, &event));
+    }
+    Tracer::Get().AddDeviceEvent("to_cpu", "transfer", event);
+    // The host reads the copy right away.
+    set_transfer(event, false);
+    wait_transfer();
     head_ = SYNCED;
 #else
     NO_GPU;
@@ -107,32 +224,47 @@ inline void SyncedMemory::to_cpu() {
 
 inline void SyncedMemory::to_gpu() {
 #ifndef CPU_ONLY
+  if (head_ == UNINITIALIZED && Caffe::mode() == Caffe::APU) {
+    zero_copy_ = true;
+  }
+  if (zero_copy_) {
+    zero_copy_to_gpu();
+    return;
+  }
   switch (head_) {
   case UNINITIALIZED: {
-    cl_mem tmpMem = clCreateBuffer(amdDevice.Context, CL_MEM_READ_WRITE, size_,
-        NULL, NULL);
-    if (NULL == tmpMem) {
-      fprintf(stderr, "Failed to create memory object\n");
-      break;
-    }
-    ocl_memset(tmpMem, (int) 0, (int) (size_ / sizeof(int)));
+    cl_mem tmpMem = amdDevice.buffer_pool().AllocateDevice(size_,
+        amdDevice.CommandQueue);
+    // Pooled buffers hold stale data, so every byte is cleared, sizes that
+    // aren't a multiple of 4 included.
+    const cl_uchar zero = 0;
+    OCL_CHECK(
+        clEnqueueFillBuffer(amdDevice.CommandQueue, tmpMem, &zero,
+            sizeof(zero), 0, size_, 0, NULL, NULL));
     gpu_ptr_ = (void*) tmpMem;
     head_ = HEAD_AT_GPU;
     break;
   }
   case HEAD_AT_CPU: {
     if (gpu_ptr_ == NULL) {
-      cl_mem tmpMem = clCreateBuffer(amdDevice.Context, CL_MEM_READ_WRITE,
-          size_, NULL, NULL);
-      if (NULL == tmpMem) {
-        fprintf(stderr, "Failed to create memory object\n");
-      }
-      gpu_ptr_ = (void*) tmpMem;
+      gpu_ptr_ = (void*) amdDevice.buffer_pool().AllocateDevice(size_,
+          amdDevice.CommandQueue);
     }
-    OCL_CHECK(
-        clEnqueueCopyBuffer(amdDevice.CommandQueue, (cl_mem) gpu_cache_ptr_,
-            (cl_mem) gpu_ptr_, 0, 0, size_, 0, NULL, NULL));
-    clFinish(amdDevice.CommandQueue);
+    cl_event event = NULL;
+    if (gpu_cache_ptr_ == NULL) {
+      // External host memory from set_cpu_data, which its owner may write
+      // as soon as this returns.
+      OCL_CHECK(
+          clEnqueueWriteBuffer(amdDevice.CommandQueue, (cl_mem) gpu_ptr_,
+              CL_TRUE, 0, size_, cpu_ptr_, 0, NULL, &event));
+    } else {
+      OCL_CHECK(
+          clEnqueueCopyBuffer(amdDevice.CommandQueue, (cl_mem) gpu_cache_ptr_,
+              (cl_mem) gpu_ptr_, 0, 0, size_, 0, NULL, &event));
+    }
+    Tracer::Get().AddDeviceEvent("to_gpu", "transfer", event);
+    // Kernels on CommandQueue run after the copy; only host writes wait.
+    set_transfer(event, false);
     head_ = SYNCED;
     break;
   }
@@ -152,9 +284,24 @@ const void* SyncedMemory::cpu_data() {
 
 void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
+#ifndef CPU_ONLY
+  wait_transfer();
+  if (zero_copy_) {
+    // External host memory can't back the shared buffer: it is dropped,
+    // and a device buffer of its own is filled from data on demand.
+    zero_copy_to_cpu();
+    gpu_ptr_ = NULL;
+    zero_copy_ = false;
+  }
+  if (own_cpu_data_ && gpu_cache_ptr_) {
+    amdDevice.buffer_pool().FreeHost((cl_mem) gpu_cache_ptr_, cpu_ptr_);
+  }
+  gpu_cache_ptr_ = NULL;
+#else
   if (own_cpu_data_) {
     CaffeFreeHost (cpu_ptr_);
   }
+#endif
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
@@ -163,6 +310,8 @@ void SyncedMemory::set_cpu_data(void* data) {
 const void* SyncedMemory::gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
+  order_gpu_after_transfer();
+  note_gpu_use(amdDevice.CommandQueue);
   return (const void*) gpu_ptr_;
 #else
   NO_GPU;
@@ -171,6 +320,10 @@ const void* SyncedMemory::gpu_data() {
 
 void* SyncedMemory::mutable_cpu_data() {
   to_cpu();
+#ifndef CPU_ONLY
+  // A pending upload may still be reading the host buffer.
+  wait_transfer();
+#endif
   head_ = HEAD_AT_CPU;
   return cpu_ptr_;
 }
@@ -178,6 +331,8 @@ void* SyncedMemory::mutable_cpu_data() {
 void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
+  order_gpu_after_transfer();
+  note_gpu_use(amdDevice.CommandQueue);
   head_ = HEAD_AT_GPU;
   return gpu_ptr_;
 #else
@@ -185,6 +340,37 @@ void* SyncedMemory::mutable_gpu_data() {
 #endif
 }
 
+#ifndef CPU_ONLY
+void SyncedMemory::async_gpu_push() {
+  CHECK(head_ == HEAD_AT_CPU);
+  if (zero_copy_) {
+    to_gpu();
+    return;
+  }
+  if (gpu_ptr_ == NULL) {
+    gpu_ptr_ = (void*) amdDevice.buffer_pool().AllocateDevice(size_,
+        amdDevice.CommandQueue_helper);
+  }
+  note_gpu_use(amdDevice.CommandQueue_helper);
+  cl_event event = NULL;
+  if (gpu_cache_ptr_ == NULL) {
+    // External host memory from set_cpu_data, see to_gpu.
+    OCL_CHECK(
+        clEnqueueWriteBuffer(amdDevice.CommandQueue_helper,
+            (cl_mem) gpu_ptr_, CL_TRUE, 0, size_, cpu_ptr_, 0, NULL, &event));
+  } else {
+    OCL_CHECK(
+        clEnqueueCopyBuffer(amdDevice.CommandQueue_helper,
+            (cl_mem) gpu_cache_ptr_, (cl_mem) gpu_ptr_, 0, 0, size_, 0,
+            NULL, &event));
+  }
+  OCL_CHECK(clFlush(amdDevice.CommandQueue_helper));
+  Tracer::Get().AddDeviceEvent("async_gpu_push", "transfer", event);
+  set_transfer(event, true);
+  head_ = SYNCED;
+}
+#endif
+
 const void *SyncedMemory::gpu_cache_data() {
   return 0;
 }
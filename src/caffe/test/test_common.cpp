@@ -1,9 +1,13 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 #include <cstring>
 
 #include "gtest/gtest.h"
 
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -45,6 +49,74 @@ TEST_F(CommonTest, TestRandSeedCPU) {
   }
 }
 
+#ifndef CPU_ONLY
+static void GetKernelInThread(const KernelHandle* handle, cl_kernel* kernel) {
+  *kernel = handle->get();
+}
+
+TEST_F(CommonTest, TestKernelHandleGPU) {
+  Caffe::set_mode(Caffe::GPU);
+  TypedKernelHandle<float> handle("kernel_mul");
+  TypedKernelHandle<float> same_handle("kernel_mul");
+  TypedKernelHandle<double> double_handle("kernel_mul");
+  cl_kernel kernel = handle.get();
+  ASSERT_TRUE(kernel != NULL);
+  // The kernel is created once per thread and name.
+  EXPECT_EQ(kernel, handle.get());
+  EXPECT_EQ(kernel, same_handle.get());
+  EXPECT_NE(kernel, double_handle.get());
+  // Other threads get their own instance.
+  cl_kernel thread_kernel = NULL;
+  boost::thread thread(boost::bind(&GetKernelInThread, &handle,
+      &thread_kernel));
+  thread.join();
+  EXPECT_TRUE(thread_kernel != NULL);
+  EXPECT_NE(kernel, thread_kernel);
+}
+
+TEST_F(CommonTest, TestLaunchProfileGPU) {
+  Caffe::set_mode(Caffe::GPU);
+  const std::string kernel_name = "kernel_add_float";
+  const LaunchConfig* config = amdDevice.GetLaunchConfig(
+      amdDevice.RegisterKernel(kernel_name));
+  const LaunchConfig default_config = *config;
+  LaunchConfig tuned;
+  tuned.local_size = 64;
+  tuned.items_per_thread = 4;
+  amdDevice.SetLaunchConfig(kernel_name, tuned);
+  EXPECT_EQ(64, config->local_size);
+  EXPECT_EQ(4, config->items_per_thread);
+  // A count that is not a multiple of the launch shape.
+  const int count = 1001;
+  SyncedMemory a(count * sizeof(float));
+  SyncedMemory b(count * sizeof(float));
+  SyncedMemory out(count * sizeof(float));
+  float* a_data = static_cast<float*>(a.mutable_cpu_data());
+  float* b_data = static_cast<float*>(b.mutable_cpu_data());
+  for (int i = 0; i < count; ++i) {
+    a_data[i] = i;
+    b_data[i] = 2 * i;
+  }
+  kernel_add<float>(count, static_cast<const float*>(a.gpu_data()),
+      static_cast<const float*>(b.gpu_data()),
+      static_cast<float*>(out.mutable_gpu_data()));
+  const float* out_data = static_cast<const float*>(out.cpu_data());
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(3 * i, out_data[i]);
+  }
+  // The profile survives a save and load.
+  string profile_file;
+  MakeTempFilename(&profile_file);
+  ASSERT_TRUE(amdDevice.SaveLaunchProfile(profile_file));
+  amdDevice.SetLaunchConfig(kernel_name, default_config);
+  EXPECT_EQ(default_config.local_size, config->local_size);
+  ASSERT_TRUE(amdDevice.LoadLaunchProfile(profile_file));
+  EXPECT_EQ(64, config->local_size);
+  EXPECT_EQ(4, config->items_per_thread);
+  amdDevice.SetLaunchConfig(kernel_name, default_config);
+}
+#endif
+
 #ifndef CPU_ONLY  // GPU Caffe singleton test.
 /*
 TEST_F(CommonTest, TestRandSeedGPU) {
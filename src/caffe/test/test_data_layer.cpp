@@ -66,7 +66,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     db->Close();
   }
 
-  void TestRead() {
+  void TestRead(const int prefetch = 4) {
     const Dtype scale = 3;
     LayerParameter param;
     param.set_phase(TRAIN);
@@ -74,6 +74,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_prefetch(prefetch);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -102,6 +103,10 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
         }
       }
     }
+    const PrefetchStats& stats = layer.prefetch_stats();
+    EXPECT_EQ(100, stats.batches);
+    EXPECT_LE(stats.empty_waits, stats.batches);
+    EXPECT_LE(stats.mean_depth(), prefetch);
   }
 
   void TestReshape(DataParameter_DB backend) {
@@ -223,13 +228,14 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
-  void TestReadCropTrainSequenceSeeded() {
+  void TestReadCropTrainSequenceSeeded(const int transform_threads = 1) {
     LayerParameter param;
     param.set_phase(TRAIN);
     DataParameter* data_param = param.mutable_data_param();
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -276,6 +282,12 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
         }
       }
     }
+    // The prefetch thread may be loading more batches meanwhile.
+    const DataLoadStats stats = layer2.load_stats();
+    EXPECT_GE(stats.batches, 2);
+    EXPECT_GE(stats.transform_ms, 0);
+    EXPECT_EQ(transform_threads > 1 ? transform_threads : 0,
+        static_cast<int>(stats.worker_transform_ms.size()));
   }
 
   void TestReadCropTrainSequenceUnseeded() {
@@ -354,6 +366,12 @@ TYPED_TEST(DataLayerTest, TestReadLevelDB) {
   this->TestRead();
 }
 
+TYPED_TEST(DataLayerTest, TestReadSinglePrefetchLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestRead(1);
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
@@ -372,6 +390,13 @@ TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededLevelDB) {
   this->TestReadCropTrainSequenceSeeded();
 }
 
+// Same as above with several transform threads, each with its own RNG.
+TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededThreadedLevelDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadCropTrainSequenceSeeded(3);
+}
+
 // Test that the sequence of random crops differs across iterations when
 // Caffe::set_random_seed isn't called (and seeds from srand are ignored).
 TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceUnseededLevelDB) {
@@ -0,0 +1,83 @@
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DatumViewTest : public ::testing::Test {
+  protected:
+    // A 3x4x5 Datum of raw uint8 pixels.
+    static Datum MakeDatum(const int label) {
+      Datum datum;
+      datum.set_channels(3);
+      datum.set_height(4);
+      datum.set_width(5);
+      datum.set_label(label);
+      for (int i = 0; i < 3 * 4 * 5; ++i) {
+        datum.mutable_data()->push_back(static_cast<char>(i * 7));
+      }
+      return datum;
+    }
+};
+
+TEST_F(DatumViewTest, TestParse) {
+  const Datum datum = MakeDatum(-3);
+  string buffer;
+  CHECK(datum.SerializeToString(&buffer));
+  DatumView view;
+  ASSERT_TRUE(view.Parse(buffer.data(), buffer.size()));
+  EXPECT_EQ(3, view.channels);
+  EXPECT_EQ(4, view.height);
+  EXPECT_EQ(5, view.width);
+  EXPECT_EQ(-3, view.label);
+  EXPECT_FALSE(view.encoded);
+  // The pixels are left in the buffer.
+  EXPECT_GE(view.data, buffer.data());
+  EXPECT_LE(view.data + view.data_size, buffer.data() + buffer.size());
+  EXPECT_EQ(datum.data(), string(view.data, view.data_size));
+  EXPECT_TRUE(view.float_data == NULL);
+}
+
+TEST_F(DatumViewTest, TestParseFallsBack) {
+  Datum datum = MakeDatum(1);
+  datum.clear_data();
+  datum.add_float_data(0.5);
+  string buffer;
+  CHECK(datum.SerializeToString(&buffer));
+  DatumView view;
+  EXPECT_FALSE(view.Parse(buffer.data(), buffer.size()));
+  // Truncated records are rejected too.
+  CHECK(MakeDatum(1).SerializeToString(&buffer));
+  EXPECT_FALSE(view.Parse(buffer.data(), buffer.size() - 1));
+}
+
+TEST_F(DatumViewTest, TestTransform) {
+  const Datum datum = MakeDatum(0);
+  string buffer;
+  CHECK(datum.SerializeToString(&buffer));
+  DatumView view;
+  ASSERT_TRUE(view.Parse(buffer.data(), buffer.size()));
+  TransformationParameter param;
+  param.set_scale(0.5);
+  param.add_mean_value(10);
+  DataTransformer<float> transformer(param, TEST);
+  EXPECT_EQ(transformer.InferBlobShape(datum),
+      transformer.InferBlobShape(view));
+  Blob<float> expected(1, 3, 4, 5);
+  Blob<float> actual(1, 3, 4, 5);
+  transformer.Transform(datum, &expected);
+  transformer.Transform(view, &actual);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], actual.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
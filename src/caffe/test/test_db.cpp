@@ -1,3 +1,4 @@
+#include <cstdio>
 #include <string>
 
 #include "boost/scoped_ptr.hpp"
@@ -6,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/db_packed.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -56,8 +58,13 @@ struct TypeLMDB {
 };
 DataParameter_DB TypeLMDB::backend = DataParameter_DB_LMDB;
 
+struct TypePacked {
+  static DataParameter_DB backend;
+};
+DataParameter_DB TypePacked::backend = DataParameter_DB_PACKED;
+
 // typedef ::testing::Types<TypeLmdb> TestTypes;
-typedef ::testing::Types<TypeLevelDB, TypeLMDB> TestTypes;
+typedef ::testing::Types<TypeLevelDB, TypeLMDB, TypePacked> TestTypes;
 
 TYPED_TEST_CASE(DBTest, TestTypes);
 
@@ -116,6 +123,21 @@ TYPED_TEST(DBTest, TestKeyValue) {
   EXPECT_FALSE(cursor->valid());
 }
 
+TYPED_TEST(DBTest, TestValueView) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  for (; cursor->valid(); cursor->Next()) {
+    const char* data;
+    size_t size;
+    cursor->value_view(&data, &size);
+    EXPECT_EQ(cursor->value(), string(data, size));
+    Datum datum;
+    EXPECT_TRUE(datum.ParseFromArray(data, size));
+    EXPECT_EQ(datum.channels(), 3);
+  }
+}
+
 TYPED_TEST(DBTest, TestWrite) {
   scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
   db->Open(this->source_, db::WRITE);
@@ -131,4 +153,43 @@ TYPED_TEST(DBTest, TestWrite) {
   txn->Commit();
 }
 
+class PackedDBTest : public ::testing::Test {};
+
+static string PackedKey(const int i) {
+  char key[16];
+  snprintf(key, sizeof(key), "%08d", i);
+  return key;
+}
+
+TEST_F(PackedDBTest, TestAppendAndSeek) {
+  string source;
+  MakeTempDir(&source);
+  source += "/db";
+  // Values of every size modulo the record alignment, over two sessions.
+  for (int session = 0; session < 2; ++session) {
+    db::PackedDB db;
+    db.Open(source, session == 0 ? db::NEW : db::WRITE);
+    scoped_ptr<db::Transaction> txn(db.NewTransaction());
+    for (int i = session * 10; i < (session + 1) * 10; ++i) {
+      txn->Put(PackedKey(i), string(i, 'a' + i));
+    }
+    txn->Commit();
+    EXPECT_EQ((session + 1) * 10, db.size());
+  }
+  db::PackedDB db;
+  db.Open(source, db::READ);
+  EXPECT_EQ(20, db.size());
+  scoped_ptr<db::PackedCursor> cursor(db.NewCursor());
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(cursor->valid());
+    EXPECT_EQ(PackedKey(i), cursor->key());
+    EXPECT_EQ(string(i, 'a' + i), cursor->value());
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->valid());
+  cursor->Seek(13);
+  EXPECT_EQ(PackedKey(13), cursor->key());
+  EXPECT_EQ(string(13, 'a' + 13), cursor->value());
+}
+
 }  // namespace caffe
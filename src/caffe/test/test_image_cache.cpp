@@ -0,0 +1,147 @@
+#include <opencv2/core/core.hpp>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/image_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ImageCacheTest : public ::testing::Test {
+  protected:
+    // A 10x10 3-channel image of 300 bytes, filled with value.
+    static cv::Mat MakeImage(const int value) {
+      return cv::Mat(10, 10, CV_8UC3, cv::Scalar(value, value + 1, value + 2));
+    }
+
+    // Keys of the same size, so records are too.
+    static std::string Key(const int i) {
+      char key[8];
+      snprintf(key, sizeof(key), "%02d", i);
+      return key;
+    }
+
+    static void ExpectImage(const int value, const cv::Mat& image) {
+      ASSERT_EQ(10, image.rows);
+      ASSERT_EQ(10, image.cols);
+      ASSERT_EQ(CV_8UC3, image.type());
+      EXPECT_EQ(0, cv::norm(image, MakeImage(value), cv::NORM_INF));
+    }
+};
+
+TEST_F(ImageCacheTest, TestLRU) {
+  ImageCache cache(1000, ImageCache::LRU);
+  cv::Mat image;
+  EXPECT_FALSE(cache.Get("a", &image));
+  cache.Put("a", MakeImage(1));
+  cache.Put("b", MakeImage(2));
+  cache.Put("c", MakeImage(3));
+  EXPECT_EQ(3, cache.stats().images_cached);
+  EXPECT_EQ(900, cache.stats().bytes_cached);
+  // Using a makes b the least recently used.
+  EXPECT_TRUE(cache.Get("a", &image));
+  ExpectImage(1, image);
+  cache.Put("d", MakeImage(4));
+  EXPECT_EQ(3, cache.stats().images_cached);
+  EXPECT_FALSE(cache.Get("b", &image));
+  EXPECT_TRUE(cache.Get("c", &image));
+  ExpectImage(3, image);
+  EXPECT_TRUE(cache.Get("d", &image));
+  ExpectImage(4, image);
+  EXPECT_EQ(3, cache.stats().hits);
+  EXPECT_EQ(0, cache.stats().disk_hits);
+  EXPECT_EQ(2, cache.stats().misses);
+  EXPECT_DOUBLE_EQ(0.6, cache.stats().hit_rate());
+}
+
+TEST_F(ImageCacheTest, TestFill) {
+  ImageCache cache(1000, ImageCache::FILL);
+  cv::Mat image;
+  // Cycling through more than fits keeps serving the first images.
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    for (int i = 0; i < 4; ++i) {
+      const std::string key(1, 'a' + i);
+      if (!cache.Get(key, &image)) {
+        cache.Put(key, MakeImage(i));
+      }
+    }
+  }
+  EXPECT_EQ(3, cache.stats().images_cached);
+  EXPECT_EQ(3, cache.stats().hits);
+  EXPECT_EQ(5, cache.stats().misses);
+  EXPECT_TRUE(cache.Get("a", &image));
+  ExpectImage(0, image);
+  EXPECT_FALSE(cache.Get("d", &image));
+}
+
+TEST_F(ImageCacheTest, TestTooLarge) {
+  ImageCache cache(200, ImageCache::LRU);
+  cv::Mat image;
+  cache.Put("a", MakeImage(1));
+  EXPECT_EQ(0, cache.stats().images_cached);
+  EXPECT_FALSE(cache.Get("a", &image));
+}
+
+TEST_F(ImageCacheTest, TestDisk) {
+  string file_name;
+  MakeTempFilename(&file_name);
+  {
+    ImageCache cache(0, ImageCache::LRU, file_name);
+    for (int i = 0; i < 50; ++i) {
+      cache.Put(Key(i), MakeImage(i));
+    }
+    cv::Mat image;
+    EXPECT_TRUE(cache.Get(Key(7), &image));
+    ExpectImage(7, image);
+    EXPECT_EQ(1, cache.stats().disk_hits);
+    EXPECT_EQ(0, cache.stats().images_cached);
+  }
+  // Reopened, with the last record cut short. A record is the key size,
+  // the key, the image header and the pixels.
+  const int record_size = 4 + 2 + 12 + 300;
+  CHECK_EQ(0, truncate(file_name.c_str(), 50 * record_size - 100));
+  cv::Mat image;
+  {
+    ImageCache cache(1000, ImageCache::LRU, file_name);
+    for (int i = 0; i < 49; ++i) {
+      EXPECT_TRUE(cache.Get(Key(i), &image));
+      ExpectImage(i, image);
+    }
+    EXPECT_FALSE(cache.Get(Key(49), &image));
+    EXPECT_EQ(49, cache.stats().disk_hits);
+    // Disk hits are promoted to memory.
+    EXPECT_TRUE(cache.Get(Key(48), &image));
+    EXPECT_EQ(1, cache.stats().hits);
+    cache.Put(Key(49), MakeImage(49));
+    cache.Put(Key(50), MakeImage(50));
+  }
+  ImageCache reopened(0, ImageCache::LRU, file_name);
+  EXPECT_TRUE(reopened.Get(Key(50), &image));
+  ExpectImage(50, image);
+}
+
+TEST_F(ImageCacheTest, TestDiskInUse) {
+  string file_name;
+  MakeTempFilename(&file_name);
+  ImageCache cache(0, ImageCache::LRU, file_name);
+  EXPECT_TRUE(cache.disk_enabled());
+  cache.Put(Key(1), MakeImage(1));
+  // A second cache on the file neither reads nor writes it.
+  ImageCache other(0, ImageCache::LRU, file_name);
+  EXPECT_FALSE(other.disk_enabled());
+  cv::Mat image;
+  EXPECT_FALSE(other.Get(Key(1), &image));
+  other.Put(Key(2), MakeImage(2));
+  EXPECT_TRUE(cache.Get(Key(1), &image));
+  ExpectImage(1, image);
+  EXPECT_FALSE(cache.Get(Key(2), &image));
+}
+
+}  // namespace caffe
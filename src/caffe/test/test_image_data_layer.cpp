@@ -176,4 +176,36 @@ TYPED_TEST(ImageDataLayerTest, TestShuffle) {
   }
 }
 
+TYPED_TEST(ImageDataLayerTest, TestReadCached) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(2);
+  image_data_param->set_source(this->filename_reshape_.c_str());
+  image_data_param->set_new_height(64);
+  image_data_param->set_new_width(64);
+  image_data_param->set_shuffle(false);
+  ImageDataLayer<Dtype> reference_layer(param);
+  reference_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  reference_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> reference;
+  reference.CopyFrom(*this->blob_top_data_, false, true);
+  // Memory holds one of the two images, the file both.
+  string cache_file;
+  MakeTempFilename(&cache_file);
+  image_data_param->set_cache_size(64 * 64 * 3);
+  image_data_param->set_cache_file(cache_file);
+  for (int run = 0; run < 2; ++run) {
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_TRUE(layer.image_cache() != NULL);
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < reference.count(); ++i) {
+        EXPECT_EQ(reference.cpu_data()[i], this->blob_top_data_->cpu_data()[i]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
@@ -210,6 +210,25 @@ TEST_F(IOTest, TestReadImageToCVMatResizedSquare) {
   EXPECT_EQ(cv_img.cols, 256);
 }
 
+TEST_F(IOTest, TestReadImageToCVMatReduced) {
+  // cat.jpg is 360x480, so it is decoded at a quarter of its size.
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  cv::Mat cv_img = ReadImageToCVMat(filename, 64, 64);
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_EQ(cv_img.rows, 64);
+  EXPECT_EQ(cv_img.cols, 64);
+  cv::Mat cv_img_ref;
+  cv::resize(cv::imread(filename, CV_LOAD_IMAGE_COLOR), cv_img_ref,
+      cv::Size(64, 64), 0, 0, cv::INTER_AREA);
+  // DCT scaling filters differently, but not by much.
+  cv::Mat diff;
+  cv::absdiff(cv_img, cv_img_ref, diff);
+  const cv::Scalar mean_diff = cv::mean(diff);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_LT(mean_diff[c], 8);
+  }
+}
+
 TEST_F(IOTest, TestReadImageToCVMatGray) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   const bool is_color = false;
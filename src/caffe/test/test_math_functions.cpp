@@ -150,6 +150,68 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestThreadedElementwise) {
+  const int n = this->blob_bottom_->count();
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  const TypeParam* b = this->blob_top_->cpu_data();
+  vector<TypeParam> serial(n);
+  caffe_mul<TypeParam>(n, a, b, &serial[0]);
+  caffe_cpu_axpby<TypeParam>(n, TypeParam(0.5), a, TypeParam(2), &serial[0]);
+  const TypeParam serial_dot = caffe_cpu_dot<TypeParam>(n, a, b);
+  const TypeParam serial_asum = caffe_cpu_asum<TypeParam>(n, a);
+  // Split the arrays in chunks of at least 1000 elements over 4 threads.
+  Caffe::set_cpu_threads(4);
+  Caffe::set_cpu_grain(1000);
+  vector<TypeParam> threaded(n);
+  caffe_mul<TypeParam>(n, a, b, &threaded[0]);
+  caffe_cpu_axpby<TypeParam>(n, TypeParam(0.5), a, TypeParam(2),
+      &threaded[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(serial[i], threaded[i]);
+  }
+  EXPECT_NEAR(serial_dot, caffe_cpu_dot<TypeParam>(n, a, b),
+      1e-4 * std::fabs(serial_dot));
+  EXPECT_NEAR(serial_asum, caffe_cpu_asum<TypeParam>(n, a),
+      1e-4 * serial_asum);
+  caffe_set<TypeParam>(n, TypeParam(3), &threaded[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(TypeParam(3), threaded[i]);
+  }
+  Caffe::set_cpu_threads(1);
+  Caffe::set_cpu_grain(32768);
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestThreadedFewElements) {
+  // With a grain of 1, rounding up the chunk size leaves fewer chunks than
+  // threads for most of these sizes.
+  Caffe::set_cpu_threads(4);
+  Caffe::set_cpu_grain(1);
+  const TypeParam* a = this->blob_bottom_->cpu_data();
+  for (int n = 2; n <= 9; ++n) {
+    TypeParam serial_asum = 0;
+    for (int i = 0; i < n; ++i) {
+      serial_asum += std::fabs(a[i]);
+    }
+    // Elements past n must be left alone.
+    vector<TypeParam> y(n + 4, TypeParam(7));
+    caffe_set<TypeParam>(n, TypeParam(0), &y[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(TypeParam(0), y[i]);
+    }
+    caffe_copy<TypeParam>(n, a, &y[0]);
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(a[i], y[i]);
+    }
+    for (int i = n; i < n + 4; ++i) {
+      EXPECT_EQ(TypeParam(7), y[i]);
+    }
+    EXPECT_NEAR(serial_asum, caffe_cpu_asum<TypeParam>(n, a),
+        1e-4 * serial_asum);
+  }
+  Caffe::set_cpu_threads(1);
+  Caffe::set_cpu_grain(32768);
+}
+
 #ifndef CPU_ONLY
 
 template <typename Dtype>
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,7 +11,9 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/vision_layers.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -29,6 +33,46 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     net_.reset(new Net<Dtype>(param));
   }
 
+  // Runs the nets of both protos on the same Gaussian input, from the same
+  // seed and with a top diff of ones, and expects their output data and
+  // input diffs to agree within error_margin.
+  void ExpectSameNetResults(const string& proto0, const string& proto1,
+      const Dtype error_margin) {
+    FillerParameter filler_param;
+    filler_param.set_std(1);
+    GaussianFiller<Dtype> filler(filler_param);
+    Blob<Dtype> input;
+    Blob<Dtype> outputs[2];
+    Blob<Dtype> input_diffs[2];
+    for (int config = 0; config < 2; ++config) {
+      Caffe::set_random_seed(seed_);
+      InitNetFromProtoString(config == 0 ? proto0 : proto1);
+      Blob<Dtype>* input_blob = net_->input_blobs()[0];
+      if (config == 0) {
+        input.ReshapeLike(*input_blob);
+        filler.Fill(&input);
+      }
+      caffe_copy(input.count(), input.cpu_data(),
+          input_blob->mutable_cpu_data());
+      net_->ForwardPrefilled();
+      Blob<Dtype>* output_blob = net_->output_blobs()[0];
+      caffe_set(output_blob->count(), Dtype(1),
+          output_blob->mutable_cpu_diff());
+      net_->Backward();
+      outputs[config].CopyFrom(*output_blob, false, true);
+      input_diffs[config].CopyFrom(*input_blob, true, true);
+    }
+    ASSERT_EQ(outputs[0].count(), outputs[1].count());
+    for (int i = 0; i < outputs[0].count(); ++i) {
+      EXPECT_NEAR(outputs[0].cpu_data()[i], outputs[1].cpu_data()[i],
+          error_margin);
+    }
+    for (int i = 0; i < input_diffs[0].count(); ++i) {
+      EXPECT_NEAR(input_diffs[0].cpu_diff()[i], input_diffs[1].cpu_diff()[i],
+          error_margin);
+    }
+  }
+
   virtual void CopyNetBlobs(const bool copy_diff,
       vector<shared_ptr<Blob<Dtype> > >* blobs_copy) {
     CHECK(net_);
@@ -552,8 +596,8 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
-  virtual void InitReshapableNet() {
-    const string& proto =
+  virtual void InitReshapableNet(const bool memory_optimize = false) {
+    string proto =
         "name: 'ReshapableNetwork' "
         "input: 'data' "
         "input_dim: 1 "
@@ -611,6 +655,271 @@ class NetTest : public MultiDeviceTest<TypeParam> {
         "  bottom: 'norm1' "
         "  top: 'softmax' "
         "} ";
+    if (memory_optimize) {
+      proto += "memory_optimize: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  virtual string BranchyNetProto(const bool concurrent_branches) {
+    string proto =
+        "name: 'BranchyNetwork' "
+        "force_backward: true "
+        "input: 'data' "
+        "input_dim: 2 "
+        "input_dim: 3 "
+        "input_dim: 10 "
+        "input_dim: 10 "
+        "layer { "
+        "  name: 'conv_b' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv_b' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 1 "
+        "    group: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu_b' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv_b' "
+        "  top: 'conv_b' "
+        "} "
+        // In place on the split top of 'data' conv_b reads from.
+        "layer { "
+        "  name: 'relu_data' "
+        "  type: 'ReLU' "
+        "  bottom: 'data' "
+        "  top: 'data' "
+        "} "
+        "layer { "
+        "  name: 'conv_a' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv_a' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu_a' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv_a' "
+        "  top: 'conv_a' "
+        "} "
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'conv_a' "
+        "  bottom: 'conv_b' "
+        "  top: 'concat' "
+        "} ";
+    if (!concurrent_branches) {
+      proto += "concurrent_branches: false ";
+    }
+    return proto;
+  }
+
+  virtual void InitBranchyNet(const bool concurrent_branches) {
+    InitNetFromProtoString(BranchyNetProto(concurrent_branches));
+  }
+
+  virtual string NeuronChainNetProto(const bool fuse_neurons) {
+    string proto =
+        "name: 'NeuronChainNetwork' "
+        "force_backward: true "
+        "input: 'data' "
+        "input_dim: 2 "
+        "input_dim: 3 "
+        "input_dim: 4 "
+        "input_dim: 5 "
+        "layer { "
+        "  name: 'power' "
+        "  type: 'Power' "
+        "  bottom: 'data' "
+        "  top: 'power' "
+        "  power_param { "
+        "    power: 3 "
+        "    scale: 0.5 "
+        "    shift: -0.25 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'power' "
+        "  top: 'power' "
+        "  relu_param { "
+        "    negative_slope: 0.1 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'tanh' "
+        "  type: 'TanH' "
+        "  bottom: 'power' "
+        "  top: 'tanh' "
+        "} "
+        "layer { "
+        "  name: 'sigmoid' "
+        "  type: 'Sigmoid' "
+        "  bottom: 'tanh' "
+        "  top: 'sigmoid' "
+        "} "
+        "layer { "
+        "  name: 'exp' "
+        "  type: 'Exp' "
+        "  bottom: 'sigmoid' "
+        "  top: 'exp' "
+        "  exp_param { "
+        "    base: 2 "
+        "    scale: 0.5 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'log' "
+        "  type: 'Log' "
+        "  bottom: 'exp' "
+        "  top: 'log' "
+        "  log_param { "
+        "    shift: 1 "
+        "  } "
+        "} ";
+    if (fuse_neurons) {
+      proto += "fuse_neurons: true ";
+    }
+    return proto;
+  }
+
+  virtual void InitNeuronChainNet(const bool fuse_neurons) {
+    InitNetFromProtoString(NeuronChainNetProto(fuse_neurons));
+  }
+
+  virtual string ConvReLUNetProto(const bool fuse_conv_relu) {
+    string proto =
+        "name: 'ConvReLUNetwork' "
+        "force_backward: true "
+        "input: 'data' "
+        "input_dim: 2 "
+        "input_dim: 3 "
+        "input_dim: 6 "
+        "input_dim: 5 "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "    bias_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "  relu_param { "
+        "    negative_slope: 0.1 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sigmoid' "
+        "  type: 'Sigmoid' "
+        "  bottom: 'conv' "
+        "  top: 'sigmoid' "
+        "} ";
+    if (fuse_conv_relu) {
+      proto += "fuse_conv_relu: true ";
+    }
+    return proto;
+  }
+
+  virtual void InitConvReLUNet(const bool fuse_conv_relu) {
+    InitNetFromProtoString(ConvReLUNetProto(fuse_conv_relu));
+  }
+
+  virtual void InitPoolingLossNet(const bool inference_only) {
+    string proto =
+        "name: 'PoolingLossNetwork' "
+        "input: 'data' "
+        "input_dim: 2 "
+        "input_dim: 3 "
+        "input_dim: 6 "
+        "input_dim: 6 "
+        "input: 'label' "
+        "input_dim: 2 "
+        "input_dim: 1 "
+        "input_dim: 1 "
+        "input_dim: 1 "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'innerproduct' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'pool' "
+        "  top: 'innerproduct' "
+        "  inner_product_param { "
+        "    num_output: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.5 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'innerproduct' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    if (inference_only) {
+      proto += "inference_only: true ";
+    }
     InitNetFromProtoString(proto);
   }
 
@@ -2324,6 +2633,218 @@ TYPED_TEST(NetTest, TestReshape) {
   }
 }
 
+TYPED_TEST(NetTest, TestMemoryOptimize) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Run the same input through the net with and without memory planning and
+  // check that the outputs match while the planned net holds less memory.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 20, 20);
+  filler.Fill(&input);
+
+  Caffe::set_random_seed(this->seed_);
+  this->InitReshapableNet();
+  EXPECT_EQ(this->net_->memory_planned(), 0);
+  Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+  input_blob->ReshapeLike(input);
+  caffe_copy(input.count(), input.cpu_data(), input_blob->mutable_cpu_data());
+  this->net_->Reshape();
+  this->net_->ForwardPrefilled();
+  Blob<Dtype> output;
+  output.CopyFrom(*this->net_->output_blobs()[0], false, true);
+
+  Caffe::set_random_seed(this->seed_);
+  this->InitReshapableNet(true);
+  EXPECT_GT(this->net_->memory_planned(), 0);
+  EXPECT_LT(this->net_->memory_planned(), this->net_->memory_used());
+  input_blob = this->net_->input_blobs()[0];
+  input_blob->ReshapeLike(input);
+  caffe_copy(input.count(), input.cpu_data(), input_blob->mutable_cpu_data());
+  this->net_->Reshape();
+  this->net_->ForwardPrefilled();
+  const Blob<Dtype>* output_blob = this->net_->output_blobs()[0];
+  ASSERT_EQ(output.count(), output_blob->count());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_EQ(output.cpu_data()[i], output_blob->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestConcurrentBranches) {
+  // The branches of the net give the same results on separate queues, even
+  // though one overwrites in place the data the other reads.
+  this->InitBranchyNet(false);
+  EXPECT_TRUE(this->net_->layer_queues().empty());
+#ifndef CPU_ONLY
+  this->InitBranchyNet(true);
+  if (amdDevice.num_queues() > 1) {
+    const vector<int>& queues = this->net_->layer_queues();
+    const vector<string>& names = this->net_->layer_names();
+    ASSERT_EQ(names.size(), queues.size());
+    const int conv_a = std::find(names.begin(), names.end(), "conv_a")
+        - names.begin();
+    const int conv_b = std::find(names.begin(), names.end(), "conv_b")
+        - names.begin();
+    EXPECT_NE(queues[conv_a], queues[conv_b]);
+  }
+#endif
+  this->ExpectSameNetResults(this->BranchyNetProto(false),
+      this->BranchyNetProto(true), 0);
+}
+
+TYPED_TEST(NetTest, TestFuseNeurons) {
+  // The fused kernel computes the same data and diffs as the layers.
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    this->InitNeuronChainNet(fuse);
+    const int num_layers = this->net_->layers().size();
+    const int expected_end =
+        (fuse && Caffe::mode() != Caffe::CPU) ? num_layers - 1 : 0;
+    EXPECT_EQ(expected_end, this->net_->fused_chain_end(0));
+  }
+  this->ExpectSameNetResults(this->NeuronChainNetProto(false),
+      this->NeuronChainNetProto(true), 1e-5);
+}
+
+TYPED_TEST(NetTest, TestFuseConvReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The convolution applying the ReLU with its bias gives the same data and
+  // diffs as the two layers.
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    this->InitConvReLUNet(fuse);
+    ConvolutionLayer<Dtype>* conv_layer =
+        dynamic_cast<ConvolutionLayer<Dtype>*>(
+            this->net_->layer_by_name("conv").get());
+    ASSERT_TRUE(conv_layer != NULL);
+    EXPECT_EQ(fuse != 0, conv_layer->fused_relu());
+  }
+  this->ExpectSameNetResults(this->ConvReLUNetProto(false),
+      this->ConvReLUNetProto(true), 1e-5);
+}
+
+TYPED_TEST(NetTest, TestInferenceOnly) {
+  typedef typename TypeParam::Dtype Dtype;
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 6, 6);
+  filler.Fill(&input);
+  Dtype losses[2];
+  for (int inference_only = 0; inference_only < 2; ++inference_only) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitPoolingLossNet(inference_only);
+    EXPECT_EQ(inference_only != 0, this->net_->inference_only());
+    caffe_copy(input.count(), input.cpu_data(),
+        this->net_->input_blobs()[0]->mutable_cpu_data());
+    Blob<Dtype>* label = this->net_->input_blobs()[1];
+    for (int i = 0; i < label->count(); ++i) {
+      label->mutable_cpu_data()[i] = i % 3;
+    }
+    this->net_->ForwardPrefilled(&losses[inference_only]);
+  }
+  EXPECT_NEAR(losses[0], losses[1], 1e-5);
+  // Only the blobs around the loss layer keep their diffs.
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    EXPECT_FALSE(this->net_->layer_need_backward()[i]);
+  }
+  EXPECT_FALSE(this->net_->blob_by_name("data")->has_diff());
+  EXPECT_FALSE(this->net_->blob_by_name("conv")->has_diff());
+  EXPECT_FALSE(this->net_->blob_by_name("pool")->has_diff());
+  EXPECT_TRUE(this->net_->blob_by_name("innerproduct")->has_diff());
+  EXPECT_TRUE(this->net_->blob_by_name("loss")->has_diff());
+  for (int i = 0; i < this->net_->params().size(); ++i) {
+    EXPECT_FALSE(this->net_->params()[i]->has_diff());
+  }
+  EXPECT_TRUE(this->net_->layer_by_name("pool")->inference_only());
+  // Reshaping does not bring the diffs back.
+  this->net_->input_blobs()[0]->Reshape(4, 3, 6, 6);
+  this->net_->input_blobs()[1]->Reshape(4, 1, 1, 1);
+  this->net_->Reshape();
+  EXPECT_FALSE(this->net_->blob_by_name("conv")->has_diff());
+}
+
+TYPED_TEST(NetTest, TestProfile) {
+  this->InitTinyNet(true);
+  const int num_layers = this->net_->layers().size();
+  ASSERT_EQ(num_layers, this->net_->layer_profiles().size());
+  // Nothing is collected while profiling is off.
+  this->net_->ForwardPrefilled();
+  this->net_->Backward();
+  for (int i = 0; i < num_layers; ++i) {
+    EXPECT_EQ(0, this->net_->layer_profiles()[i].forward_calls);
+    EXPECT_EQ(0, this->net_->layer_profiles()[i].backward_calls);
+  }
+  this->net_->set_profile(true);
+  this->net_->ForwardPrefilled();
+  this->net_->Backward();
+  this->net_->ForwardPrefilled();
+  for (int i = 0; i < num_layers; ++i) {
+    const LayerProfile& profile = this->net_->layer_profiles()[i];
+    EXPECT_EQ(2, profile.forward_calls);
+    EXPECT_GE(profile.forward_ms, 0);
+    EXPECT_EQ(this->net_->layer_need_backward()[i] ? 1 : 0,
+        profile.backward_calls);
+  }
+  this->net_->ClearProfile();
+  for (int i = 0; i < num_layers; ++i) {
+    EXPECT_EQ(0, this->net_->layer_profiles()[i].forward_calls);
+  }
+}
+
+TYPED_TEST(NetTest, TestTunePacking) {
+  typedef typename TypeParam::Dtype Dtype;
+  string tuning_file;
+  MakeTempFilename(&tuning_file);
+  const string proto =
+      "name: 'PackingNetwork' "
+      "input: 'data' "
+      "input_dim: 4 "
+      "input_dim: 3 "
+      "input_dim: 10 "
+      "input_dim: 10 "
+      "tune_packing: true "
+      "packing_tuning_file: '" + tuning_file + "' "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    weight_filler { "
+      "      type: 'gaussian' "
+      "    } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  BaseConvolutionLayer<Dtype>* conv_layer =
+      dynamic_cast<BaseConvolutionLayer<Dtype>*>(
+          this->net_->layer_by_name("conv1").get());
+  ASSERT_TRUE(conv_layer);
+  const int tuned_num = conv_layer->packing_num();
+  EXPECT_TRUE(tuned_num == 1 || tuned_num == 2 || tuned_num == 4);
+  // The choice was saved under the layer's key...
+  string key;
+  int saved_num;
+  {
+    std::ifstream in(tuning_file.c_str());
+    ASSERT_TRUE(in >> key >> saved_num);
+  }
+  EXPECT_EQ(conv_layer->packing_key(), key);
+  EXPECT_EQ(tuned_num, saved_num);
+  // ... and is read back instead of tuning again.
+  const int forced_num = tuned_num == 4 ? 2 : 4;
+  {
+    std::ofstream out(tuning_file.c_str());
+    out << key << " " << forced_num << "\n";
+  }
+  this->InitNetFromProtoString(proto);
+  conv_layer = dynamic_cast<BaseConvolutionLayer<Dtype>*>(
+      this->net_->layer_by_name("conv1").get());
+  EXPECT_EQ(forced_num, conv_layer->packing_num());
+  remove(tuning_file.c_str());
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
@@ -7,6 +8,7 @@
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/device_alternate.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/ocl_buffer_pool.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -121,6 +123,143 @@ TEST_F(SyncedMemoryTest, TestGPUWrite) {
   EXPECT_EQ(mem.head(), SyncedMemory::SYNCED);
 }
 
+TEST_F(SyncedMemoryTest, TestAsyncGPUPush) {
+  SyncedMemory mem(10);
+  void* cpu_data = mem.mutable_cpu_data();
+  caffe_memset(mem.size(), 3, cpu_data);
+  mem.async_gpu_push();
+  EXPECT_EQ(mem.head(), SyncedMemory::SYNCED);
+  const void* gpu_data = mem.gpu_data();
+  char* recovered_value = new char[10];
+  caffe_gpu_memcpy(10, gpu_data, recovered_value);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ((static_cast<char*>(recovered_value))[i], 3);
+  }
+  // writing on the host again waits for the push
+  cpu_data = mem.mutable_cpu_data();
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+  caffe_memset(mem.size(), 4, cpu_data);
+  mem.async_gpu_push();
+  caffe_gpu_memcpy(10, mem.gpu_data(), recovered_value);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ((static_cast<char*>(recovered_value))[i], 4);
+  }
+  delete[] recovered_value;
+}
+
+TEST_F(SyncedMemoryTest, TestBufferPoolBucketSize) {
+  EXPECT_EQ(BufferPool::BucketSize(1), 256);
+  EXPECT_EQ(BufferPool::BucketSize(256), 256);
+  EXPECT_EQ(BufferPool::BucketSize(257), 288);
+  EXPECT_EQ(BufferPool::BucketSize(4096), 4096);
+  EXPECT_EQ(BufferPool::BucketSize(4097), 4608);
+  for (size_t size = 1; size < 100000; size += 997) {
+    const size_t bucket = BufferPool::BucketSize(size);
+    EXPECT_GE(bucket, size);
+    EXPECT_LE(bucket, std::max<size_t>(256, size + size / 8));
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestBufferPoolReuse) {
+  BufferPool& pool = amdDevice.buffer_pool();
+  pool.Trim();
+  pool.ResetStats();
+  const size_t in_use = pool.stats().bytes_in_use;
+  {
+    SyncedMemory mem(1000);
+    // caffe_gpu_memset counts ints
+    caffe_gpu_memset(mem.size() / sizeof(int), 1, mem.mutable_gpu_data());
+  }
+  EXPECT_EQ(pool.stats().misses, 1);
+  EXPECT_EQ(pool.stats().bytes_in_use, in_use);
+  EXPECT_EQ(pool.stats().bytes_cached, BufferPool::BucketSize(1000));
+  {
+    // a slightly smaller buffer reuses the cached one, zeroed
+    SyncedMemory mem(990);
+    mem.gpu_data();
+    EXPECT_EQ(pool.stats().hits, 1);
+    EXPECT_EQ(pool.stats().bytes_cached, 0);
+    const char* cpu_data = static_cast<const char*>(mem.cpu_data());
+    for (int i = 0; i < mem.size(); ++i) {
+      EXPECT_EQ(cpu_data[i], 0);
+    }
+  }
+  // the device buffer and the mapped host buffer
+  EXPECT_EQ(pool.stats().high_water,
+      in_use + 2 * BufferPool::BucketSize(1000));
+  pool.Trim();
+  EXPECT_EQ(pool.stats().bytes_cached, 0);
+}
+
+TEST_F(SyncedMemoryTest, TestBufferPoolDisabled) {
+  BufferPool& pool = amdDevice.buffer_pool();
+  pool.ResetStats();
+  Caffe::set_buffer_pool(false);
+  {
+    SyncedMemory mem(1000);
+    mem.mutable_gpu_data();
+  }
+  EXPECT_EQ(pool.stats().hits, 0);
+  EXPECT_EQ(pool.stats().bytes_cached, 0);
+  Caffe::set_buffer_pool(true);
+  EXPECT_TRUE(pool.enabled());
+}
+
+TEST_F(SyncedMemoryTest, TestZeroCopy) {
+  const Caffe::Brew mode = Caffe::mode();
+  Caffe::set_mode(Caffe::APU);
+  SyncedMemory mem(10);
+  caffe_memset(mem.size(), 1, mem.mutable_cpu_data());
+  EXPECT_TRUE(mem.zero_copy());
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+  char* recovered_value = new char[10];
+  caffe_gpu_memcpy(10, mem.gpu_data(), recovered_value);
+  EXPECT_EQ(mem.head(), SyncedMemory::SYNCED);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(recovered_value[i], 1);
+  }
+  caffe_gpu_memset(mem.size(), 2, mem.mutable_gpu_data());
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_GPU);
+  const char* cpu_data = static_cast<const char*>(mem.cpu_data());
+  EXPECT_EQ(mem.head(), SyncedMemory::SYNCED);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(cpu_data[i], 2);
+  }
+  delete[] recovered_value;
+  // memory first used in the other brews keeps separate buffers
+  Caffe::set_mode(Caffe::GPU);
+  SyncedMemory gpu_mem(10);
+  gpu_mem.gpu_data();
+  EXPECT_FALSE(gpu_mem.zero_copy());
+  Caffe::set_mode(mode);
+}
+
+TEST_F(SyncedMemoryTest, TestZeroCopySetCpuData) {
+  const Caffe::Brew mode = Caffe::mode();
+  Caffe::set_mode(Caffe::APU);
+  SyncedMemory mem(12);
+  mem.mutable_cpu_data();
+  EXPECT_TRUE(mem.zero_copy());
+  // external host memory leaves zero-copy and is uploaded from
+  char data[12];
+  memset(data, 3, sizeof(data));
+  mem.set_cpu_data(data);
+  EXPECT_FALSE(mem.zero_copy());
+  char recovered_value[12];
+  caffe_gpu_memcpy(12, mem.gpu_data(), recovered_value);
+  EXPECT_EQ(mem.head(), SyncedMemory::SYNCED);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(recovered_value[i], 3);
+  }
+  // and downloaded to
+  caffe_gpu_memset(mem.size() / sizeof(int), 4, mem.mutable_gpu_data());
+  EXPECT_EQ(mem.cpu_data(), data);
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(data[i], 4);
+  }
+  Caffe::set_mode(mode);
+}
+
 #endif
 
 }  // namespace caffe
@@ -0,0 +1,130 @@
+#include <boost/thread.hpp>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/trace.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class TraceTest : public MultiDeviceTest<TypeParam> {
+  protected:
+    virtual ~TraceTest() {
+      Tracer::Get().Stop();
+    }
+
+    // Stops the tracer and returns the trace it writes.
+    std::string StopAndRead() {
+      Tracer::Get().Stop();
+      string file_name;
+      MakeTempFilename(&file_name);
+      EXPECT_TRUE(Tracer::Get().Write(file_name));
+      std::ifstream file(file_name.c_str());
+      std::stringstream contents;
+      contents << file.rdbuf();
+      return contents.str();
+    }
+};
+
+TYPED_TEST_CASE(TraceTest, TestDtypesAndDevices);
+
+static void TraceFromThread() {
+  TraceScope trace("worker", "test");
+}
+
+TYPED_TEST(TraceTest, TestDisabled) {
+  Tracer::Get().Start();
+  Tracer::Get().Stop();
+  {
+    TraceScope trace("ignored", "test");
+  }
+  EXPECT_FALSE(Tracer::Get().enabled());
+  EXPECT_EQ(0, Tracer::Get().num_events());
+}
+
+TYPED_TEST(TraceTest, TestScopes) {
+  Tracer::Get().Start();
+  EXPECT_TRUE(Tracer::Get().enabled());
+  {
+    TraceScope outer("outer", "test");
+    TraceScope inner("in\"ner", "test");
+  }
+  boost::thread thread(&TraceFromThread);
+  thread.join();
+  EXPECT_EQ(3, Tracer::Get().num_events());
+  const std::string trace = this->StopAndRead();
+  EXPECT_EQ(0, trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, trace.find("{\"name\":\"outer\",\"cat\":\"test\","
+      "\"ph\":\"X\",\"pid\":0,\"tid\":0,"));
+  EXPECT_NE(std::string::npos, trace.find("{\"name\":\"in\\\"ner\""));
+  EXPECT_NE(std::string::npos, trace.find("{\"name\":\"worker\",\"cat\":"
+      "\"test\",\"ph\":\"X\",\"pid\":0,\"tid\":1,"));
+  EXPECT_NE(std::string::npos, trace.find("\"args\":{\"name\":\"thread 1\"}"));
+  EXPECT_EQ(trace.size() - 3, trace.rfind("]}\n"));
+}
+
+TYPED_TEST(TraceTest, TestNet) {
+  typedef typename TypeParam::Dtype Dtype;
+  const string proto =
+      "name: 'TraceNet' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'DummyData' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+      "    shape { dim: 2 dim: 5 } "
+      "    data_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  top: 'data' "
+      "  top: 'target' "
+      "} "
+      "layer { "
+      "  name: 'innerproduct' "
+      "  type: 'InnerProduct' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 1 } "
+      "  } "
+      "  bottom: 'data' "
+      "  top: 'innerproduct' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'EuclideanLoss' "
+      "  bottom: 'innerproduct' "
+      "  bottom: 'target' "
+      "  top: 'loss' "
+      "  loss_weight: 1 "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  Tracer::Get().Start();
+  net.ForwardPrefilled();
+  net.Backward();
+  const std::string trace = this->StopAndRead();
+  const char* layers[] = { "data", "innerproduct", "loss" };
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"" + string(layers[i])
+        + "\",\"cat\":\"forward\""));
+  }
+  EXPECT_NE(std::string::npos,
+      trace.find("{\"name\":\"innerproduct\",\"cat\":\"backward\""));
+  EXPECT_NE(std::string::npos,
+      trace.find("{\"name\":\"loss\",\"cat\":\"backward\""));
+  if (Caffe::mode() != Caffe::CPU) {
+    EXPECT_NE(std::string::npos, trace.find("\"cat\":\"kernel\""));
+  }
+}
+
+}  // namespace caffe
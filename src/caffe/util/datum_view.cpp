@@ -0,0 +1,113 @@
+#include <stdint.h>
+
+#include "caffe/util/datum_view.hpp"
+
+namespace caffe {
+
+// Protocol buffer wire types.
+enum WireType {
+  WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_LENGTH_DELIMITED = 2,
+  WIRE_FIXED32 = 5
+};
+
+// Field numbers of Datum.
+enum DatumField {
+  FIELD_CHANNELS = 1, FIELD_HEIGHT = 2, FIELD_WIDTH = 3, FIELD_DATA = 4,
+  FIELD_LABEL = 5, FIELD_FLOAT_DATA = 6, FIELD_ENCODED = 7
+};
+
+static bool ReadVarint(const uint8_t** p, const uint8_t* end,
+    uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+    const uint8_t byte = *(*p)++;
+    *value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+DatumView::DatumView()
+    : channels(0), height(0), width(0), label(0), encoded(false), data(NULL),
+      data_size(0), float_data(NULL), float_data_size(0) {
+}
+
+DatumView::DatumView(const Datum& datum)
+    : channels(datum.channels()), height(datum.height()),
+      width(datum.width()), label(datum.label()), encoded(datum.encoded()),
+      data(datum.has_data() ? datum.data().data() : NULL),
+      data_size(datum.data().size()),
+      float_data(datum.float_data_size() ? datum.float_data().data() : NULL),
+      float_data_size(datum.float_data_size()) {
+}
+
+bool DatumView::Parse(const char* buffer, const size_t size) {
+  *this = DatumView();
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buffer);
+  const uint8_t* end = p + size;
+  while (p < end) {
+    uint64_t tag, value;
+    if (!ReadVarint(&p, end, &tag)) {
+      return false;
+    }
+    const int field = tag >> 3;
+    switch (tag & 7) {
+    case WIRE_VARINT:
+      if (!ReadVarint(&p, end, &value)) {
+        return false;
+      }
+      // int32 fields are sign extended to 64 bits on the wire.
+      switch (field) {
+      case FIELD_CHANNELS:
+        channels = static_cast<int32_t>(value);
+        break;
+      case FIELD_HEIGHT:
+        height = static_cast<int32_t>(value);
+        break;
+      case FIELD_WIDTH:
+        width = static_cast<int32_t>(value);
+        break;
+      case FIELD_LABEL:
+        label = static_cast<int32_t>(value);
+        break;
+      case FIELD_ENCODED:
+        encoded = (value != 0);
+        break;
+      }
+      break;
+    case WIRE_FIXED64:
+      if (end - p < 8) {
+        return false;
+      }
+      p += 8;
+      break;
+    case WIRE_LENGTH_DELIMITED:
+      if (!ReadVarint(&p, end, &value) || value > (uint64_t) (end - p)) {
+        return false;
+      }
+      if (field == FIELD_FLOAT_DATA) {
+        return false;  // packed floats
+      }
+      if (field == FIELD_DATA) {
+        data = reinterpret_cast<const char*>(p);
+        data_size = value;
+      }
+      p += value;
+      break;
+    case WIRE_FIXED32:
+      if (field == FIELD_FLOAT_DATA || end - p < 4) {
+        return false;
+      }
+      p += 4;
+      break;
+    default:
+      // Groups, which Datum has none of.
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace caffe
@@ -0,0 +1,164 @@
+#include "caffe/util/db_packed.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace caffe {
+namespace db {
+
+// Records start on 8 bytes, so their headers are aligned in the mapping.
+static uint64_t PaddedRecordSize(const uint64_t key_size,
+    const uint64_t value_size) {
+  const uint64_t size = sizeof(PackedRecordHeader) + key_size + value_size;
+  return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+static uint64_t FileSize(const int fd, const string& path) {
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat " << path;
+  return st.st_size;
+}
+
+static void WriteAt(const int fd, const char* data, const size_t size,
+    const uint64_t offset, const string& path) {
+  size_t written = 0;
+  while (written < size) {
+    const ssize_t n = pwrite(fd, data + written, size - written,
+        offset + written);
+    CHECK_GT(n, 0) << "Failed to write " << path;
+    written += n;
+  }
+}
+
+static void* Map(const int fd, const uint64_t size, const string& path) {
+  if (size == 0) {
+    return NULL;
+  }
+  void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  CHECK(map != MAP_FAILED) << "Failed to map " << path;
+  return map;
+}
+
+void PackedDB::Open(const string& source, Mode mode) {
+  source_ = source;
+  mode_ = mode;
+  if (mode == NEW) {
+    CHECK_EQ(mkdir(source.c_str(), 0744), 0) << "mkdir " << source
+        << " failed";
+  }
+  const string data_path = source + "/data";
+  const string index_path = source + "/index";
+  const int flags = (mode == READ) ? O_RDONLY : O_RDWR | O_CREAT;
+  data_fd_ = open(data_path.c_str(), flags, 0664);
+  CHECK_NE(data_fd_, -1) << "Failed to open " << data_path;
+  index_fd_ = open(index_path.c_str(), flags, 0664);
+  CHECK_NE(index_fd_, -1) << "Failed to open " << index_path;
+
+  // A commit cut short leaves a partial index entry, or records past the
+  // last one indexed, which are dropped.
+  num_records_ = FileSize(index_fd_, index_path) / sizeof(uint64_t);
+  data_size_ = 0;
+  if (num_records_ > 0) {
+    uint64_t offset;
+    CHECK_EQ(pread(index_fd_, &offset, sizeof(offset),
+        (num_records_ - 1) * sizeof(uint64_t)),
+        static_cast<ssize_t>(sizeof(offset)))
+        << "Failed to read " << index_path;
+    PackedRecordHeader header;
+    CHECK_EQ(pread(data_fd_, &header, sizeof(header), offset),
+        static_cast<ssize_t>(sizeof(header)))
+        << "Failed to read " << data_path;
+    data_size_ = offset + PaddedRecordSize(header.key_size,
+        header.value_size);
+    CHECK_LE(data_size_, FileSize(data_fd_, data_path))
+        << data_path << " is shorter than its index";
+  }
+  if (mode == READ) {
+    data_map_ = static_cast<char*>(Map(data_fd_, data_size_, data_path));
+    index_map_ = static_cast<uint64_t*>(Map(index_fd_,
+        num_records_ * sizeof(uint64_t), index_path));
+  } else {
+    CHECK_EQ(ftruncate(index_fd_, num_records_ * sizeof(uint64_t)), 0)
+        << "Failed to truncate " << index_path;
+    CHECK_EQ(ftruncate(data_fd_, data_size_), 0)
+        << "Failed to truncate " << data_path;
+  }
+  LOG(INFO) << "Opened packed db " << source << " with " << num_records_
+      << " records";
+}
+
+void PackedDB::Close() {
+  if (data_map_ != NULL) {
+    munmap(data_map_, data_size_);
+    data_map_ = NULL;
+  }
+  if (index_map_ != NULL) {
+    munmap(index_map_, num_records_ * sizeof(uint64_t));
+    index_map_ = NULL;
+  }
+  if (data_fd_ != -1) {
+    close(data_fd_);
+    data_fd_ = -1;
+  }
+  if (index_fd_ != -1) {
+    close(index_fd_);
+    index_fd_ = -1;
+  }
+}
+
+PackedCursor* PackedDB::NewCursor() {
+  CHECK_EQ(mode_, READ) << "Packed db " << source_
+      << " must be opened for reading to iterate over it";
+  return new PackedCursor(data_map_, index_map_, num_records_);
+}
+
+PackedTransaction* PackedDB::NewTransaction() {
+  CHECK_NE(mode_, READ) << "Packed db " << source_ << " is read-only";
+  return new PackedTransaction(this);
+}
+
+void PackedDB::Append(const string& records,
+    const std::vector<uint64_t>& offsets) {
+  if (offsets.empty()) {
+    return;
+  }
+  // Data first, so the index never points past it.
+  WriteAt(data_fd_, records.data(), records.size(), data_size_,
+      source_ + "/data");
+  std::vector<uint64_t> index(offsets.size());
+  for (int i = 0; i < offsets.size(); ++i) {
+    index[i] = data_size_ + offsets[i];
+  }
+  WriteAt(index_fd_, reinterpret_cast<const char*>(&index[0]),
+      index.size() * sizeof(uint64_t), num_records_ * sizeof(uint64_t),
+      source_ + "/index");
+  data_size_ += records.size();
+  num_records_ += offsets.size();
+}
+
+void PackedTransaction::Put(const string& key, const string& value) {
+  PackedRecordHeader header;
+  header.key_size = key.size();
+  header.value_size = value.size();
+  CHECK_EQ(header.value_size, value.size()) << "Value too large";
+  offsets_.push_back(records_.size());
+  records_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  records_.append(key);
+  records_.append(value);
+  records_.resize(offsets_.back() + PaddedRecordSize(key.size(),
+      value.size()), '\0');
+}
+
+void PackedTransaction::Commit() {
+  db_->Append(records_, offsets_);
+  records_.clear();
+  offsets_.clear();
+}
+
+}  // namespace db
+}  // namespace caffe
@@ -70,6 +70,97 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w,
     double* data_col);
 
+template <typename Dtype>
+void im2col_1x1_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    Dtype* data_col) {
+  int height_col = (height - 1) / stride_h + 1;
+  int width_col = (width - 1) / stride_w + 1;
+  for (int c = 0; c < channels; ++c) {
+    for (int h = 0; h < height_col; ++h) {
+      const Dtype* im = data_im + (c * height + h * stride_h) * width;
+      for (int w = 0; w < width_col; ++w) {
+        data_col[w] = im[w * stride_w];
+      }
+      data_col += width_col;
+    }
+  }
+}
+
+template void im2col_1x1_cpu<float>(const float* data_im, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    float* data_col);
+template void im2col_1x1_cpu<double>(const double* data_im,
+    const int channels, const int height, const int width, const int stride_h,
+    const int stride_w, double* data_col);
+
+template <typename Dtype>
+void col2im_1x1_cpu(const Dtype* data_col, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    Dtype* data_im) {
+  // Pixels skipped by the stride get no gradient.
+  caffe_set(height * width * channels, Dtype(0), data_im);
+  int height_col = (height - 1) / stride_h + 1;
+  int width_col = (width - 1) / stride_w + 1;
+  for (int c = 0; c < channels; ++c) {
+    for (int h = 0; h < height_col; ++h) {
+      Dtype* im = data_im + (c * height + h * stride_h) * width;
+      for (int w = 0; w < width_col; ++w) {
+        im[w * stride_w] = data_col[w];
+      }
+      data_col += width_col;
+    }
+  }
+}
+
+template void col2im_1x1_cpu<float>(const float* data_col, const int channels,
+    const int height, const int width, const int stride_h, const int stride_w,
+    float* data_im);
+template void col2im_1x1_cpu<double>(const double* data_col,
+    const int channels, const int height, const int width, const int stride_h,
+    const int stride_w, double* data_im);
+
+template <typename Dtype>
+void im2col_cpu_opt(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    Dtype* data_col, const int optnum) {
+  int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
+  int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
+  int channels_col = channels * kernel_h * kernel_w;
+  int col_size = height_col * width_col;
+  // Same layout as im2col_gpu_opt: row c holds the columns of image 0, then
+  // image 1, ..., so one gemm covers all optnum images.
+  for (int c = 0; c < channels_col; ++c) {
+    int w_offset = c % kernel_w;
+    int h_offset = (c / kernel_w) % kernel_h;
+    int c_im = c / kernel_h / kernel_w;
+    for (int n = 0; n < optnum; ++n) {
+      const Dtype* im = data_im + (n * channels + c_im) * height * width;
+      Dtype* col = data_col + (c * optnum + n) * col_size;
+      for (int h = 0; h < height_col; ++h) {
+        for (int w = 0; w < width_col; ++w) {
+          int h_pad = h * stride_h - pad_h + h_offset;
+          int w_pad = w * stride_w - pad_w + w_offset;
+          if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width)
+            col[h * width_col + w] = im[h_pad * width + w_pad];
+          else
+            col[h * width_col + w] = 0;
+        }
+      }
+    }
+  }
+}
+
+template void im2col_cpu_opt<float>(const float* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w, const int stride_h, const int stride_w,
+    float* data_col, const int optnum);
+template void im2col_cpu_opt<double>(const double* data_im,
+    const int channels, const int height, const int width, const int kernel_h,
+    const int kernel_w, const int pad_h, const int pad_w, const int stride_h,
+    const int stride_w, double* data_col, const int optnum);
+
 template <typename Dtype>
 void col2im_cpu(const Dtype* data_col, const int channels, const int height,
     const int width, const int patch_h, const int patch_w, const int pad_h,
@@ -109,8 +200,8 @@ void col2im_gpu_opt(const Dtype* data_col, const int col_offset,
     const int channels, const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* data_im, const int img_offset,
     int optnum) {
-  std::string kernel_name = "col2im_opt" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("col2im_opt");
+  cl_kernel Kernel = handle.get();
   int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
   int num_kernels = channels * height * width * optnum;
@@ -158,8 +249,8 @@ void im2col_gpu(const Dtype* data_im, const int img_offset, const int channels,
     const int height, const int width, const int kernel_h, const int kernel_w,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w,
     Dtype* data_col, const int col_offset) {
-  std::string kernel_name = "im2col" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("im2col");
+  cl_kernel Kernel = handle.get();
 
   int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
@@ -205,8 +296,8 @@ void col2im_gpu(const Dtype* data_col, const int col_offset, const int channels,
     const int width,  const int patch_h, const int patch_w,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w,
     Dtype* data_im, const int img_offset) {
-  std::string kernel_name = "col2im" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("col2im");
+  cl_kernel Kernel = handle.get();
 
   int height_col = (height + 2 * pad_h - patch_h) / stride_h + 1;
   int width_col = (width + 2 * pad_w - patch_w) / stride_w + 1;
@@ -252,8 +343,8 @@ void im2col_gpu_opt(const Dtype* data_im, const int img_offset,
     const int pad_h, const int pad_w, const int stride_h, const int stride_w, Dtype* data_col, const int col_offset,
     int optnum) {
 
-  std::string kernel_name = "im2col_opt" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("im2col_opt");
+  cl_kernel Kernel = handle.get();
 
   int height_col = (height + 2 * pad_h - kernel_h) / stride_h + 1;
   int width_col = (width + 2 * pad_w - kernel_w) / stride_w + 1;
@@ -0,0 +1,208 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/util/image_cache.hpp"
+
+namespace caffe {
+
+// A disk record is the key length, the key, the rows, cols and type of the
+// image, then its pixels.
+static const size_t kRecordHeader = sizeof(uint32_t);
+static const size_t kImageHeader = 3 * sizeof(int32_t);
+
+static size_t ImageBytes(const cv::Mat& image) {
+  return image.total() * image.elemSize();
+}
+
+ImageCache::ImageCache(const size_t capacity, const Policy policy,
+    const std::string& disk_file)
+    : capacity_(capacity), policy_(policy), disk_file_(disk_file), fd_(-1),
+      disk_size_(0), map_(NULL), map_size_(0) {
+  if (!disk_file_.empty()) {
+    OpenDiskFile();
+  }
+}
+
+ImageCache::~ImageCache() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool ImageCache::Get(const std::string& key, cv::Mat* image) {
+  std::map<std::string, EntryList::iterator>::iterator it = index_.find(key);
+  if (it != index_.end()) {
+    if (policy_ == LRU) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+    }
+    *image = it->second->image;
+    ++stats_.hits;
+    return true;
+  }
+  if (ReadFromDisk(key, image)) {
+    Admit(key, *image);
+    ++stats_.disk_hits;
+    return true;
+  }
+  ++stats_.misses;
+  return false;
+}
+
+void ImageCache::Put(const std::string& key, const cv::Mat& image) {
+  CHECK(image.data) << "Can't cache an empty image: " << key;
+  if (index_.find(key) == index_.end()) {
+    // Shared with the caller, who doesn't write to decoded images.
+    Admit(key, image);
+  }
+  if (fd_ >= 0 && disk_index_.find(key) == disk_index_.end()) {
+    AppendToDisk(key, image);
+  }
+}
+
+void ImageCache::Admit(const std::string& key, const cv::Mat& image) {
+  const size_t bytes = ImageBytes(image);
+  if (bytes > capacity_) {
+    return;
+  }
+  if (policy_ == FILL) {
+    if (stats_.bytes_cached + bytes > capacity_) {
+      return;
+    }
+  } else {
+    while (stats_.bytes_cached + bytes > capacity_) {
+      const Entry& last = entries_.back();
+      stats_.bytes_cached -= ImageBytes(last.image);
+      --stats_.images_cached;
+      index_.erase(last.key);
+      entries_.pop_back();
+    }
+  }
+  Entry entry;
+  entry.key = key;
+  entry.image = image;
+  entries_.push_front(entry);
+  index_[key] = entries_.begin();
+  stats_.bytes_cached += bytes;
+  ++stats_.images_cached;
+}
+
+void ImageCache::OpenDiskFile() {
+  fd_ = open(disk_file_.c_str(), O_RDWR | O_CREAT, 0644);
+  CHECK_NE(fd_, -1) << "Can't open image cache file: " << disk_file_;
+  // Every writer appends at the end it knows of and truncates records it
+  // thinks are partial, so the file has a single user.
+  if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+    CHECK_EQ(errno, EWOULDBLOCK) << "Can't lock image cache file: "
+        << disk_file_;
+    LOG(WARNING) << "Image cache file " << disk_file_
+        << " is in use by another cache, caching in memory only";
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  struct stat st;
+  CHECK_EQ(fstat(fd_, &st), 0) << "Can't stat image cache file: "
+      << disk_file_;
+  const size_t file_size = st.st_size;
+  MapDiskFile(file_size);
+  // Rebuild the index. A record cut short by a crash ends the file.
+  while (disk_size_ + kRecordHeader <= file_size) {
+    uint32_t key_size;
+    memcpy(&key_size, map_ + disk_size_, sizeof(key_size));
+    const size_t image_offset = disk_size_ + kRecordHeader + key_size;
+    if (image_offset + kImageHeader > file_size) {
+      break;
+    }
+    int32_t header[3];
+    memcpy(header, map_ + image_offset, kImageHeader);
+    if (header[0] <= 0 || header[1] <= 0) {
+      break;
+    }
+    const size_t end = image_offset + kImageHeader
+        + static_cast<size_t>(header[0]) * header[1]
+            * CV_ELEM_SIZE(header[2]);
+    if (end > file_size) {
+      break;
+    }
+    disk_index_[std::string(map_ + disk_size_ + kRecordHeader, key_size)] =
+        disk_size_;
+    disk_size_ = end;
+  }
+  if (disk_size_ < file_size) {
+    LOG(WARNING) << "Dropping " << file_size - disk_size_
+        << " bytes of a partial record from " << disk_file_;
+    CHECK_EQ(ftruncate(fd_, disk_size_), 0);
+  }
+  LOG(INFO) << "Opened image cache " << disk_file_ << " with "
+      << disk_index_.size() << " images";
+}
+
+void ImageCache::MapDiskFile(const size_t size) {
+  if (size <= map_size_) {
+    return;
+  }
+  if (map_) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+  }
+  // Doubling keeps the remaps of a growing file logarithmic. The mapping
+  // may run past the end of the file, which is never read.
+  map_size_ = std::max(size, 2 * map_size_);
+  void* map = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+  CHECK(map != MAP_FAILED) << "Can't map image cache file: " << disk_file_;
+  map_ = static_cast<char*>(map);
+}
+
+bool ImageCache::ReadFromDisk(const std::string& key, cv::Mat* image) {
+  std::map<std::string, size_t>::const_iterator it = disk_index_.find(key);
+  if (it == disk_index_.end()) {
+    return false;
+  }
+  const char* record = map_ + it->second + kRecordHeader + key.size();
+  int32_t header[3];
+  memcpy(header, record, kImageHeader);
+  // Copied out, as the mapping moves when the file grows.
+  *image = cv::Mat(header[0], header[1], header[2],
+      const_cast<char*>(record + kImageHeader)).clone();
+  return true;
+}
+
+void ImageCache::AppendToDisk(const std::string& key, const cv::Mat& image) {
+  const cv::Mat pixels = image.isContinuous() ? image : image.clone();
+  const uint32_t key_size = key.size();
+  const int32_t header[3] = { pixels.rows, pixels.cols, pixels.type() };
+  const size_t bytes = ImageBytes(pixels);
+  std::string record(kRecordHeader + key_size + kImageHeader + bytes, '\0');
+  char* out = &record[0];
+  memcpy(out, &key_size, kRecordHeader);
+  memcpy(out + kRecordHeader, key.data(), key_size);
+  memcpy(out + kRecordHeader + key_size, header, kImageHeader);
+  memcpy(out + kRecordHeader + key_size + kImageHeader, pixels.data, bytes);
+  size_t written = 0;
+  while (written < record.size()) {
+    const ssize_t n = pwrite(fd_, out + written, record.size() - written,
+        disk_size_ + written);
+    CHECK_GT(n, 0) << "Can't write image cache file: " << disk_file_;
+    written += n;
+  }
+  disk_index_[key] = disk_size_;
+  disk_size_ += record.size();
+  MapDiskFile(disk_size_);
+}
+
+}  // namespace caffe
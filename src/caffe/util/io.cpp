@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <fcntl.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
@@ -67,10 +68,103 @@ void WriteProtoToBinaryFile(const Message& proto, const char* filename) {
   CHECK(proto.SerializeToOstream(&output));
 }
 
+// Reduced decoding flags came with OpenCV 3. CV_VERSION_MAJOR is the minor
+// version on OpenCV 2.x, where CV_VERSION_EPOCH is the major one.
+#if CV_MAJOR_VERSION >= 3
+// Reads the size of a JPEG from the frame header, without decoding it.
+// Returns false if the file isn't a JPEG.
+static bool ReadJPEGSize(const string& filename, int* height, int* width) {
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  unsigned char bytes[7];
+  if (!file.read(reinterpret_cast<char*>(bytes), 2) || bytes[0] != 0xFF
+      || bytes[1] != 0xD8) {
+    return false;
+  }
+  while (file.read(reinterpret_cast<char*>(bytes), 1)) {
+    if (bytes[0] != 0xFF) {
+      return false;
+    }
+    // Markers may be padded with any number of 0xFF.
+    unsigned char marker = 0xFF;
+    while (marker == 0xFF) {
+      if (!file.read(reinterpret_cast<char*>(&marker), 1)) {
+        return false;
+      }
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      continue;  // no payload
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      return false;  // end of image or start of scan before any frame
+    }
+    if (!file.read(reinterpret_cast<char*>(bytes), 2)) {
+      return false;
+    }
+    const int length = (bytes[0] << 8) | bytes[1];
+    if (length < 2) {
+      return false;
+    }
+    // Start of frame markers, except DHT (C4), JPG (C8) and DAC (CC).
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8
+        && marker != 0xCC) {
+      // Precision, then height and width.
+      if (length < 7 || !file.read(reinterpret_cast<char*>(bytes), 5)) {
+        return false;
+      }
+      *height = (bytes[1] << 8) | bytes[2];
+      *width = (bytes[3] << 8) | bytes[4];
+      return *height > 0 && *width > 0;
+    }
+    file.seekg(length - 2, std::ios::cur);
+  }
+  return false;
+}
+
+// The largest of the 1/2, 1/4 and 1/8 scales libjpeg can decode a JPEG at,
+// through DCT scaling, that is still at least height x width, or 1. The
+// image may be rotated by its EXIF orientation after decoding, so its
+// shorter side must cover the longer target side.
+static int ReducedDecodeScale(const string& filename, const int height,
+    const int width) {
+  int jpeg_height, jpeg_width;
+  if (!ReadJPEGSize(filename, &jpeg_height, &jpeg_width)) {
+    return 1;
+  }
+  const int jpeg_side = std::min(jpeg_height, jpeg_width);
+  const int side = std::max(height, width);
+  int scale = 1;
+  // libjpeg rounds scaled sizes up.
+  while (scale < 8 && (jpeg_side + 2 * scale - 1) / (2 * scale) >= side) {
+    scale *= 2;
+  }
+  return scale;
+}
+#endif
+
 cv::Mat ReadImageToCVMat(const string& filename, const int height,
     const int width, const bool is_color) {
   cv::Mat cv_img;
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+#if CV_MAJOR_VERSION >= 3
+  // Decoding a JPEG at a fraction of its size skips most of the work of
+  // decoding it whole just to shrink it.
+  if (height > 0 && width > 0) {
+    switch (ReducedDecodeScale(filename, height, width)) {
+    case 2:
+      cv_read_flag = (is_color ? cv::IMREAD_REDUCED_COLOR_2 :
+          cv::IMREAD_REDUCED_GRAYSCALE_2);
+      break;
+    case 4:
+      cv_read_flag = (is_color ? cv::IMREAD_REDUCED_COLOR_4 :
+          cv::IMREAD_REDUCED_GRAYSCALE_4);
+      break;
+    case 8:
+      cv_read_flag = (is_color ? cv::IMREAD_REDUCED_COLOR_8 :
+          cv::IMREAD_REDUCED_GRAYSCALE_8);
+      break;
+    }
+  }
+#endif
   cv::Mat cv_img_origin = cv::imread(filename, cv_read_flag);
   if (!cv_img_origin.data) {
     LOG(ERROR) << "Could not open or find file " << filename;
@@ -223,10 +317,22 @@ void CVMatToDatum(const cv::Mat& cv_img, Datum* datum) {
   datum->set_data(buffer);
 }
 
+// Recursive so that a caller holding the lock can use the helpers.
+static boost::recursive_mutex hdf5_mutex_;
+
+HDF5Lock::HDF5Lock() {
+  hdf5_mutex_.lock();
+}
+
+HDF5Lock::~HDF5Lock() {
+  hdf5_mutex_.unlock();
+}
+
 // Verifies format of data stored in HDF5 file and reshapes blob accordingly.
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(hid_t file_id, const char* dataset_name_,
     int min_dim, int max_dim, Blob<Dtype>* blob) {
+  HDF5Lock lock;
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -256,6 +362,7 @@ void hdf5_load_nd_dataset_helper(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
     int min_dim, int max_dim, Blob<float>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_float(file_id, dataset_name_,
       blob->mutable_cpu_data());
@@ -265,15 +372,84 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
     int min_dim, int max_dim, Blob<double>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_double(file_id, dataset_name_,
       blob->mutable_cpu_data());
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+hsize_t hdf5_get_num_rows(hid_t file_id, const char* dataset_name_) {
+  HDF5Lock lock;
+  CHECK(H5LTfind_dataset(file_id, dataset_name_))
+      << "Failed to find HDF5 dataset " << dataset_name_;
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(file_id, dataset_name_, &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name_;
+  CHECK_GE(ndims, 1);
+  std::vector < hsize_t > dims(ndims);
+  status = H5LTget_dataset_info(file_id, dataset_name_, dims.data(), NULL,
+      NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name_;
+  return dims[0];
+}
+
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(hid_t file_id, const char* dataset_name_,
+    int min_dim, int max_dim, hsize_t start_row, hsize_t num_rows,
+    vector<int>* shape, vector<Dtype>* data) {
+  HDF5Lock lock;
+  CHECK(H5LTfind_dataset(file_id, dataset_name_))
+      << "Failed to find HDF5 dataset " << dataset_name_;
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t type = H5Dget_type(dataset);
+  CHECK_EQ(H5Tget_class(type), H5T_FLOAT) << "Expected float or double data";
+  H5Tclose(type);
+
+  hid_t file_space = H5Dget_space(dataset);
+  const int ndims = H5Sget_simple_extent_ndims(file_space);
+  CHECK_GE(ndims, min_dim);
+  CHECK_LE(ndims, max_dim);
+  std::vector < hsize_t > dims(ndims);
+  H5Sget_simple_extent_dims(file_space, dims.data(), NULL);
+  CHECK_LE(start_row + num_rows, dims[0]) << "Rows out of range in "
+      << dataset_name_;
+
+  std::vector < hsize_t > offset(ndims, 0);
+  offset[0] = start_row;
+  dims[0] = num_rows;
+  shape->resize(ndims);
+  size_t count = 1;
+  for (int i = 0; i < ndims; ++i) {
+    (*shape)[i] = dims[i];
+    count *= dims[i];
+  }
+  data->resize(count);
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      offset.data(), NULL, dims.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(ndims, dims.data(), NULL);
+  status = H5Dread(dataset,
+      sizeof(Dtype) == sizeof(float) ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE,
+      mem_space, file_space, H5P_DEFAULT, data->data());
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+}
+
+template void hdf5_load_nd_dataset_rows<float>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start_row,
+    hsize_t num_rows, vector<int>* shape, vector<float>* data);
+template void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start_row,
+    hsize_t num_rows, vector<int>* shape, vector<double>* data);
+
 template <>
 void hdf5_save_nd_dataset<float>(const hid_t file_id,
     const string& dataset_name, const Blob<float>& blob) {
+  HDF5Lock lock;
   hsize_t dims[HDF5_NUM_DIMS];
   dims[0] = blob.num();
   dims[1] = blob.channels();
@@ -287,6 +463,7 @@ void hdf5_save_nd_dataset<float>(const hid_t file_id,
 template <>
 void hdf5_save_nd_dataset<double>(const hid_t file_id,
     const string& dataset_name, const Blob<double>& blob) {
+  HDF5Lock lock;
   hsize_t dims[HDF5_NUM_DIMS];
   dims[0] = blob.num();
   dims[1] = blob.channels();
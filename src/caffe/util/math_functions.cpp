@@ -24,14 +24,18 @@
  * POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************************/
 
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
 #include <limits>
+#include <numeric>
 
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/trace.hpp"
 #include "caffe/util/ocl_util.hpp"
 #include "caffe/util/ocl_wrapper.hpp"
 
@@ -40,6 +44,149 @@ static const clblasOrder order = clblasColumnMajor;
 
 namespace caffe {
 
+// Element-wise CPU functions split arrays of at least twice
+// Caffe::cpu_grain() elements over the Caffe::cpu_thread_pool(). Smaller
+// arrays, and any call made while the pool is busy, run on the caller.
+static inline ThreadPool* caffe_cpu_pool(const int n) {
+  ThreadPool* pool = Caffe::cpu_thread_pool();
+  return (pool && n >= 2 * Caffe::cpu_grain()) ? pool : NULL;
+}
+
+template <typename RangeOp>
+static void caffe_cpu_parallel(const int n, RangeOp op) {
+  ThreadPool* pool = caffe_cpu_pool(n);
+  if (pool) {
+    pool->ParallelFor(n, Caffe::cpu_grain(), op);
+  } else {
+    int begin = 0;
+    int end = n;
+    op(begin, end);
+  }
+}
+
+// Reductions keep one partial result per chunk and add them up in chunk
+// order, so the result does not depend on thread scheduling.
+template <typename Dtype, typename ChunkOp>
+static Dtype caffe_cpu_parallel_sum(const int n, ChunkOp op) {
+  ThreadPool* pool = caffe_cpu_pool(n);
+  vector<Dtype> partial(pool ? pool->NumChunks(n, Caffe::cpu_grain()) : 1);
+  if (pool) {
+    pool->ParallelForChunks(n, Caffe::cpu_grain(),
+        boost::bind(op, &partial[0], _1, _2, _3));
+  } else {
+    Dtype* out = &partial[0];
+    int chunk = 0;
+    int begin = 0;
+    int end = n;
+    op(out, chunk, begin, end);
+  }
+  return std::accumulate(partial.begin(), partial.end(), Dtype(0));
+}
+
+template <typename Dtype>
+static void unary_range(void (*f)(const int, const Dtype*, Dtype*),
+    const Dtype* a, Dtype* y, int begin, int end) {
+  f(end - begin, a + begin, y + begin);
+}
+
+template <typename Dtype>
+static void caffe_cpu_unary(void (*f)(const int, const Dtype*, Dtype*),
+    const int n, const Dtype* a, Dtype* y) {
+  caffe_cpu_parallel(n, boost::bind(&unary_range<Dtype>, f, a, y, _1, _2));
+}
+
+template <typename Dtype, typename Param>
+static void unary_param_range(
+    void (*f)(const int, const Dtype*, const Param, Dtype*),
+    const Dtype* a, const Param b, Dtype* y, int begin, int end) {
+  f(end - begin, a + begin, b, y + begin);
+}
+
+template <typename Dtype, typename Param>
+static void caffe_cpu_unary_param(
+    void (*f)(const int, const Dtype*, const Param, Dtype*),
+    const int n, const Dtype* a, const Dtype b, Dtype* y) {
+  caffe_cpu_parallel(n, boost::bind(&unary_param_range<Dtype, Param>, f, a,
+      Param(b), y, _1, _2));
+}
+
+template <typename Dtype>
+static void binary_range(
+    void (*f)(const int, const Dtype*, const Dtype*, Dtype*),
+    const Dtype* a, const Dtype* b, Dtype* y, int begin, int end) {
+  f(end - begin, a + begin, b + begin, y + begin);
+}
+
+template <typename Dtype>
+static void caffe_cpu_binary(
+    void (*f)(const int, const Dtype*, const Dtype*, Dtype*),
+    const int n, const Dtype* a, const Dtype* b, Dtype* y) {
+  caffe_cpu_parallel(n, boost::bind(&binary_range<Dtype>, f, a, b, y,
+      _1, _2));
+}
+
+template <typename Dtype>
+static void axpy_range(
+    void (*f)(const int, const Dtype, const Dtype*, const int, Dtype*,
+        const int),
+    const Dtype alpha, const Dtype* X, Dtype* Y, int begin, int end) {
+  f(end - begin, alpha, X + begin, 1, Y + begin, 1);
+}
+
+template <typename Dtype>
+static void axpby_range(
+    void (*f)(const int, const Dtype, const Dtype*, const int, const Dtype,
+        Dtype*, const int),
+    const Dtype alpha, const Dtype* X, const Dtype beta, Dtype* Y, int begin,
+    int end) {
+  f(end - begin, alpha, X + begin, 1, beta, Y + begin, 1);
+}
+
+template <typename Dtype>
+static void scal_range(void (*f)(const int, const Dtype, Dtype*, const int),
+    const Dtype alpha, Dtype* X, int begin, int end) {
+  f(end - begin, alpha, X + begin, 1);
+}
+
+template <typename Dtype>
+static void set_range(const Dtype alpha, Dtype* Y, int begin, int end) {
+  if (alpha == 0) {
+    // NOLINT_NEXT_LINE(caffe/alt_fn)
+    memset(Y + begin, 0, sizeof(Dtype) * (end - begin));
+    return;
+  }
+  for (int i = begin; i < end; ++i) {
+    Y[i] = alpha;
+  }
+}
+
+template <typename Dtype>
+static void add_scalar_range(const Dtype alpha, Dtype* Y, int begin,
+    int end) {
+  for (int i = begin; i < end; ++i) {
+    Y[i] += alpha;
+  }
+}
+
+template <typename Dtype>
+static void copy_range(const Dtype* X, Dtype* Y, int begin, int end) {
+  // NOLINT_NEXT_LINE(caffe/alt_fn)
+  memcpy(Y + begin, X + begin, sizeof(Dtype) * (end - begin));
+}
+
+template <typename Dtype>
+static void dot_chunk(const Dtype* x, const Dtype* y, Dtype* partial,
+    int chunk, int begin, int end) {
+  partial[chunk] = caffe_cpu_strided_dot(end - begin, x + begin, 1,
+      y + begin, 1);
+}
+
+template <typename Dtype>
+static void asum_chunk(Dtype (*f)(const int, const Dtype*, const int),
+    const Dtype* x, Dtype* partial, int chunk, int begin, int end) {
+  partial[chunk] = f(end - begin, x + begin, 1);
+}
+
 template <>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -79,35 +226,25 @@ void caffe_cpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
 template <>
 void caffe_axpy<float>(const int N, const float alpha, const float* X,
     float* Y) {
-  cblas_saxpy(N, alpha, X, 1, Y, 1);
+  caffe_cpu_parallel(N, boost::bind(&axpy_range<float>, &cblas_saxpy, alpha,
+      X, Y, _1, _2));
 }
 
 template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
     double* Y) {
-  cblas_daxpy(N, alpha, X, 1, Y, 1);
+  caffe_cpu_parallel(N, boost::bind(&axpy_range<double>, &cblas_daxpy, alpha,
+      X, Y, _1, _2));
 }
 
 template <>
 void caffe_set(const int N, const float alpha, float* Y) {
-  if (alpha == 0) {
-    memset(Y, 0, sizeof(float) * N);
-    return;
-  }
-  for (int i = 0; i < N; ++i) {
-    Y[i] = alpha;
-  }
+  caffe_cpu_parallel(N, boost::bind(&set_range<float>, alpha, Y, _1, _2));
 }
 
 template <>
 void caffe_set(const int N, const double alpha, double* Y) {
-  if (alpha == 0) {
-    memset(Y, 0, sizeof(double) * N);
-    return;
-  }
-  for (int i = 0; i < N; ++i) {
-    Y[i] = alpha;
-  }
+  caffe_cpu_parallel(N, boost::bind(&set_range<double>, alpha, Y, _1, _2));
 }
 
 /*
@@ -123,71 +260,73 @@ void caffe_copy<double>(const int N, const double* X, double* Y) {
 */
 template <>
 void caffe_add_scalar(const int N, const float alpha, float* Y) {
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  caffe_cpu_parallel(N, boost::bind(&add_scalar_range<float>, alpha, Y,
+      _1, _2));
 }
 
 template <>
 void caffe_add_scalar(const int N, const double alpha, double* Y) {
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  caffe_cpu_parallel(N, boost::bind(&add_scalar_range<double>, alpha, Y,
+      _1, _2));
 }
 
 template <>
 void caffe_scal<float>(const int N, const float alpha, float *X) {
-  cblas_sscal(N, alpha, X, 1);
+  caffe_cpu_parallel(N, boost::bind(&scal_range<float>, &cblas_sscal, alpha, X,
+      _1, _2));
 }
 
 template <>
 void caffe_scal<double>(const int N, const double alpha, double *X) {
-  cblas_dscal(N, alpha, X, 1);
+  caffe_cpu_parallel(N, boost::bind(&scal_range<double>, &cblas_dscal, alpha, X,
+      _1, _2));
 }
 
 template <>
 void caffe_cpu_axpby<float>(const int N, const float alpha, const float* X,
     const float beta, float* Y) {
-  cblas_saxpby(N, alpha, X, 1, beta, Y, 1);
+  caffe_cpu_parallel(N, boost::bind(&axpby_range<float>, &cblas_saxpby, alpha,
+      X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_cpu_axpby<double>(const int N, const double alpha, const double* X,
     const double beta, double* Y) {
-  cblas_daxpby(N, alpha, X, 1, beta, Y, 1);
+  caffe_cpu_parallel(N, boost::bind(&axpby_range<double>, &cblas_daxpby,
+      alpha, X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b, float* y) {
-  vsAdd(n, a, b, y);
+  caffe_cpu_binary(&vsAdd, n, a, b, y);
 }
 
 template <>
 void caffe_add<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdAdd(n, a, b, y);
+  caffe_cpu_binary(&vdAdd, n, a, b, y);
 }
 
 template <>
 void caffe_sub<float>(const int n, const float* a, const float* b, float* y) {
-  vsSub(n, a, b, y);
+  caffe_cpu_binary(&vsSub, n, a, b, y);
 }
 
 template <>
 void caffe_sub<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdSub(n, a, b, y);
+  caffe_cpu_binary(&vdSub, n, a, b, y);
 }
 
 template <>
 void caffe_mul<float>(const int n, const float* a, const float* b, float* y) {
-  vsMul(n, a, b, y);
+  caffe_cpu_binary(&vsMul, n, a, b, y);
 }
 
 template <>
 void caffe_mul<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdMul(n, a, b, y);
+  caffe_cpu_binary(&vdMul, n, a, b, y);
 }
 
 template <>
@@ -204,13 +343,7 @@ double caffe_cpu_strided_dot<double>(const int n, const double* x,
 
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
-  if (alpha == 0) {
-    memset(Y, 0, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
-    return;
-  }
-  for (int i = 0; i < N; ++i) {
-	    Y[i] = alpha;
-  }
+  caffe_cpu_parallel(N, boost::bind(&set_range<Dtype>, alpha, Y, _1, _2));
 }
 
 template void caffe_set<int>(const int N, const int alpha, int* Y);
@@ -219,18 +352,18 @@ template void caffe_set<double>(const int N, const double alpha, double* Y);
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
-  vsLn(n, a, y);
+  caffe_cpu_unary(&vsLn, n, a, y);
 }
 
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
-  vdLn(n, a, y);
+  caffe_cpu_unary(&vdLn, n, a, y);
 }
 
 template <typename Dtype>
 void caffe_copy(const int N, const Dtype* X, Dtype* Y) {
   if (X != Y) {
-      memcpy(Y, X, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
+    caffe_cpu_parallel(N, boost::bind(&copy_range<Dtype>, X, Y, _1, _2));
   }
 }
 
@@ -242,54 +375,54 @@ template void caffe_copy<double>(const int N, const double* X, double* Y);
 
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
-  vsAbs(n, a, y);
+  caffe_cpu_unary(&vsAbs, n, a, y);
 }
 
 template <>
 void caffe_abs<double>(const int n, const double* a, double* y) {
-  vdAbs(n, a, y);
+  caffe_cpu_unary(&vdAbs, n, a, y);
 }
 
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b, float* y) {
-  vsDiv(n, a, b, y);
+  caffe_cpu_binary(&vsDiv, n, a, b, y);
 }
 
 template <>
 void caffe_div<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdDiv(n, a, b, y);
+  caffe_cpu_binary(&vdDiv, n, a, b, y);
 }
 
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b, float* y) {
-  vsPowx(n, a, b, y);
+  caffe_cpu_unary_param(&vsPowx, n, a, b, y);
 }
 
 template <>
 void caffe_powx<double>(const int n, const double* a, const double b,
     double* y) {
-  vdPowx(n, a, b, y);
+  caffe_cpu_unary_param(&vdPowx, n, a, b, y);
 }
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
-  vsSqr(n, a, y);
+  caffe_cpu_unary(&vsSqr, n, a, y);
 }
 
 template <>
 void caffe_sqr<double>(const int n, const double* a, double* y) {
-  vdSqr(n, a, y);
+  caffe_cpu_unary(&vdSqr, n, a, y);
 }
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
-  vsExp(n, a, y);
+  caffe_cpu_unary(&vsExp, n, a, y);
 }
 
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
-  vdExp(n, a, y);
+  caffe_cpu_unary(&vdExp, n, a, y);
 }
 
 unsigned int caffe_rng_rand() {
@@ -380,12 +513,14 @@ template void caffe_rng_bernoulli<float>(const int n, const float p, unsigned in
 
 template <>
 float caffe_cpu_dot<float>(const int n, const float* x, const float* y) {
-  return cblas_sdot(n, x, 1, y, 1);
+  return caffe_cpu_parallel_sum<float>(n, boost::bind(&dot_chunk<float>, x, y,
+      _1, _2, _3, _4));
 }
 
 template <>
 double caffe_cpu_dot<double>(const int n, const double* x, const double* y) {
-  return cblas_ddot(n, x, 1, y, 1);
+  return caffe_cpu_parallel_sum<double>(n, boost::bind(&dot_chunk<double>, x,
+      y, _1, _2, _3, _4));
 }
 
 template <>
@@ -412,12 +547,14 @@ int caffe_cpu_hamming_distance<double>(const int n, const double* x,
 
 template <>
 float caffe_cpu_asum<float>(const int n, const float* x) {
-  return cblas_sasum(n, x, 1);
+  return caffe_cpu_parallel_sum<float>(n, boost::bind(&asum_chunk<float>,
+      &cblas_sasum, x, _1, _2, _3, _4));
 }
 
 template <>
 double caffe_cpu_asum<double>(const int n, const double* x) {
-  return cblas_dasum(n, x, 1);
+  return caffe_cpu_parallel_sum<double>(n, boost::bind(&asum_chunk<double>,
+      &cblas_dasum, x, _1, _2, _3, _4));
 }
 
 INSTANTIATE_CAFFE_CPU_UNARY_FUNC (sign);
@@ -443,11 +580,21 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
 //  - (x[index] < Dtype(0)));
 //DEFINE_AND_INSTANTIATE_GPU_UNARY_FUNC(sgnbit, y[index] = signbit(x[index]));
 
+// Records a clBLAS call whose event was asked for through
+// Tracer::event_out, and releases the event.
+static void TraceBlasEvent(const char* name, cl_event event) {
+  if (event) {
+    Tracer::Get().AddDeviceEvent(name, "kernel", event);
+    OCL_CHECK(clReleaseEvent(event));
+  }
+}
+
 template <>
 void caffe_gpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
     const float alpha, const float* A, const float* B, const float beta,
     float* C) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   clblasTranspose transB =
@@ -458,7 +605,9 @@ void caffe_gpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
   CLBLAS_CHECK(
       clblasSgemm(amdDevice.col, transB, transA, N, M, K, (cl_float) alpha,
           (cl_mem) B, 0, ldb, (cl_mem) A, 0, lda, (cl_float) beta, (cl_mem) C,
-          0, ldc, 1, &(amdDevice.CommandQueue), 0, NULL, NULL));
+          0, ldc, 1, &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemm", event);
 }
 
 template <>
@@ -466,6 +615,7 @@ void caffe_gpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
     const double alpha, const double* A, const double* B, const double beta,
     double* C) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   clblasTranspose transB =
@@ -476,7 +626,9 @@ void caffe_gpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
   CLBLAS_CHECK(
       clblasDgemm(amdDevice.col, transB, transA, N, M, K,  alpha,
           (cl_mem) B, 0, ldb, (cl_mem) A, 0, lda,  beta, (cl_mem) C,
-          0, ldc, 1, &(amdDevice.CommandQueue), 0, NULL, NULL));
+          0, ldc, 1, &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemm", event);
 }
 
 template <>
@@ -497,6 +649,7 @@ cl_event caffe_gpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
           (cl_mem) B, offB, ldb, (cl_mem) A, offA, lda, (cl_float) beta,
           (cl_mem) C, offC, ldc, 1, &(amdDevice.CommandQueue), 0, NULL,
           &event));
+  Tracer::Get().AddDeviceEvent("gemm", "kernel", event);
   return event;
 }
 
@@ -518,6 +671,7 @@ cl_event caffe_gpu_gemm<double>(const CBLAS_TRANSPOSE TransA,
           (cl_mem) B, offB, ldb, (cl_mem) A, offA, lda, beta,
           (cl_mem) C, offC, ldc, 1, &(amdDevice.CommandQueue), 0, NULL,
           &event));
+  Tracer::Get().AddDeviceEvent("gemm", "kernel", event);
   return event;
 }
 
@@ -539,6 +693,7 @@ cl_event caffe_gpu_gemm<float>(cl_command_queue *queue,
       clblasSgemm(amdDevice.col, transB, transA, N, M, K, (cl_float) alpha,
           (cl_mem) B, offB, ldb, (cl_mem) A, offA, lda, (cl_float) beta,
           (cl_mem) C, offC, ldc, 1, queue, 0, NULL, &event));
+  Tracer::Get().AddDeviceEvent("gemm", "kernel", event);
   return event;
 }
 
@@ -560,6 +715,7 @@ cl_event caffe_gpu_gemm<double>(cl_command_queue *queue,
       clblasDgemm(amdDevice.col, transB, transA, N, M, K,  alpha,
           (cl_mem) B, offB, ldb, (cl_mem) A, offA, lda, beta,
           (cl_mem) C, offC, ldc, 1, queue, 0, NULL, &event));
+  Tracer::Get().AddDeviceEvent("gemm", "kernel", event);
   return event;
 }
 
@@ -568,12 +724,15 @@ void caffe_gpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, size_t offA, int lda,
     const float* x, size_t offx, const float beta, int incx, float* y,
     size_t offy, int incy) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   CLBLAS_CHECK(
       clblasSgemv(amdDevice.row, transA, M, N, (cl_float) alpha, (cl_mem) A,
           offA, lda, (cl_mem) x, offx, incx, (cl_float) beta, (cl_mem) y, offy,
-          incy, 1, &(amdDevice.CommandQueue), 0, NULL, NULL));
+          incy, 1, &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemv", event);
 }
 
 template <>
@@ -581,36 +740,45 @@ void caffe_gpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const double alpha, const double* A, size_t offA, int lda,
     const double* x, size_t offx, const double beta, int incx, double* y,
     size_t offy, int incy) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   CLBLAS_CHECK(
       clblasDgemv(amdDevice.row, transA, M, N, (cl_double) alpha, (cl_mem) A,
           offA, lda, (cl_mem) x, offx, incx, (cl_double) beta, (cl_mem) y, offy,
-          incy, 1, &(amdDevice.CommandQueue), 0, NULL, NULL));
+          incy, 1, &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemv", event);
 }
 
 template <>
 void caffe_gpu_gemv<float>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const float alpha, const float* A, const float* x,
     const float beta, float* y) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   CLBLAS_CHECK(
       clblasSgemv(amdDevice.row, transA, M, N, (cl_float) alpha, (cl_mem) A, 0,
           N, (cl_mem) x, 0, 1, (cl_float) beta, (cl_mem) y, 0, 1, 1,
-          &(amdDevice.CommandQueue), 0, NULL, NULL));
+          &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemv", event);
 }
 
 template <>
 void caffe_gpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
     const int N, const double alpha, const double* A, const double* x,
     const double beta, double* y) {
+  cl_event event;
   clblasTranspose transA =
       (TransA == CblasNoTrans) ? clblasNoTrans : clblasTrans;
   CLBLAS_CHECK(
       clblasDgemv(amdDevice.row, transA, M, N, (cl_double) alpha, (cl_mem) A, 0,
           N, (cl_mem) x, 0, 1, (cl_double) beta, (cl_mem) y, 0, 1, 1,
-          &(amdDevice.CommandQueue), 0, NULL, NULL));
+          &(amdDevice.CommandQueue), 0, NULL,
+          Tracer::Get().event_out(&event)));
+  TraceBlasEvent("gemv", event);
 }
 
 template <>
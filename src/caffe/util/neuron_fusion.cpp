@@ -0,0 +1,264 @@
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/device.hpp"
+#include "caffe/util/neuron_fusion.hpp"
+#include "caffe/util/trace.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+// Must match BNLLLayer.
+static const float kBNLL_THRESHOLD = 50.;
+
+// A literal of the kernel's Dtype, exact up to the precision of Dtype.
+template <typename Dtype>
+static std::string Literal(const double value) {
+  std::ostringstream literal;
+  const bool is_float = sizeof(Dtype) == sizeof(float);
+  literal << std::scientific
+      << std::setprecision(std::numeric_limits<Dtype>::digits10 + 2)
+      << (is_float ? (float) value : value) << (is_float ? "f" : "");
+  return "(" + literal.str() + ")";
+}
+
+static void ReplaceAll(std::string* str, const std::string& from,
+    const std::string& to) {
+  size_t pos = 0;
+  while ((pos = str->find(from, pos)) != std::string::npos) {
+    str->replace(pos, from.size(), to);
+    pos += to.size();
+  }
+}
+
+// The output of a layer as an expression of its input $x, and the
+// derivative of the output as an expression of $x and the output $y.
+// Returns false for layers that can't be fused.
+template <typename Dtype>
+static bool ElementwiseCode(const LayerParameter& param, std::string* forward,
+    std::string* backward) {
+  const std::string& type = param.type();
+  if (type == "ReLU") {
+    const std::string slope = Literal<Dtype>(
+        param.relu_param().negative_slope());
+    *forward = "($x > 0 ? $x : $x * " + slope + ")";
+    *backward = "($x > 0 ? " + Literal<Dtype>(1) + " : " + slope + ")";
+  } else if (type == "Sigmoid") {
+    *forward = "(1 / (1 + exp(-$x)))";
+    *backward = "($y * (1 - $y))";
+  } else if (type == "TanH") {
+    *forward = "tanh($x)";
+    *backward = "(1 - $y * $y)";
+  } else if (type == "AbsVal") {
+    *forward = "fabs($x)";
+    *backward = "(($x > 0) - ($x < 0))";
+  } else if (type == "BNLL") {
+    const std::string clipped = "exp(fmin($x, "
+        + Literal<Dtype>(kBNLL_THRESHOLD) + "))";
+    *forward = "($x > 0 ? $x + log(1 + exp(-$x)) : log(1 + exp($x)))";
+    *backward = "(" + clipped + " / (" + clipped + " + 1))";
+  } else if (type == "Power") {
+    const double power = param.power_param().power();
+    const double scale = param.power_param().scale();
+    const std::string input = "(" + Literal<Dtype>(scale) + " * $x + "
+        + Literal<Dtype>(param.power_param().shift()) + ")";
+    if (power == 0) {
+      *forward = Literal<Dtype>(1);
+      *backward = Literal<Dtype>(0);
+    } else if (power == 1) {
+      *forward = input;
+      *backward = Literal<Dtype>(scale);
+    } else if (power == 2) {
+      *forward = "(" + input + " * " + input + ")";
+      *backward = "(" + Literal<Dtype>(2 * scale) + " * " + input + ")";
+    } else {
+      *forward = "pow(" + input + ", " + Literal<Dtype>(power) + ")";
+      *backward = "(" + Literal<Dtype>(power * scale) + " * pow(" + input
+          + ", " + Literal<Dtype>(power - 1) + "))";
+    }
+  } else if (type == "Exp") {
+    // See ExpLayer::LayerSetUp.
+    const double base = param.exp_param().base();
+    const double shift = param.exp_param().shift();
+    const double log_base = (base == -1) ? 1 : log(base);
+    const double inner_scale = log_base * param.exp_param().scale();
+    const double outer_scale =
+        (shift == 0) ? 1 : (base == -1 ? exp(shift) : pow(base, shift));
+    *forward = "(" + Literal<Dtype>(outer_scale) + " * exp("
+        + Literal<Dtype>(inner_scale) + " * $x))";
+    *backward = "(" + Literal<Dtype>(inner_scale) + " * $y)";
+  } else if (type == "Log") {
+    // See LogLayer::LayerSetUp.
+    const double base = param.log_param().base();
+    const double log_base = (base == -1) ? 1 : log(base);
+    const double input_scale = param.log_param().scale();
+    const std::string input = "(" + Literal<Dtype>(input_scale) + " * $x + "
+        + Literal<Dtype>(param.log_param().shift()) + ")";
+    *forward = "(" + Literal<Dtype>(1 / log_base) + " * log(" + input + "))";
+    *backward = "(" + Literal<Dtype>(input_scale / log_base) + " / " + input
+        + ")";
+  } else if (type == "Threshold") {
+    *forward = "($x > " + Literal<Dtype>(param.threshold_param().threshold())
+        + " ? " + Literal<Dtype>(1) + " : " + Literal<Dtype>(0) + ")";
+    backward->clear();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+template <typename Dtype>
+bool FusedNeuronChain<Dtype>::CanFuse(const LayerParameter& param,
+    const bool with_backward) {
+  if (param.bottom_size() != 1 || param.top_size() != 1) {
+    return false;
+  }
+  std::string forward, backward;
+  return ElementwiseCode<Dtype>(param, &forward, &backward)
+      && (!with_backward || !backward.empty());
+}
+
+// Appends the statements computing x1..xn from x0.
+static void AppendChain(const std::vector<std::string>& forward,
+    std::ostringstream* source) {
+  for (int i = 0; i < forward.size(); ++i) {
+    std::ostringstream x, y;
+    x << "x" << i;
+    y << "x" << i + 1;
+    std::string expression = forward[i];
+    ReplaceAll(&expression, "$x", x.str());
+    *source << "    const Dtype " << y.str() << " = " << expression << ";\n";
+  }
+}
+
+template <typename Dtype>
+FusedNeuronChain<Dtype>::FusedNeuronChain(
+    const std::vector<LayerParameter>& params, const bool with_backward)
+    : forward_kernel_(NULL), backward_kernel_(NULL) {
+  CHECK(!params.empty());
+  std::vector<std::string> forward(params.size());
+  std::vector<std::string> backward(params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    CHECK(CanFuse(params[i], with_backward)) << "Layer " << params[i].name()
+        << " of type " << params[i].type() << " can't be fused";
+    ElementwiseCode<Dtype>(params[i], &forward[i], &backward[i]);
+  }
+  const int n = params.size();
+  std::ostringstream source;
+  source << "typedef " << (sizeof(Dtype) == sizeof(float) ? "float" : "double")
+      << " Dtype;\n\n";
+  source << "__kernel void fused_neuron_forward(const int count,\n"
+      << "    __global const Dtype* in, __global Dtype* out) {\n"
+      << "  for (int index = get_global_id(0); index < count;\n"
+      << "      index += get_global_size(0)) {\n"
+      << "    const Dtype x0 = in[index];\n";
+  AppendChain(forward, &source);
+  source << "    out[index] = x" << n << ";\n  }\n}\n";
+  if (with_backward) {
+    source << "\n__kernel void fused_neuron_backward(const int count,\n"
+        << "    __global const Dtype* in, __global const Dtype* top_diff,\n"
+        << "    __global Dtype* bottom_diff) {\n"
+        << "  for (int index = get_global_id(0); index < count;\n"
+        << "      index += get_global_size(0)) {\n"
+        << "    const Dtype x0 = in[index];\n";
+    AppendChain(forward, &source);
+    source << "    Dtype diff = top_diff[index];\n";
+    for (int i = n - 1; i >= 0; --i) {
+      std::ostringstream x, y;
+      x << "x" << i;
+      y << "x" << i + 1;
+      std::string expression = backward[i];
+      ReplaceAll(&expression, "$x", x.str());
+      ReplaceAll(&expression, "$y", y.str());
+      source << "    diff *= " << expression << ";\n";
+    }
+    source << "    bottom_diff[index] = diff;\n  }\n}\n";
+  }
+  source_ = source.str();
+
+  cl_program program = amdDevice.BuildProgramFromSource(source_);
+  if (program == NULL) {
+    return;
+  }
+  cl_int err = CL_SUCCESS;
+  forward_kernel_ = clCreateKernel(program, "fused_neuron_forward", &err);
+  OCL_CHECK(err);
+  if (with_backward) {
+    backward_kernel_ = clCreateKernel(program, "fused_neuron_backward", &err);
+    OCL_CHECK(err);
+  }
+}
+
+template <typename Dtype>
+FusedNeuronChain<Dtype>::~FusedNeuronChain() {
+  if (forward_kernel_) {
+    clReleaseKernel(forward_kernel_);
+  }
+  if (backward_kernel_) {
+    clReleaseKernel(backward_kernel_);
+  }
+}
+
+static void EnqueueElementwise(cl_kernel kernel, const int count,
+    const std::string& trace_name) {
+  size_t Global_Work_Size[] = { (size_t) (count + 255) / 256 * 256 };
+  size_t Local_Work_Size[] = { 256 };
+  Tracer& tracer = Tracer::Get();
+  cl_event event;
+  OCL_CHECK(
+      clEnqueueNDRangeKernel(amdDevice.CommandQueue, kernel, 1, NULL,
+          Global_Work_Size, Local_Work_Size, 0, NULL,
+          tracer.event_out(&event)));
+  if (event) {
+    tracer.AddDeviceEvent(trace_name, "kernel", event);
+    OCL_CHECK(clReleaseEvent(event));
+  }
+}
+
+template <typename Dtype>
+void FusedNeuronChain<Dtype>::Forward_gpu(Blob<Dtype>* bottom,
+    Blob<Dtype>* top) {
+  CHECK(valid());
+  const int count = bottom->count();
+  CHECK_EQ(count, top->count());
+  const Dtype* bottom_data = bottom->gpu_data();
+  Dtype* top_data = top->mutable_gpu_data();
+  cl_int ret;
+  ret = clSetKernelArg(forward_kernel_, 0, sizeof(cl_int), (void*) &count);
+  ret |= clSetKernelArg(forward_kernel_, 1, sizeof(cl_mem),
+      (void*) &bottom_data);
+  ret |= clSetKernelArg(forward_kernel_, 2, sizeof(cl_mem), (void*) &top_data);
+  OCL_CHECK(ret);
+  EnqueueElementwise(forward_kernel_, count, "fused_neuron_forward");
+}
+
+template <typename Dtype>
+void FusedNeuronChain<Dtype>::Backward_gpu(Blob<Dtype>* top,
+    Blob<Dtype>* bottom) {
+  CHECK(backward_kernel_) << "Fused chain was built without backward";
+  const int count = bottom->count();
+  CHECK_EQ(count, top->count());
+  const Dtype* bottom_data = bottom->gpu_data();
+  const Dtype* top_diff = top->gpu_diff();
+  Dtype* bottom_diff = bottom->mutable_gpu_diff();
+  cl_int ret;
+  ret = clSetKernelArg(backward_kernel_, 0, sizeof(cl_int), (void*) &count);
+  ret |= clSetKernelArg(backward_kernel_, 1, sizeof(cl_mem),
+      (void*) &bottom_data);
+  ret |= clSetKernelArg(backward_kernel_, 2, sizeof(cl_mem),
+      (void*) &top_diff);
+  ret |= clSetKernelArg(backward_kernel_, 3, sizeof(cl_mem),
+      (void*) &bottom_diff);
+  OCL_CHECK(ret);
+  EnqueueElementwise(backward_kernel_, count, "fused_neuron_backward");
+}
+
+INSTANTIATE_CLASS (FusedNeuronChain);
+#endif  // CPU_ONLY
+
+}  // namespace caffe
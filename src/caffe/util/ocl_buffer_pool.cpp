@@ -0,0 +1,202 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <map>
+
+#include "caffe/common.hpp"
+#include "caffe/util/ocl_buffer_pool.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+// Smaller buffers share one bucket.
+static const size_t kMinBucketSize = 256;
+// Buckets per power of two; bounds the unused tail of a buffer to 1/8.
+static const size_t kBucketsPerOctave = 8;
+
+class BufferPool::sync {
+  public:
+    mutable boost::mutex mutex_;
+};
+
+BufferPool::BufferPool()
+    : sync_(new sync()), enabled_(true) {
+}
+
+BufferPool::~BufferPool() {
+  Trim();
+}
+
+size_t BufferPool::BucketSize(const size_t size) {
+  if (size <= kMinBucketSize) {
+    return kMinBucketSize;
+  }
+  size_t octave = kMinBucketSize;
+  while (octave <= size / 2) {
+    octave *= 2;
+  }
+  const size_t step = octave / kBucketsPerOctave;
+  return (size + step - 1) / step * step;
+}
+
+cl_mem BufferPool::AllocateDevice(const size_t size, cl_command_queue queue) {
+  return Allocate(&device_free_, size, queue, NULL);
+}
+
+void BufferPool::FreeDevice(cl_mem buffer, cl_command_queue queue) {
+  Free(&device_free_, buffer, NULL, queue);
+}
+
+cl_mem BufferPool::AllocateHost(const size_t size, void** host_ptr) {
+  CHECK(host_ptr);
+  return Allocate(&host_free_, size, amdDevice.CommandQueue_helper,
+      host_ptr);
+}
+
+void BufferPool::FreeHost(cl_mem buffer, void* host_ptr) {
+  CHECK(host_ptr);
+  Free(&host_free_, buffer, host_ptr, amdDevice.CommandQueue_helper);
+}
+
+cl_mem BufferPool::Allocate(FreeList* free_list, const size_t size,
+    cl_command_queue queue, void** host_ptr) {
+  const size_t bucket = BucketSize(size);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  FreeList::iterator it = free_list->lower_bound(bucket);
+  if (it != free_list->end() && it->first < 2 * bucket) {
+    const Entry entry = it->second;
+    ++stats_.hits;
+    stats_.bytes_cached -= it->first;
+    stats_.bytes_in_use += it->first;
+    free_list->erase(it);
+    lock.unlock();
+    if (entry.released) {
+      if (queue != entry.queue) {
+        OCL_CHECK(clWaitForEvents(1, &entry.released));
+      }
+      OCL_CHECK(clReleaseEvent(entry.released));
+    }
+    if (host_ptr) {
+      *host_ptr = entry.host_ptr;
+    }
+    return entry.buffer;
+  }
+  ++stats_.misses;
+  const size_t capacity = enabled_ ? bucket : size;
+  lock.unlock();
+
+  const cl_mem_flags flags =
+      host_ptr ? CL_MEM_ALLOC_HOST_PTR : CL_MEM_READ_WRITE;
+  cl_int err = CL_SUCCESS;
+  cl_mem buffer = clCreateBuffer(amdDevice.Context, flags, capacity, NULL,
+      &err);
+  if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES) {
+    // The cached buffers may be what the device is missing.
+    Trim();
+    buffer = clCreateBuffer(amdDevice.Context, flags, capacity, NULL, &err);
+  }
+  OCL_CHECK(err);
+  if (host_ptr) {
+    *host_ptr = clEnqueueMapBuffer(amdDevice.CommandQueue_helper, buffer,
+        CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, capacity, 0, NULL, NULL,
+        &err);
+    OCL_CHECK(err);
+  }
+
+  lock.lock();
+  stats_.bytes_in_use += capacity;
+  stats_.high_water = std::max(stats_.high_water,
+      stats_.bytes_in_use + stats_.bytes_cached);
+  return buffer;
+}
+
+void BufferPool::Free(FreeList* free_list, cl_mem buffer, void* host_ptr,
+    cl_command_queue queue) {
+  size_t capacity = 0;
+  OCL_CHECK(
+      clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(capacity), &capacity,
+          NULL));
+  Entry entry;
+  entry.buffer = buffer;
+  entry.host_ptr = host_ptr;
+  entry.released = NULL;
+  entry.queue = queue;
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  stats_.bytes_in_use -= capacity;
+  if (!enabled_) {
+    lock.unlock();
+    Release(entry);
+    return;
+  }
+  if (host_ptr == NULL) {
+    if (queue) {
+      OCL_CHECK(
+          clEnqueueMarkerWithWaitList(queue, 0, NULL, &entry.released));
+    } else {
+      entry.released = amdDevice.MarkAllQueues();
+    }
+  }
+  free_list->insert(std::make_pair(capacity, entry));
+  stats_.bytes_cached += capacity;
+}
+
+void BufferPool::Release(const Entry& entry) {
+  if (entry.host_ptr) {
+    OCL_CHECK(
+        clEnqueueUnmapMemObject(amdDevice.CommandQueue_helper, entry.buffer,
+            entry.host_ptr, 0, NULL, NULL));
+  }
+  if (entry.released) {
+    OCL_CHECK(clReleaseEvent(entry.released));
+  }
+  OCL_CHECK(clReleaseMemObject(entry.buffer));
+}
+
+void BufferPool::TrimLocked() {
+  FreeList* free_lists[] = { &device_free_, &host_free_ };
+  for (int i = 0; i < 2; ++i) {
+    for (FreeList::iterator it = free_lists[i]->begin();
+        it != free_lists[i]->end(); ++it) {
+      Release(it->second);
+    }
+    free_lists[i]->clear();
+  }
+  stats_.bytes_cached = 0;
+}
+
+void BufferPool::Trim() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  TrimLocked();
+}
+
+void BufferPool::set_enabled(const bool enabled) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  enabled_ = enabled;
+  if (!enabled) {
+    TrimLocked();
+  }
+}
+
+bool BufferPool::enabled() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return enabled_;
+}
+
+BufferPoolStats BufferPool::stats() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return stats_;
+}
+
+void BufferPool::ResetStats() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  const size_t bytes_cached = stats_.bytes_cached;
+  const size_t bytes_in_use = stats_.bytes_in_use;
+  stats_ = BufferPoolStats();
+  stats_.bytes_cached = bytes_cached;
+  stats_.bytes_in_use = bytes_in_use;
+  stats_.high_water = bytes_cached + bytes_in_use;
+}
+
+#endif  // CPU_ONLY
+
+}  // namespace caffe
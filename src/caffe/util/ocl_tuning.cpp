@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/ocl_tuning.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+static const int kMaxItemsPerThread = 16;
+
+std::vector<LaunchConfig> LaunchCandidates(const std::string& kernel_name,
+    const bool grid_stride) {
+  cl_kernel kernel = amdDevice.GetKernel(
+      amdDevice.RegisterKernel(kernel_name));
+  size_t max_local_size = 0;
+  size_t local_size_multiple = 0;
+  OCL_CHECK(
+      clGetKernelWorkGroupInfo(kernel, amdDevice.pDevices[0],
+          CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local_size),
+          &max_local_size, NULL));
+  OCL_CHECK(
+      clGetKernelWorkGroupInfo(kernel, amdDevice.pDevices[0],
+          CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+          sizeof(local_size_multiple), &local_size_multiple, NULL));
+  size_t min_local_size = 1;
+  while (min_local_size < local_size_multiple) {
+    min_local_size *= 2;
+  }
+  min_local_size = std::min(min_local_size, std::max<size_t>(
+      max_local_size, 1));
+  std::vector<LaunchConfig> candidates;
+  for (size_t local_size = min_local_size; local_size <= max_local_size;
+      local_size *= 2) {
+    for (int items = 1; items <= (grid_stride ? kMaxItemsPerThread : 1);
+        items *= 2) {
+      LaunchConfig config;
+      config.local_size = local_size;
+      config.items_per_thread = items;
+      candidates.push_back(config);
+    }
+  }
+  return candidates;
+}
+
+LaunchConfig TuneLaunchConfig(const std::string& kernel_name,
+    const bool grid_stride, const boost::function<void()>& launch,
+    const int runs, float* best_ms) {
+  CHECK_GT(runs, 0);
+  const std::vector<LaunchConfig> candidates = LaunchCandidates(kernel_name,
+      grid_stride);
+  CHECK(!candidates.empty()) << "No launch config fits " << kernel_name;
+  LaunchConfig best = candidates[0];
+  float best_time = -1;
+  CPUTimer timer;
+  for (int i = 0; i < candidates.size(); ++i) {
+    amdDevice.SetLaunchConfig(kernel_name, candidates[i]);
+    launch();
+    OCL_CHECK(clFinish(amdDevice.CommandQueue));
+    timer.Start();
+    for (int r = 0; r < runs; ++r) {
+      launch();
+    }
+    OCL_CHECK(clFinish(amdDevice.CommandQueue));
+    timer.Stop();
+    const float ms = timer.MilliSeconds() / runs;
+    DLOG(INFO) << kernel_name << " local " << candidates[i].local_size
+        << " x" << candidates[i].items_per_thread << ": " << ms << " ms";
+    if (best_time < 0 || ms < best_time) {
+      best_time = ms;
+      best = candidates[i];
+    }
+  }
+  amdDevice.SetLaunchConfig(kernel_name, best);
+  if (best_ms) {
+    *best_ms = best_time;
+  }
+  return best;
+}
+#endif
+
+}  // namespace caffe
@@ -39,8 +39,8 @@ template <typename dtype> extern std::string get_dtype_suffix();
 
 template <typename Dtype>
 void ocl_memset(Dtype* buffer, const Dtype value, const int count, const int buf_offset) {
-  std::string kernel_name = std::string("oclmem") + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("oclmem");
+  cl_kernel Kernel = handle.get();
   cl_int err = 0;
   err = clSetKernelArg(Kernel, 0, sizeof(cl_mem), (void*) &buffer);
   err |= clSetKernelArg(Kernel, 1, sizeof(Dtype), (void*) &value);
@@ -62,8 +62,8 @@ template void ocl_memset<double>(double* buffer, const double value, const int c
 
 void ocl_memset(cl_mem buffer, const int value,
     const int count) {
-  std::string kernel_name = std::string("OCL_memset2");
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static KernelHandle handle("OCL_memset2");
+  cl_kernel Kernel = handle.get();
   cl_int err;
   err = clSetKernelArg(Kernel, 0, sizeof(cl_mem), (void*) &buffer);
   err |= clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &value);
@@ -42,8 +42,8 @@ struct array4x32 {
 template <typename Dtype>
 void caffe_gpu_bernoulli(int* a, const unsigned int n, Dtype inf, Dtype sup,
     Dtype threshold) {
-  std::string kernel_name = "RNGBernoulli" + get_dtype_suffix<Dtype>();
-  cl_kernel ker_rand = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("RNGBernoulli");
+  cl_kernel ker_rand = handle.get();
 
   static unsigned c = 0;
   unsigned nrounds = 20;
@@ -75,8 +75,8 @@ template void caffe_gpu_bernoulli<double>(int* a, const unsigned int n,
 template <typename Dtype>
 void transform_gpu(Dtype* src, Dtype* dst, const int top_offset, const int N_,
     const int M_, const int packing_num) {
-  std::string kernel_name = "transform" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("transform");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_mem), (void*) &src);
@@ -127,8 +127,8 @@ void caffe_gpu_uniform(Dtype* a, const unsigned int n, Dtype inf, Dtype sup, uns
             c = seed_;
             return;
         }
-	std::string kernel_name = "RNGUniform" + get_dtype_suffix<Dtype>();
-        cl_kernel ker_rand = amdDevice.GetKernel(kernel_name);
+	static TypedKernelHandle<Dtype> handle("RNGUniform");
+	cl_kernel ker_rand = handle.get();
 
         unsigned nrounds = 20;
         array4x32  rndctr4;
@@ -158,8 +158,8 @@ void caffe_gpu_uniform(const unsigned int n, unsigned int *r, unsigned int _seed
             c = _seed;
             return;
         }
-        std::string kernel_name = "PRNG_threefry4x32_uint_uniform";
-        cl_kernel ker_rand = amdDevice.GetKernel(kernel_name);
+        static KernelHandle handle("PRNG_threefry4x32_uint_uniform");
+        cl_kernel ker_rand = handle.get();
 
         unsigned nrounds = 20;
         array4x32  rndctr4;
@@ -185,8 +185,8 @@ void caffe_gpu_uniform(const unsigned int n, unsigned int *r, unsigned int _seed
 template <typename Dtype>
 void caffe_gpu_gaussian(Dtype* a, const unsigned int n, Dtype E, Dtype V)
 {
-        std::string kernel_name = "RNGGaussian" + get_dtype_suffix<Dtype>();
-        cl_kernel ker_rand = amdDevice.GetKernel(kernel_name);
+        static TypedKernelHandle<Dtype> handle("RNGGaussian");
+        cl_kernel ker_rand = handle.get();
 
         static unsigned c = 0;
         unsigned nrounds = 20;
@@ -281,8 +281,8 @@ template double softmax_gpu<double>(cl_kernel Kernel, const int num,
 template <typename Dtype>
 void kernel_channel_max(const int num, const int channels,
     const int spatial_dim, const Dtype* data, Dtype* out) {
-  std::string kernel_name = "kernel_channel_max" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_channel_max");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &num));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels));
@@ -290,11 +290,7 @@ void kernel_channel_max(const int num, const int channels,
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 4, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t)(num * spatial_dim) };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, num * spatial_dim, false);
 }
 
 template void kernel_channel_max<float>(const int num, const int channels,
@@ -305,9 +301,8 @@ template void kernel_channel_max<double>(const int num, const int channels,
 template <typename Dtype>
 void kernel_channel_subtract(const int count, const int num, const int channels,
     const int spatial_dim, const Dtype* channel_max, Dtype* data) {
-  std::string kernel_name = "kernel_channel_subtract"
-      + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_channel_subtract");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &num));
@@ -316,11 +311,7 @@ void kernel_channel_subtract(const int count, const int num, const int channels,
   OCL_CHECK(clSetKernelArg(Kernel, 4, sizeof(cl_mem), (void*) &channel_max));
   OCL_CHECK(clSetKernelArg(Kernel, 5, sizeof(cl_mem), (void*) &data));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, false);
 }
 
 template void kernel_channel_subtract<float>(const int count, const int num,
@@ -332,19 +323,15 @@ template void kernel_channel_subtract<double>(const int count, const int num,
 
 template <typename Dtype>
 void kernel_mul(const int count, const Dtype* a, const Dtype* b, Dtype* out) {
-  std::string kernel_name = "kernel_mul" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_mul");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b));
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_mul<float>(const int count, const float* a, const float* b,
@@ -354,18 +341,14 @@ template void kernel_mul<double>(const int count, const double* a,
 
 template <typename Dtype>
 void kernel_add_scalar(const int count, const Dtype data, Dtype* out) {
-  std::string kernel_name = "kernel_add_scalar" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_add_scalar");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(Dtype), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_add_scalar<float>(const int count, const float data,
@@ -376,19 +359,15 @@ template void kernel_add_scalar<double>(const int count, const double data,
 template <typename Dtype>
 void kernel_powx(const int count, const Dtype* data, const Dtype alpha,
     Dtype* out) {
-  std::string kernel_name = "kernel_powx" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_powx");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(Dtype), (void*) &alpha));
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_powx<float>(const int count, const float* data,
@@ -398,19 +377,15 @@ template void kernel_powx<double>(const int count, const double* data,
 
 template <typename Dtype>
 void kernel_div(const int count, const Dtype* a, const Dtype* b, Dtype* out) {
-  std::string kernel_name = "kernel_div" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_div");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b));
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_div<float>(const int count, const float* a, const float* b,
@@ -420,19 +395,15 @@ template void kernel_div<double>(const int count, const double* a,
 
 template <typename Dtype>
 void kernel_add(const int count, const Dtype* a, const Dtype* b, Dtype* out) {
-  std::string kernel_name = "kernel_add" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_add");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b));
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_add<float>(const int count, const float* a, const float* b,
@@ -442,19 +413,15 @@ template void kernel_add<double>(const int count, const double* a,
 
 template <typename Dtype>
 void kernel_sub(const int count, const Dtype* a, const Dtype* b, Dtype* out) {
-  std::string kernel_name = "kernel_sub" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_sub");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b));
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_sub<float>(const int count, const float* a, const float* b,
@@ -464,18 +431,14 @@ template void kernel_sub<double>(const int count, const double* a,
 
 template <typename Dtype>
 void kernel_log(const int count, const Dtype* data, Dtype* out) {
-  std::string kernel_name = "kernel_log" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_log");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_log<float>(const int count, const float* data, float* out);
@@ -484,18 +447,14 @@ template void kernel_log<double>(const int count, const double* data,
 
 template <typename Dtype>
 void kernel_exp(const int count, const Dtype* data, Dtype* out) {
-  std::string kernel_name = "kernel_exp" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_exp");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &out));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void kernel_exp<float>(const int count, const float* data, float* out);
@@ -505,8 +464,8 @@ template void kernel_exp<double>(const int count, const double* data,
 template <typename Dtype>
 void kernel_channel_sum(const int num, const int channels,
     const int spatial_dim, const Dtype* data, Dtype* channel_sum) {
-  std::string kernel_name = "kernel_channel_sum" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_channel_sum");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &num));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels));
@@ -514,11 +473,7 @@ void kernel_channel_sum(const int num, const int channels,
   OCL_CHECK(clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &data));
   OCL_CHECK(clSetKernelArg(Kernel, 4, sizeof(cl_mem), (void*) &channel_sum));
 
-  size_t Global_Work_Size[1] = { (size_t)(num * spatial_dim) };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, num * spatial_dim, false);
 }
 
 template void kernel_channel_sum<float>(const int num, const int channels,
@@ -529,8 +484,8 @@ template void kernel_channel_sum<double>(const int num, const int channels,
 template <typename Dtype>
 void kernel_channel_div(const int count, const int num, const int channels,
     const int spatial_dim, const Dtype* channel_sum, Dtype* data) {
-  std::string kernel_name = "kernel_channel_div" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_channel_div");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &num));
@@ -539,11 +494,7 @@ void kernel_channel_div(const int count, const int num, const int channels,
   OCL_CHECK(clSetKernelArg(Kernel, 4, sizeof(cl_mem), (void*) &channel_sum));
   OCL_CHECK(clSetKernelArg(Kernel, 5, sizeof(cl_mem), (void*) &data));
 
-  size_t Global_Work_Size[1] = { (size_t) count };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, false);
 }
 
 template void kernel_channel_div<float>(const int count, const int num,
@@ -557,8 +508,8 @@ template <typename Dtype>
 void kernel_channel_dot(const int num, const int channels,
     const int spatial_dim, const Dtype* data_1, const Dtype* data_2,
     Dtype* channel_dot) {
-  std::string kernel_name = "kernel_channel_dot" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("kernel_channel_dot");
+  cl_kernel Kernel = handle.get();
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &num));
   OCL_CHECK(clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels));
@@ -567,11 +518,7 @@ void kernel_channel_dot(const int num, const int channels,
   OCL_CHECK(clSetKernelArg(Kernel, 4, sizeof(cl_mem), (void*) &data_2));
   OCL_CHECK(clSetKernelArg(Kernel, 5, sizeof(cl_mem), (void*) &channel_dot));
 
-  size_t Global_Work_Size[1] = { (size_t)(num * spatial_dim) };
-  size_t Local_Work_Size[1] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, num * spatial_dim, false);
 }
 
 template void kernel_channel_dot<float>(const int num, const int channels,
@@ -586,8 +533,8 @@ void SoftmaxLossForwardGPU(const int nthreads, const Dtype* prob_data,
     const Dtype* label, Dtype* loss, const int num, const int dim,
     const int spatial_dim, const bool has_ignore_label_,
     const int ignore_label_, Dtype* counts) {
-  std::string kernel_name = "SoftmaxLossForwardGPU" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("SoftmaxLossForwardGPU");
+  cl_kernel Kernel = handle.get();
 
   int int_has_ignore_label = has_ignore_label_ ? 1 : 0;
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &nthreads));
@@ -623,9 +570,8 @@ void SoftmaxLossBackwardGPU(const int nthreads, const Dtype* top,
     const Dtype* label, Dtype* bottom_diff, const int num, const int dim,
     const int spatial_dim, const bool has_ignore_label_,
     const int ignore_label_, Dtype* counts) {
-  std::string kernel_name = "SoftmaxLossBackwardGPU"
-      + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("SoftmaxLossBackwardGPU");
+  cl_kernel Kernel = handle.get();
   int int_has_ignore_label = has_ignore_label_ ? 1 : 0;
 
   OCL_CHECK(clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &nthreads));
@@ -739,8 +685,8 @@ void MaxPoolForward(const int count, const Dtype* bottom_data, const int clnum,
     const int kernel_w_, const int stride_h_, const int stride_w_,
     const int pad_h_, const int pad_w_, Dtype* top_data, int* mask,
     Dtype* top_mask) {
-  std::string kernel_name = "MaxPoolForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("MaxPoolForward");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
@@ -788,8 +734,8 @@ void StoPoolForwardTrain(const int count, const Dtype* bottom_data,
     const int pooled_height_, const int pooled_width_, const int kernel_h_,
     const int kernel_w_, const int stride_h_, const int stride_w_,
     Dtype* idx_data, Dtype* top_data) {
-  std::string kernel_name = "StoPoolForwardTrain" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("StoPoolForwardTrain");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &bottom_data);
@@ -831,8 +777,8 @@ void StoPoolForwardTest(const int count, const Dtype* bottom_data,
     const int pooled_height_, const int pooled_width_, const int kernel_h_,
     const int kernel_w_, const int stride_h_, const int stride_w_,
     Dtype* top_data) {
-  std::string kernel_name = "StoPoolForwardTest" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("StoPoolForwardTest");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
@@ -874,8 +820,8 @@ void AvePoolForward(const int count, const Dtype* bottom_data, const int clnum,
     const int pooled_height_, const int pooled_width_, const int kernel_h_,
     const int kernel_w_, const int stride_h_, const int stride_w_,
     const int pad_h_, const int pad_w_, Dtype* top_data) {
-  std::string kernel_name = "AvePoolForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("AvePoolForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &bottom_data);
@@ -997,8 +943,8 @@ void MaxPoolBackward(const int nthreads, const Dtype* const top_diff,
     const int pooled_height, const int pooled_width, const int kernel_h,
     const int kernel_w, const int stride_h, const int stride_w, const int pad_h,
     const int pad_w, Dtype* const bottom_diff) {
-  std::string kernel_name = "MaxPoolBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("MaxPoolBackward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &nthreads);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &top_diff);
@@ -1047,8 +993,8 @@ void AvePoolBackward(const int nthreads, const Dtype* const top_diff,
     const int pooled_height, const int pooled_width, const int kernel_h,
     const int kernel_w, const int stride_h, const int stride_w, const int pad_h,
     const int pad_w, Dtype* const bottom_diff) {
-  std::string kernel_name = "AvePoolBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("AvePoolBackward");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &nthreads);
@@ -1093,8 +1039,8 @@ void StoPoolBackward(const int nthreads, const Dtype* const rand_idx,
     const int height, const int width, const int pooled_height,
     const int pooled_width, const int kernel_h, const int kernel_w,
     const int stride_h, const int stride_w, Dtype* const bottom_diff) {
-  std::string kernel_name = "StoPoolBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("StoPoolBackward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &nthreads);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &rand_idx);
@@ -1173,8 +1119,8 @@ template <typename Dtype>
 void PReLUForward(const int count, const int channels, const int dim,
     const Dtype* bottom_data, Dtype* top_data, const Dtype* slope_data,
     const int div_factor) {
-  std::string kernel_name = "PReLUForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("PReLUForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels);
@@ -1200,8 +1146,8 @@ template <typename Dtype>
 void PReLUBackward(const int count, const int channels, const int dim,
     const Dtype* top_diff, const Dtype* bottom_data, Dtype* bottom_diff,
     const Dtype* slope_data, const int div_factor) {
-  std::string kernel_name = "PReLUBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("PReLUBackward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels);
@@ -1228,8 +1174,8 @@ template <typename Dtype>
 void PReLUParamBackward(const int count, const Dtype* top_diff,
     const int offset_out, const Dtype* bottom_data, const int offset_in,
     Dtype* bottom_diff) {
-  std::string kernel_name = "PReLUParamBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("PReLUParamBackward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &top_diff);
@@ -1253,19 +1199,15 @@ template void PReLUParamBackward<double>(const int count,
 template <typename Dtype>
 void ReLUForward(const int count, const Dtype* bottom_data, Dtype* top_data,
     Dtype negative_slope) {
-  std::string kernel_name = "ReLUForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("ReLUForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &bottom_data);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &top_data);
   ret |= clSetKernelArg(Kernel, 3, sizeof(Dtype), (void*) &negative_slope);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 
 template void ReLUForward<float>(const int count, const float* bottom_data,
@@ -1276,8 +1218,8 @@ template void ReLUForward<double>(const int count, const double* bottom_data,
 template <typename Dtype>
 void ReLUBackward(const int count, const Dtype* top_diff,
     const Dtype* bottom_data, Dtype* bottom_diff, Dtype negative_slope) {
-  std::string kernel_name = "ReLUBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("ReLUBackward");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1287,32 +1229,50 @@ void ReLUBackward(const int count, const Dtype* top_diff,
   ret |= clSetKernelArg(Kernel, 4, sizeof(Dtype), (void*) &negative_slope);
   OCL_CHECK(ret);
 
-  size_t uiGlobal_Work_Size[] = { (size_t) count };
-  size_t uiLocal_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          uiGlobal_Work_Size, uiLocal_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, true);
 }
 template void ReLUBackward<float>(const int count, const float* top_diff,
     const float* bottom_data, float* bottom_diff, float negative_slope);
 template void ReLUBackward<double>(const int count, const double* top_diff,
     const double* bottom_data, double* bottom_diff, double negative_slope);
 
+template <typename Dtype>
+void BiasReLUForward(const int count, const int channels,
+    const int spatial_dim, const Dtype* bias, Dtype* data, const int offset,
+    Dtype negative_slope) {
+  static TypedKernelHandle<Dtype> handle("BiasReLUForward");
+  cl_kernel Kernel = handle.get();
+  const int has_bias = bias != NULL;
+  cl_int ret;
+  ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
+  ret |= clSetKernelArg(Kernel, 1, sizeof(cl_int), (void*) &channels);
+  ret |= clSetKernelArg(Kernel, 2, sizeof(cl_int), (void*) &spatial_dim);
+  ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &bias);
+  ret |= clSetKernelArg(Kernel, 4, sizeof(cl_int), (void*) &has_bias);
+  ret |= clSetKernelArg(Kernel, 5, sizeof(cl_mem), (void*) &data);
+  ret |= clSetKernelArg(Kernel, 6, sizeof(cl_int), (void*) &offset);
+  ret |= clSetKernelArg(Kernel, 7, sizeof(Dtype), (void*) &negative_slope);
+  OCL_CHECK(ret);
+  handle.Enqueue(Kernel, count, true);
+}
+template void BiasReLUForward<float>(const int count, const int channels,
+    const int spatial_dim, const float* bias, float* data, const int offset,
+    float negative_slope);
+template void BiasReLUForward<double>(const int count, const int channels,
+    const int spatial_dim, const double* bias, double* data,
+    const int offset, double negative_slope);
+
 template <typename Dtype>
 void SigmoidForward(const int count, const Dtype* bottom_data,
     Dtype* top_data) {
-  std::string kernel_name = "SigmoidForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("SigmoidForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &bottom_data);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &top_data);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, false);
 }
 
 template void SigmoidForward<float>(const int count, const float* bottom_data,
@@ -1323,8 +1283,8 @@ template void SigmoidForward<double>(const int count, const double* bottom_data,
 template <typename Dtype>
 void SigmoidBackward(const int count, const Dtype* top_diff,
     const Dtype* top_data, Dtype* bottom_diff) {
-  std::string kernel_name = "SigmoidBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("SigmoidBackward");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1347,19 +1307,15 @@ template void SigmoidBackward<double>(const int count, const double* top_diff,
 template <typename Dtype>
 void ThresholdForward(const int count, const Dtype threshold,
     const Dtype* bottom_data, Dtype* top_data) {
-  std::string kernel_name = "ThresholdForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("ThresholdForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(Dtype), (void*) &threshold);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &bottom_data);
   ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &top_data);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, false);
 }
 
 template void ThresholdForward<float>(const int count, const float threshold,
@@ -1369,18 +1325,14 @@ template void ThresholdForward<double>(const int count, const double threshold,
 
 template <typename Dtype>
 void TanHForward(const int count, const Dtype* bottom_data, Dtype* top_data) {
-  std::string kernel_name = "TanHForward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("TanHForward");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &bottom_data);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &top_data);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, count, false);
 }
 
 template void TanHForward<float>(const int count, const float* bottom_data,
@@ -1391,8 +1343,8 @@ template void TanHForward<double>(const int count, const double* bottom_data,
 template <typename Dtype>
 void TanHBackward(const int count, const Dtype* top_diff, const Dtype* top_data,
     Dtype* bottom_diff) {
-  std::string kernel_name = "TanHBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("TanHBackward");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1416,8 +1368,8 @@ template <typename Dtype>
 void opttrans(const Dtype* data_im, const int im_offset, const int channels,
     const int height, const int width, Dtype* data_opt, const int opt_offset,
     const int optnum) {
-  std::string kernel_name = "opttrans" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("opttrans");
+  cl_kernel Kernel = handle.get();
 
   int num_kernels = channels * height * width * optnum;
 
@@ -1451,8 +1403,8 @@ template <typename Dtype>
 void LRNFillScale(const int nthreads, const Dtype* const in, const int num,
     const int channels, const int height, const int width, const int size,
     const Dtype alpha_over_size, const Dtype k, Dtype* const scale) {
-  std::string kernel_name = "LRNFillScale" + get_dtype_suffix<Dtype>();
-  cl_kernel LFSkernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("LRNFillScale");
+  cl_kernel LFSkernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(LFSkernel, 0, sizeof(cl_int), (void*) &nthreads);
   ret |= clSetKernelArg(LFSkernel, 1, sizeof(cl_mem), (void*) &in);
@@ -1483,8 +1435,8 @@ template void LRNFillScale<double>(const int nthreads, const double* const in,
 template <typename Dtype>
 void LRNComputeOutput(int nthreads, const Dtype* in, Dtype* scale,
     Dtype negative_beta, Dtype* out) {
-  std::string kernel_name = "LRNComputeOutput" + get_dtype_suffix<Dtype>();
-  cl_kernel LCOkernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("LRNComputeOutput");
+  cl_kernel LCOkernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(LCOkernel, 0, sizeof(cl_int), (void*) &nthreads);
   ret |= clSetKernelArg(LCOkernel, 1, sizeof(cl_mem), (void*) &in);
@@ -1510,8 +1462,8 @@ void LRNComputeDiff(const int nthreads, const Dtype* const bottom_data,
     const int height, const int width, const int size,
     const Dtype negative_beta, const Dtype cache_ratio,
     Dtype* const bottom_diff) {
-  std::string kernel_name = "LRNComputeDiff" + get_dtype_suffix<Dtype>();
-  cl_kernel LCDkernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("LRNComputeDiff");
+  cl_kernel LCDkernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(LCDkernel, 0, sizeof(cl_int), (void*) &nthreads);
   ret |= clSetKernelArg(LCDkernel, 1, sizeof(cl_mem), (void*) &bottom_data);
@@ -1548,19 +1500,15 @@ template void LRNComputeDiff<double>(const int nthreads,
 
 template <typename Dtype>
 void caffe_gpu_add(const int n, const Dtype* in1, const Dtype* in2, Dtype* y) {
-  std::string kernel_name = "caffe_gpu_add" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("caffe_gpu_add");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &n);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &in1);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &in2);
   ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) n };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, n, false);
 }
 
 template void caffe_gpu_add<float>(const int n, const float* in1,
@@ -1570,36 +1518,28 @@ template void caffe_gpu_add<double>(const int n, const double* in1,
 
 template <typename Dtype>
 void caffe_gpu_signbit(const int N, const Dtype* X, Dtype * Y) {
-  std::string kernel_name = "caffe_gpu_sgnbit" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("caffe_gpu_sgnbit");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &N);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &X);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &Y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) N };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, N, false);
 }
 template void caffe_gpu_signbit<float>(const int N, const float* X, float * Y);
 template void caffe_gpu_signbit<double>(const int N, const double* X, double * Y);
 
 template <typename Dtype>
 void caffe_gpu_sign_ocl(const int N, const Dtype* X, Dtype * Y) {
-  std::string kernel_name = "caffe_gpu_sign" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("caffe_gpu_sign");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &N);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &X);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &Y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) N };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, N, false);
 }
 
 template void caffe_gpu_sign_ocl<float>(const int N, const float* X, float* Y);
@@ -1608,8 +1548,8 @@ template void caffe_gpu_sign_ocl<double>(const int N, const double* X,
 
 template <typename Dtype>
 void caffe_gpu_sign_with_offset_ocl(const int N, const Dtype* X, const int offx,  Dtype * Y, const int offy) {
-  std::string kernel_name = "caffe_gpu_sign_with_offset" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("caffe_gpu_sign_with_offset");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &N);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &X);
@@ -1630,18 +1570,14 @@ template void caffe_gpu_sign_with_offset_ocl<double>(const int N, const double*
 
 template <typename Dtype>
 void caffe_gpu_abs_ocl(const int N, const Dtype* X, Dtype * Y) {
-  std::string kernel_name = "caffe_gpu_abs" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("caffe_gpu_abs");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &N);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &X);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &Y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) N };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, N, false);
 }
 
 template void caffe_gpu_abs_ocl<float>(const int N, const float* X, float* Y);
@@ -1650,19 +1586,15 @@ template void caffe_gpu_abs_ocl<double>(const int N, const double* X,
 
 template <typename Dtype>
 void caffe_gpu_div(const int n, const Dtype* a, const Dtype* b, Dtype* y) {
-  std::string kernel_name = "div" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("div");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &n);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b);
   ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) n };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, n, false);
 }
 
 template void caffe_gpu_div<float>(const int n, const float* a, const float* b,
@@ -1672,18 +1604,14 @@ template void caffe_gpu_div<double>(const int n, const double* a,
 
 template <typename Dtype>
 void caffe_gpu_add_scalar(const int n, const Dtype alpha, Dtype* top_data) {
-  std::string kernel_name = "add_scalar" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("add_scalar");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &n);
   ret |= clSetKernelArg(Kernel, 1, sizeof(Dtype), (void*) &alpha);
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &top_data);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) n };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, n, false);
 }
 
 template void caffe_gpu_add_scalar<float>(const int n, const float alpha,
@@ -1693,8 +1621,8 @@ template void caffe_gpu_add_scalar<double>(const int n, const double alpha,
 
 template <typename Dtype>
 void caffe_gpu_mul(const int n, const Dtype* a, const Dtype* b, Dtype* y) {
-  std::string kernel_name = "element_mul" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("element_mul");
+  cl_kernel Kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &n);
@@ -1702,11 +1630,7 @@ void caffe_gpu_mul(const int n, const Dtype* a, const Dtype* b, Dtype* y) {
   ret |= clSetKernelArg(Kernel, 2, sizeof(cl_mem), (void*) &b);
   ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) n };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, n, false);
 }
 
 template void caffe_gpu_mul<float>(const int n, const float* a, const float* b,
@@ -1716,19 +1640,15 @@ template void caffe_gpu_mul<double>(const int n, const double* a,
 
 template <typename Dtype>
 void caffe_gpu_powx(const int n, const Dtype* a, const Dtype alpha, Dtype* y) {
-  std::string kernel_name = "powx" + get_dtype_suffix<Dtype>();
-  cl_kernel Kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("powx");
+  cl_kernel Kernel = handle.get();
   cl_int ret;
   ret = clSetKernelArg(Kernel, 0, sizeof(cl_int), (void*) &n);
   ret |= clSetKernelArg(Kernel, 1, sizeof(cl_mem), (void*) &a);
   ret |= clSetKernelArg(Kernel, 2, sizeof(Dtype), (void*) &alpha);
   ret |= clSetKernelArg(Kernel, 3, sizeof(cl_mem), (void*) &y);
   OCL_CHECK(ret);
-  size_t Global_Work_Size[] = { (size_t) n };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, Kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(Kernel, n, false);
 }
 
 template void caffe_gpu_powx<float>(const int n, const float* a,
@@ -1740,8 +1660,8 @@ template <typename Dtype>
 void DropoutForward(const int count, const Dtype* bottom_data,
     const  unsigned int* MaskMem, const unsigned int threshold,
     const float scale_, Dtype* top_data) {
-	std::string kernel_name = "DropoutForward" + get_dtype_suffix<Dtype>();
-	cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+	static TypedKernelHandle<Dtype> handle("DropoutForward");
+	cl_kernel kernel = handle.get();
 
 	cl_int ret;
 	ret = clSetKernelArg(kernel,  0, sizeof(cl_int), (void*) &count);
@@ -1768,8 +1688,8 @@ template void DropoutForward<double>(const int count, const double* bottom_data,
 template <typename Dtype>
 void DropoutBackward(const int count, const Dtype* top_diff, const unsigned int* MaskMem,
 		const unsigned int threshold_, const float scale_, Dtype* bottom_diff) {
-	std::string kernel_name = "DropoutBackward" + get_dtype_suffix<Dtype>();
-	cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+	static TypedKernelHandle<Dtype> handle("DropoutBackward");
+	cl_kernel kernel = handle.get();
 
 	cl_int ret;
 	ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1795,8 +1715,8 @@ template void DropoutBackward<double>(const int count, const double* top_diff,
 
 template <typename Dtype>
 void BNLLForward(const int count, const Dtype* bottom_data, Dtype *top_data) {
-  std::string kernel_name = "BNLLForward" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("BNLLForward");
+  cl_kernel kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1804,11 +1724,7 @@ void BNLLForward(const int count, const Dtype* bottom_data, Dtype *top_data) {
   ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*) &top_data);
   OCL_CHECK(ret);
 
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(kernel, count, false);
 }
 template void BNLLForward<float>(const int count, const float* bottom_data,
     float *top_data);
@@ -1818,8 +1734,8 @@ template void BNLLForward<double>(const int count, const double* bottom_data,
 template <typename Dtype>
 void BNLLBackward(const int count, const Dtype* top_diff,
     const Dtype* bottom_data, Dtype *bottom_diff) {
-  std::string kernel_name = "BNLLBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("BNLLBackward");
+  cl_kernel kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1828,11 +1744,7 @@ void BNLLBackward(const int count, const Dtype* top_diff,
   ret |= clSetKernelArg(kernel, 3, sizeof(cl_mem), (void*) &bottom_diff);
   OCL_CHECK(ret);
 
-  size_t Global_Work_Size[] = { (size_t) count };
-  size_t Local_Work_Size[] = { 256 };
-  OCL_CHECK(
-      clEnqueueNDRangeKernel(amdDevice.CommandQueue, kernel, 1, NULL,
-          Global_Work_Size, Local_Work_Size, 0, NULL, NULL));
+  handle.Enqueue(kernel, count, false);
 }
 template void BNLLBackward<float>(const int count, const float* top_diff,
     const float* bottom_data, float *bottom_diff);
@@ -1844,8 +1756,8 @@ void Concat(const int nthreads, const Dtype* in_data, const bool forward,
     const int num_concats, const int concat_size, const int top_concat_axis,
     const int bottom_concat_axis, const int offset_concat_axis,
     Dtype *out_data) {
-  std::string kernel_name = "Concat" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("Concat");
+  cl_kernel kernel = handle.get();
   int k_forward = (forward == true) ? 1 : 0;
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &nthreads);
@@ -1878,8 +1790,8 @@ template <typename Dtype>
 void CLLBackward(const int count, const int channels, const Dtype margin,
     const bool legacy_version, const Dtype alpha, const Dtype* y,
     const Dtype* diff, const Dtype* dist_sq, Dtype *bottom_diff) {
-  std::string kernel_name = "CLLBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("CLLBackward");
+  cl_kernel kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &count);
@@ -1912,8 +1824,8 @@ template <typename Dtype>
 void MaxForward(const int nthreads, const Dtype* bottom_data_a,
     const Dtype* bottom_data_b, const int blob_idx, Dtype* top_data,
     int* mask) {
-  std::string kernel_name = "MaxForward" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("MaxForward");
+  cl_kernel kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &nthreads);
@@ -1939,8 +1851,8 @@ template void MaxForward<double>(const int nthreads,
 template <typename Dtype>
 void MaxBackward(const int nthreads, const Dtype* top_diff, const int blob_idx,
     const int* mask, Dtype* bottom_diff) {
-  std::string kernel_name = "MaxBackward" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("MaxBackward");
+  cl_kernel kernel = handle.get();
 
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &nthreads);
@@ -1966,8 +1878,8 @@ void Slice(const int nthreads, const Dtype* in_data,
     const bool forward, const int num_slices, const int slice_size,
     const int bottom_slice_axis, const int top_slice_axis,
     const int offset_slice_axis, Dtype* out_data) {
-  std::string kernel_name = "Slice" + get_dtype_suffix<Dtype>();
-  cl_kernel kernel = amdDevice.GetKernel(kernel_name);
+  static TypedKernelHandle<Dtype> handle("Slice");
+  cl_kernel kernel = handle.get();
   int k_forward = (forward == true) ? 1 : 0;
   cl_int ret;
   ret = clSetKernelArg(kernel, 0, sizeof(cl_int), (void*) &nthreads);
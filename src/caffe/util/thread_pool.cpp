@@ -0,0 +1,144 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+  public:
+    sync()
+        : generation_(0), n_(0), num_chunks_(0), chunk_size_(0),
+          next_chunk_(0), pending_(0), stop_(false) {
+    }
+
+    boost::mutex run_mutex_;  // held by the thread owning the current job
+    boost::mutex mutex_;      // guards the job state below
+    boost::condition_variable work_;
+    boost::condition_variable done_;
+
+    unsigned long generation_;
+    ChunkFunction fn_;
+    int n_;
+    int num_chunks_;
+    int chunk_size_;
+    int next_chunk_;
+    int pending_;
+    bool stop_;
+};
+
+static void CallRange(const ThreadPool::RangeFunction& fn, int chunk,
+    int begin, int end) {
+  fn(begin, end);
+}
+
+ThreadPool::ThreadPool(const int num_threads)
+    : sync_(new sync()) {
+  CHECK_GT(num_threads, 0);
+  for (int i = 1; i < num_threads; ++i) {
+    threads_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(boost::bind(&ThreadPool::WorkerEntry, this))));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_.notify_all();
+  for (int i = 0; i < threads_.size(); ++i) {
+    threads_[i]->join();
+  }
+}
+
+int ThreadPool::ChunkSize(const int n, const int grain) const {
+  const int max_chunks = std::max(1, std::min(size(), n / std::max(grain, 1)));
+  return (n + max_chunks - 1) / max_chunks;
+}
+
+int ThreadPool::NumChunks(const int n, const int grain) const {
+  if (n <= 0) {
+    return 0;
+  }
+  // Rounding the chunk size up may leave fewer chunks than threads, e.g. 5
+  // elements on 4 threads make 3 chunks of 2, 2 and 1.
+  const int chunk_size = ChunkSize(n, grain);
+  return (n + chunk_size - 1) / chunk_size;
+}
+
+void ThreadPool::ParallelFor(const int n, const int grain,
+    const RangeFunction& fn) {
+  ParallelForChunks(n, grain, boost::bind(&CallRange, boost::cref(fn),
+      _1, _2, _3));
+}
+
+void ThreadPool::ParallelForChunks(const int n, const int grain,
+    const ChunkFunction& fn) {
+  const int num_chunks = NumChunks(n, grain);
+  if (num_chunks == 0) {
+    return;
+  }
+  const int chunk_size = ChunkSize(n, grain);
+  boost::mutex::scoped_lock run_lock(sync_->run_mutex_, boost::try_to_lock);
+  if (num_chunks == 1 || !run_lock.owns_lock()) {
+    // Busy or not worth splitting: run the same chunks on this thread.
+    for (int c = 0; c < num_chunks; ++c) {
+      fn(c, c * chunk_size, std::min(n, (c + 1) * chunk_size));
+    }
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->fn_ = fn;
+    sync_->n_ = n;
+    sync_->num_chunks_ = num_chunks;
+    sync_->chunk_size_ = chunk_size;
+    sync_->next_chunk_ = 0;
+    sync_->pending_ = num_chunks;
+    ++sync_->generation_;
+  }
+  sync_->work_.notify_all();
+  RunChunks();
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->pending_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  sync_->fn_.clear();
+}
+
+void ThreadPool::RunChunks() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->next_chunk_ < sync_->num_chunks_) {
+    const int c = sync_->next_chunk_++;
+    const int begin = c * sync_->chunk_size_;
+    const int end = std::min(sync_->n_, begin + sync_->chunk_size_);
+    lock.unlock();
+    sync_->fn_(c, begin, end);
+    lock.lock();
+    if (--sync_->pending_ == 0) {
+      sync_->done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::WorkerEntry() {
+  unsigned long seen = 0;
+  for (;;) {
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      while (!sync_->stop_ && sync_->generation_ == seen) {
+        sync_->work_.wait(lock);
+      }
+      if (sync_->stop_) {
+        return;
+      }
+      seen = sync_->generation_;
+    }
+    RunChunks();
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,274 @@
+#include <boost/thread.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/trace.hpp"
+
+namespace caffe {
+
+#ifndef CPU_ONLY
+// Device events held before the completed ones are read back, so that long
+// runs don't keep every cl_event alive.
+static const size_t kMaxPendingEvents = 1024;
+#endif
+
+class Tracer::sync {
+  public:
+    mutable boost::mutex mutex_;
+    std::map<boost::thread::id, int> thread_tracks_;
+};
+
+Tracer& Tracer::Get() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer()
+    : sync_(new sync()), enabled_(false),
+      start_time_(boost::posix_time::microsec_clock::local_time()) {
+#ifndef CPU_ONLY
+  device_start_ns_ = 0;
+#endif
+}
+
+void Tracer::Start() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  enabled_ = false;
+#ifndef CPU_ONLY
+  for (int i = 0; i < device_events_.size(); ++i) {
+    OCL_CHECK(clReleaseEvent(device_events_[i].event));
+  }
+  device_events_.clear();
+  queues_.clear();
+  queue_names_.clear();
+#endif
+  events_.clear();
+  thread_names_.clear();
+  sync_->thread_tracks_.clear();
+  start_time_ = boost::posix_time::microsec_clock::local_time();
+#ifndef CPU_ONLY
+  device_start_ns_ = 0;
+  if (Caffe::mode() != Caffe::CPU && amdDevice.CommandQueue) {
+    // Pairs the device clock with the host one.
+    cl_event marker = NULL;
+    OCL_CHECK(
+        clEnqueueMarkerWithWaitList(amdDevice.CommandQueue, 0, NULL,
+            &marker));
+    OCL_CHECK(clWaitForEvents(1, &marker));
+    start_time_ = boost::posix_time::microsec_clock::local_time();
+    if (clGetEventProfilingInfo(marker, CL_PROFILING_COMMAND_END,
+        sizeof(cl_ulong), &device_start_ns_, NULL) != CL_SUCCESS) {
+      // Aligned on the first command instead, see ResolveDeviceEvents.
+      device_start_ns_ = 0;
+    }
+    OCL_CHECK(clReleaseEvent(marker));
+  }
+#endif
+  enabled_ = true;
+}
+
+void Tracer::Stop() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  enabled_ = false;
+#ifndef CPU_ONLY
+  ResolveDeviceEvents(true);
+#endif
+}
+
+double Tracer::Now() const {
+  return (boost::posix_time::microsec_clock::local_time() - start_time_)
+      .total_microseconds();
+}
+
+int Tracer::ThreadTrack() {
+  const boost::thread::id id = boost::this_thread::get_id();
+  std::map<boost::thread::id, int>::iterator it =
+      sync_->thread_tracks_.find(id);
+  if (it != sync_->thread_tracks_.end()) {
+    return it->second;
+  }
+  const int track = thread_names_.size();
+  char name[32];
+  snprintf(name, sizeof(name), "thread %d", track);
+  thread_names_.push_back(name);
+  sync_->thread_tracks_[id] = track;
+  return track;
+}
+
+void Tracer::AddHostEvent(const std::string& name, const char* category,
+    const double start_us, const double end_us) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  if (!enabled_) {
+    return;
+  }
+  Event event;
+  event.name = name;
+  event.category = category;
+  event.pid = 0;
+  event.tid = ThreadTrack();
+  event.start_us = start_us;
+  event.duration_us = end_us - start_us;
+  events_.push_back(event);
+}
+
+#ifndef CPU_ONLY
+void Tracer::AddDeviceEvent(const std::string& name, const char* category,
+    cl_event event) {
+  if (event == NULL) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  if (!enabled_) {
+    return;
+  }
+  OCL_CHECK(clRetainEvent(event));
+  DeviceEvent device_event;
+  device_event.name = name;
+  device_event.category = category;
+  device_event.event = event;
+  device_events_.push_back(device_event);
+  if (device_events_.size() >= kMaxPendingEvents) {
+    ResolveDeviceEvents(false);
+  }
+}
+
+void Tracer::ResolveDeviceEvents(const bool wait) {
+  std::vector<DeviceEvent> pending;
+  for (int i = 0; i < device_events_.size(); ++i) {
+    const DeviceEvent& device_event = device_events_[i];
+    if (wait) {
+      // A failed command shows in its status.
+      clWaitForEvents(1, &device_event.event);
+    }
+    cl_int status = CL_COMPLETE;
+    OCL_CHECK(
+        clGetEventInfo(device_event.event, CL_EVENT_COMMAND_EXECUTION_STATUS,
+            sizeof(status), &status, NULL));
+    if (status > CL_COMPLETE) {
+      pending.push_back(device_event);
+      continue;
+    }
+    cl_ulong start_ns = 0;
+    cl_ulong end_ns = 0;
+    cl_command_queue queue = NULL;
+    // Failed commands and events without profiling info are dropped.
+    if (status == CL_COMPLETE
+        && clGetEventProfilingInfo(device_event.event,
+            CL_PROFILING_COMMAND_START, sizeof(start_ns), &start_ns, NULL)
+            == CL_SUCCESS
+        && clGetEventProfilingInfo(device_event.event,
+            CL_PROFILING_COMMAND_END, sizeof(end_ns), &end_ns, NULL)
+            == CL_SUCCESS
+        && clGetEventInfo(device_event.event, CL_EVENT_COMMAND_QUEUE,
+            sizeof(queue), &queue, NULL) == CL_SUCCESS) {
+      if (device_start_ns_ == 0) {
+        device_start_ns_ = start_ns;
+      }
+      int track = 0;
+      while (track < queues_.size() && queues_[track] != queue) {
+        ++track;
+      }
+      if (track == queues_.size()) {
+        char queue_name[32];
+        if (queue == amdDevice.CommandQueue_helper) {
+          snprintf(queue_name, sizeof(queue_name), "helper queue");
+        } else {
+          snprintf(queue_name, sizeof(queue_name), "queue %d", track);
+        }
+        queues_.push_back(queue);
+        queue_names_.push_back(queue_name);
+      }
+      Event event;
+      event.name = device_event.name;
+      event.category = device_event.category;
+      event.pid = 1;
+      event.tid = track;
+      event.start_us = (static_cast<double>(start_ns)
+          - static_cast<double>(device_start_ns_)) / 1000.;
+      event.duration_us = (end_ns - start_ns) / 1000.;
+      events_.push_back(event);
+    }
+    OCL_CHECK(clReleaseEvent(device_event.event));
+  }
+  device_events_.swap(pending);
+}
+#endif
+
+size_t Tracer::num_events() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+#ifndef CPU_ONLY
+  return events_.size() + device_events_.size();
+#else
+  return events_.size();
+#endif
+}
+
+static std::string JsonString(const std::string& str) {
+  std::string quoted = "\"";
+  for (int i = 0; i < str.size(); ++i) {
+    const unsigned char c = str[i];
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// Every entry but the first of the array is written after a comma.
+static void WriteTrackNames(const int pid, const std::string& process_name,
+    const std::vector<std::string>& track_names, std::ofstream* file) {
+  *file << (pid ? ",\n" : "")
+      << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+      << ",\"args\":{\"name\":" << JsonString(process_name) << "}}";
+  for (int i = 0; i < track_names.size(); ++i) {
+    *file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":" << i << ",\"args\":{\"name\":"
+        << JsonString(track_names[i]) << "}}";
+  }
+}
+
+bool Tracer::Write(const std::string& file_name) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+#ifndef CPU_ONLY
+  ResolveDeviceEvents(true);
+#endif
+  std::ofstream file(file_name.c_str());
+  if (!file) {
+    LOG(ERROR) << "Can't write trace to " << file_name;
+    return false;
+  }
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  WriteTrackNames(0, "host", thread_names_, &file);
+  WriteTrackNames(1, "OpenCL device", queue_names_, &file);
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  for (int i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    file << ",\n{\"name\":" << JsonString(event.name)
+        << ",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":"
+        << event.pid << ",\"tid\":" << event.tid << ",\"ts\":"
+        << event.start_us << ",\"dur\":" << event.duration_us << "}";
+  }
+  file << "\n]}\n";
+  file.close();
+  if (!file) {
+    LOG(ERROR) << "Can't write trace to " << file_name;
+    return false;
+  }
+  LOG(INFO) << "Wrote " << events_.size() << " trace events to " << file_name;
+  return true;
+}
+
+}  // namespace caffe
@@ -22,6 +22,8 @@ using caffe::amdDevice;
 
 DEFINE_int32(gpu, -1,
     "Run in GPU mode on given device ID.");
+DEFINE_bool(apu, false,
+    "With --gpu, run in APU mode: host and device share memory, no copies.");
 DEFINE_string(solver, "",
     "The solver definition protocol buffer text file.");
 DEFINE_string(model, "",
@@ -33,6 +35,11 @@ DEFINE_string(weights, "",
     "Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_int32(cpu_threads, 1,
+    "Number of threads used by the CPU element-wise math functions.");
+DEFINE_string(trace, "",
+    "Optional; write a Chrome trace (chrome://tracing) of the layers, data "
+    "prefetch, transfers and OpenCL commands of the run to this JSON file.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -94,6 +101,20 @@ void CopyLayers(caffe::Solver<float>* solver, const std::string& model_list) {
   }
 }
 
+// Start and write the trace requested by --trace, if any.
+static void StartTrace() {
+  if (FLAGS_trace.size()) {
+    caffe::Tracer::Get().Start();
+  }
+}
+
+static void WriteTrace() {
+  if (FLAGS_trace.size()) {
+    caffe::Tracer::Get().Stop();
+    CHECK(caffe::Tracer::Get().Write(FLAGS_trace));
+  }
+}
+
 // Train / Finetune a model.
 int train() {
   CHECK_GT(FLAGS_solver.size(), 0) << "Need a solver definition to train.";
@@ -115,7 +136,7 @@ int train() {
   if (FLAGS_gpu >= 0) {
     LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
     Caffe::SetDevice(FLAGS_gpu);
-    Caffe::set_mode(Caffe::GPU);
+    Caffe::set_mode(FLAGS_apu ? Caffe::APU : Caffe::GPU);
   } else {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
@@ -125,6 +146,7 @@ int train() {
   shared_ptr<caffe::Solver<float> >
     solver(caffe::GetSolver<float>(solver_param));
 
+  StartTrace();
   if (FLAGS_snapshot.size()) {
     LOG(INFO) << "Resuming from " << FLAGS_snapshot;
     solver->Solve(FLAGS_snapshot);
@@ -134,6 +156,7 @@ int train() {
   } else {
     solver->Solve();
   }
+  WriteTrace();
   LOG(INFO) << "Optimization Done.";
   return 0;
 }
@@ -149,7 +172,7 @@ int test() {
   if (FLAGS_gpu >= 0) {
     LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
     Caffe::SetDevice(FLAGS_gpu);
-    Caffe::set_mode(Caffe::GPU);
+    Caffe::set_mode(FLAGS_apu ? Caffe::APU : Caffe::GPU);
   } else {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
@@ -163,6 +186,7 @@ int test() {
   vector<int> test_score_output_id;
   vector<float> test_score;
   float loss = 0;
+  StartTrace();
   for (int i = 0; i < FLAGS_iterations; ++i) {
     float iter_loss;
     const vector<Blob<float>*>& result =
@@ -185,6 +209,7 @@ int test() {
       }
     }
   }
+  WriteTrace();
   loss /= FLAGS_iterations;
   LOG(INFO) << "Loss: " << loss;
   for (int i = 0; i < test_score.size(); ++i) {
@@ -214,7 +239,7 @@ int time() {
   if (FLAGS_gpu >= 0) {
     LOG(INFO) << "Use GPU with device ID " << FLAGS_gpu;
     Caffe::SetDevice(FLAGS_gpu);
-    Caffe::set_mode(Caffe::GPU);
+    Caffe::set_mode(FLAGS_apu ? Caffe::APU : Caffe::GPU);
   } else {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
@@ -252,11 +277,13 @@ int time() {
 #ifndef CPU_ONLY
   clFinish(amdDevice.CommandQueue);
 #endif
+  StartTrace();
   for (int j = 0; j < FLAGS_iterations; ++j) {
     Timer iter_timer;
     iter_timer.Start();
     forward_timer.Start();
     for (int i = 0; i < layers.size(); ++i) {
+      caffe::TraceScope trace(layers[i]->layer_param().name(), "forward");
       timer.Start();
       layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
 #ifndef CPU_ONLY
@@ -267,6 +294,7 @@ int time() {
     forward_time += forward_timer.MicroSeconds();
     backward_timer.Start();
     for (int i = layers.size() - 1; i >= 0; --i) {
+      caffe::TraceScope trace(layers[i]->layer_param().name(), "backward");
       timer.Start();
       layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
                           bottom_vecs[i]);
@@ -279,6 +307,7 @@ int time() {
     LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
       << iter_timer.MilliSeconds() << " ms.";
   }
+  WriteTrace();
   LOG(INFO) << "Average time per layer: ";
   for (int i = 0; i < layers.size(); ++i) {
     const caffe::string& layername = layers[i]->layer_param().name();
@@ -316,6 +345,7 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  caffe::Caffe::set_cpu_threads(FLAGS_cpu_threads);
   if (argc == 2) {
     return GetBrewFunction(caffe::string(argv[1]))();
   } else {
@@ -0,0 +1,62 @@
+// This program copies the records of a db into a db of another backend,
+// e.g. an lmdb or leveldb built by convert_imageset into a packed db.
+// Usage:
+//   convert_db [FLAGS] INPUT_DB OUTPUT_DB
+
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/db.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(input_backend, "lmdb",
+        "The backend {lmdb, leveldb, packed} of the input db");
+DEFINE_string(output_backend, "packed",
+        "The backend {lmdb, leveldb, packed} for storing the result");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Copy the records of a db into a new db of another"
+        " backend\n"
+        "Usage:\n"
+        "    convert_db [FLAGS] INPUT_DB OUTPUT_DB\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_db");
+    return 1;
+  }
+
+  scoped_ptr<db::DB> input(db::GetDB(FLAGS_input_backend));
+  input->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(input->NewCursor());
+  scoped_ptr<db::DB> output(db::GetDB(FLAGS_output_backend));
+  output->Open(argv[2], db::NEW);
+  scoped_ptr<db::Transaction> txn(output->NewTransaction());
+
+  int count = 0;
+  for (; cursor->valid(); cursor->Next()) {
+    txn->Put(cursor->key(), cursor->value());
+    if (++count % 1000 == 0) {
+      txn->Commit();
+      txn.reset(output->NewTransaction());
+      LOG(ERROR) << "Processed " << count << " records.";
+    }
+  }
+  // write the last batch
+  if (count % 1000 != 0) {
+    txn->Commit();
+    LOG(ERROR) << "Processed " << count << " records.";
+  }
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <boost/bind.hpp>
+
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/ocl_tuning.hpp"
+#include "caffe/util/ocl_wrapper.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(gpu, -1,
+    "The OpenCL device to tune; by default the one Caffe picks.");
+DEFINE_string(device_type, "gpu",
+    "The type of OpenCL devices to pick from: gpu, cpu, accelerator or all.");
+DEFINE_int32(count, 1 << 22,
+    "Number of elements the kernels are timed on.");
+DEFINE_int32(runs, 20,
+    "Number of timed launches per candidate launch config.");
+DEFINE_string(profile, "",
+    "Where to write the launch profile; defaults to the profile of the "
+    "device in the program binary cache, which Caffe loads on start.");
+
+// Channel layout of the softmax kernels: count = num * channels * spatial.
+static const int kNum = 32;
+static const int kChannels = 16;
+
+template <typename Dtype>
+static void TuneKernels(const int count, const int runs) {
+  Blob<Dtype> a(1, 1, 1, count);
+  Blob<Dtype> b(1, 1, 1, count);
+  Blob<Dtype> out(1, 1, 1, count);
+  caffe_rng_uniform<Dtype>(count, Dtype(0.5), Dtype(1.5),
+      a.mutable_cpu_data());
+  caffe_rng_uniform<Dtype>(count, Dtype(0.5), Dtype(1.5),
+      b.mutable_cpu_data());
+  const Dtype* a_data = a.gpu_data();
+  const Dtype* b_data = b.gpu_data();
+  Dtype* out_data = out.mutable_gpu_data();
+  const int spatial = count / (kNum * kChannels);
+  const std::string suffix = get_dtype_suffix<Dtype>();
+
+  struct {
+    const char* name;
+    bool grid_stride;
+    boost::function<void()> launch;
+  } kernels[] = {
+    { "kernel_add", true, boost::bind(&kernel_add<Dtype>, count, a_data,
+        b_data, out_data) },
+    { "kernel_sub", true, boost::bind(&kernel_sub<Dtype>, count, a_data,
+        b_data, out_data) },
+    { "kernel_mul", true, boost::bind(&kernel_mul<Dtype>, count, a_data,
+        b_data, out_data) },
+    { "kernel_div", true, boost::bind(&kernel_div<Dtype>, count, a_data,
+        b_data, out_data) },
+    { "kernel_exp", true, boost::bind(&kernel_exp<Dtype>, count, a_data,
+        out_data) },
+    { "kernel_log", true, boost::bind(&kernel_log<Dtype>, count, a_data,
+        out_data) },
+    { "kernel_powx", true, boost::bind(&kernel_powx<Dtype>, count, a_data,
+        Dtype(2), out_data) },
+    { "kernel_add_scalar", true, boost::bind(&kernel_add_scalar<Dtype>,
+        count, Dtype(1), out_data) },
+    { "ReLUForward", true, boost::bind(&ReLUForward<Dtype>, count, a_data,
+        out_data, Dtype(0)) },
+    { "ReLUBackward", true, boost::bind(&ReLUBackward<Dtype>, count, a_data,
+        b_data, out_data, Dtype(0)) },
+    { "SigmoidForward", false, boost::bind(&SigmoidForward<Dtype>, count,
+        a_data, out_data) },
+    { "TanHForward", false, boost::bind(&TanHForward<Dtype>, count, a_data,
+        out_data) },
+    { "kernel_channel_max", false, boost::bind(&kernel_channel_max<Dtype>,
+        kNum, kChannels, spatial, a_data, out_data) },
+    { "kernel_channel_sum", false, boost::bind(&kernel_channel_sum<Dtype>,
+        kNum, kChannels, spatial, a_data, out_data) },
+    { "kernel_channel_dot", false, boost::bind(&kernel_channel_dot<Dtype>,
+        kNum, kChannels, spatial, a_data, b_data, out_data) },
+  };
+  for (int i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+    const std::string kernel_name = kernels[i].name + suffix;
+    float ms = 0;
+    LaunchConfig config = TuneLaunchConfig(kernel_name,
+        kernels[i].grid_stride, kernels[i].launch, runs, &ms);
+    LOG(INFO) << kernel_name << ": local size " << config.local_size
+        << ", " << config.items_per_thread << " items per work item, "
+        << ms << " ms";
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Tune the local work size of the element-wise "
+        "and reduction OpenCL kernels\n"
+        "Usage:\n"
+        "    tune_ocl_kernels [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+#ifdef CPU_ONLY
+  LOG(FATAL) << "tune_ocl_kernels needs Caffe built with OpenCL.";
+#else
+  if (FLAGS_device_type == "gpu") {
+    oclDeviceType = CL_DEVICE_TYPE_GPU;
+  } else if (FLAGS_device_type == "cpu") {
+    oclDeviceType = CL_DEVICE_TYPE_CPU;
+  } else if (FLAGS_device_type == "accelerator") {
+    oclDeviceType = CL_DEVICE_TYPE_ACCELERATOR;
+  } else if (FLAGS_device_type == "all") {
+    oclDeviceType = CL_DEVICE_TYPE_ALL;
+  } else {
+    LOG(FATAL) << "Unknown device type " << FLAGS_device_type;
+  }
+  CHECK_GE(FLAGS_count, kNum * kChannels);
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+  }
+  Caffe::set_mode(Caffe::GPU);
+
+  TuneKernels<float>(FLAGS_count, FLAGS_runs);
+  TuneKernels<double>(FLAGS_count, FLAGS_runs);
+
+  const std::string profile_file = FLAGS_profile.empty() ?
+      amdDevice.LaunchProfilePath() : FLAGS_profile;
+  CHECK(!profile_file.empty()) << "Set --profile, the binary cache is off.";
+  CHECK(amdDevice.SaveLaunchProfile(profile_file))
+      << "Failed to write " << profile_file;
+  LOG(INFO) << "Wrote launch profile " << profile_file;
+#endif
+  return 0;
+}